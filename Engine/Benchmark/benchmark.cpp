@@ -0,0 +1,1945 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: benchmark.cpp
+////////////////////////////////////////////////////////////////////////////////
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "alloctracker.h"
+#include "assetloader.h"
+#include "ddsfile.h"
+#include "dirtyranges.h"
+#include "fontatlas.h"
+#include "framestats.h"
+#include "jobsystem.h"
+#include "profiler.h"
+#include "renderstats.h"
+#include "savefile.h"
+#include "shadercache.h"
+#include "statetracker.h"
+#include "textbatcher.h"
+#include "tickscheduler.h"
+#include "tilemap.h"
+#include "vertexbuilder.h"
+#include "worldgen.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: Benchmark
+////////////////////////////////////////////////////////////////////////////////
+class Benchmark
+{
+public:
+	Benchmark(double minSeconds) : m_minSeconds(minSeconds) {}
+
+	// Runs the callable until at least m_minSeconds have passed and prints
+	// the mean time per iteration and the resulting throughput.
+	void Run(const char * name, const char * unit, double unitsPerIteration, const std::function<void()> & fn)
+	{
+		using clock = std::chrono::steady_clock;
+
+		// Warm up once so one-off allocations don't skew short runs.
+		fn();
+
+		size_t iterations = 0;
+		auto start = clock::now();
+		std::chrono::duration<double> elapsed{};
+		do
+		{
+			fn();
+			iterations++;
+			elapsed = clock::now() - start;
+		} while (elapsed.count() < m_minSeconds);
+
+		double perIteration = elapsed.count() / iterations;
+		std::printf("%-32s %10zu iters %12.3f us/iter %14.0f %s/s\n",
+			name, iterations, perIteration * 1e6, unitsPerIteration / perIteration, unit);
+	}
+
+private:
+	double m_minSeconds;
+};
+
+
+// Keeps the optimizer from discarding the work being measured.
+static volatile uint64_t s_sink = 0;
+
+
+// Makes every chunk of the map resident.
+static void StreamAll(TileMap & map)
+{
+	std::vector<int> loaded, evicted;
+	map.Stream(Geometry::Rectangle<int>(0, 0, map.GetWorldWidth(), map.GetWorldHeight()), SIZE_MAX, loaded, evicted);
+}
+
+
+static void BenchWorldGeneration(Benchmark & bench, int width, int height)
+{
+	auto name = FormatString("worldgen %dx%d", width, height);
+	bench.Run(name.data(), "tiles", double(width) * height, [&]() {
+		TileMap map(width, height);
+		map.Generate();
+		StreamAll(map);
+		s_sink += map.GetTile(map.GetSize() - 1)->texidx;
+	});
+}
+
+
+static void BenchWorldStreaming(Benchmark & bench, int width, int height)
+{
+	TileMap map(width, height);
+	map.Generate();
+
+	// Dig somewhere, pan far enough away for it to be evicted, and come back.
+	const int screenWidth = 800, screenHeight = 600;
+	std::vector<int> loaded, evicted;
+	map.Stream(TileMap::ViewFromCamera(0.0f, 0.0f, screenWidth, screenHeight), SIZE_MAX, loaded, evicted);
+	int edited = 10 * height + 10;
+	map.GetTile(edited)->texidx = 3;
+	map.Stream(TileMap::ViewFromCamera(map.GetWorldWidth() / 2.0f, 0.0f, screenWidth, screenHeight), SIZE_MAX, loaded, evicted);
+	if (map.GetChunk(map.ChunkFromTile(edited)) != nullptr)
+		throw std::runtime_error("Chunk was not evicted");
+	map.Stream(TileMap::ViewFromCamera(0.0f, 0.0f, screenWidth, screenHeight), SIZE_MAX, loaded, evicted);
+	if (map.GetTile(edited)->texidx != 3)
+		throw std::runtime_error("Edited tile did not survive eviction");
+
+	// Pan diagonally across the world, 16 pixels a frame.
+	float x = 0.0f, y = 0.0f;
+	size_t frames = 0, maxResident = 0;
+	auto name = FormatString("stream pan %dx%d", width, height);
+	bench.Run(name.data(), "frames", 1.0, [&]() {
+		x = std::fmod(x + 16.0f, static_cast<float>(map.GetWorldWidth()));
+		y = std::fmod(y - 16.0f, static_cast<float>(map.GetWorldHeight()));
+		loaded.clear();
+		evicted.clear();
+		map.Stream(TileMap::ViewFromCamera(x, y, screenWidth, screenHeight), 4, loaded, evicted);
+		maxResident = std::max(maxResident, map.GetResidentChunks().size());
+		frames++;
+	});
+
+	size_t chunkTiles = TileMap::ChunkSize * TileMap::ChunkSize;
+	std::printf("stream pan %dx%d: at most %zu of %zu chunks resident (%zu KiB of tiles)\n",
+		width, height, maxResident, size_t(map.GetSize()) / chunkTiles,
+		maxResident * chunkTiles * sizeof(TileMap::Tile) / 1024);
+}
+
+
+// The linear scan TileFromWorldPoint used to do, for checking against.
+static TileMap::Tile * PickReference(TileMap & map, float x, float y, int screenWidth, int screenHeight)
+{
+	for (auto & chunk : map.GetResidentChunks())
+	{
+		for (auto & tile : chunk.second.tiles)
+		{
+			auto rect = tile.position;
+			float
+				left = (float)rect.left - (float)(screenWidth / 2),
+				right = left + (float)rect.Width,
+				top = (float)(screenHeight / 2) - (float)rect.Top,
+				bottom = top - (float)rect.Height;
+			if (x >= left && x < right && y <= top && y > bottom && tile.texidx != 255)
+				return const_cast<TileMap::Tile *>(&tile);
+		}
+	}
+	return nullptr;
+}
+
+
+static void BenchPicking(Benchmark & bench, int width, int height)
+{
+	const int screenWidth = 800, screenHeight = 600;
+	TileMap map(width, height);
+	map.Generate();
+
+	// Everything around the drill, where the oversized tiles are.
+	float cameraX = (width / 2 - 4) * 128.0f, cameraY = 0.0f;
+	std::vector<int> loaded, evicted;
+	map.Stream(TileMap::ViewFromCamera(cameraX, cameraY, screenWidth, screenHeight), SIZE_MAX, loaded, evicted);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float>
+		xs(cameraX - screenWidth / 2.0f, cameraX + screenWidth / 2.0f),
+		ys(cameraY - screenHeight * 2.0f, cameraY + screenHeight / 2.0f);
+	std::vector<DirectX::XMFLOAT2> points(4096);
+	for (auto & point : points)
+		point = DirectX::XMFLOAT2(xs(random), ys(random));
+
+	std::vector<TileMap::Tile *> tiles(points.size());
+	map.TilesFromWorldPoints(points.data(), points.size(), screenWidth, screenHeight, tiles.data());
+	for (size_t i = 0; i < points.size(); i++)
+		if (tiles[i] != PickReference(map, points[i].x, points[i].y, screenWidth, screenHeight))
+			throw std::runtime_error("Picking does not match the linear scan");
+
+	auto name = FormatString("picking %dx%d", width, height);
+	bench.Run(name.data(), "points", double(points.size()), [&]() {
+		map.TilesFromWorldPoints(points.data(), points.size(), screenWidth, screenHeight, tiles.data());
+		s_sink += tiles[0] != nullptr;
+	});
+}
+
+
+static void BenchPerlinNoise(Benchmark & bench, int width, int height)
+{
+	PerlinNoise perlin(width, height, 8, 8, 1);
+
+	// The batched generator works in floats, so it is compared against the
+	// double precision reference with a tolerance rather than bit for bit.
+	double maxError = 0.0;
+	for (int i = 0; i < perlin.GetSize(); i++)
+		maxError = std::max(maxError, std::abs(perlin.GetMap()[i] - perlin.Reference(i)));
+	std::printf("perlin %dx%d max error vs reference: %g\n", width, height, maxError);
+	if (maxError > 1e-4)
+		throw std::runtime_error("Batched Perlin noise does not match the reference");
+
+	auto name = FormatString("perlin reference %dx%d", width, height);
+	bench.Run(name.data(), "cells", double(perlin.GetSize()), [&]() {
+		double sum = 0.0;
+		for (int i = 0; i < perlin.GetSize(); i++)
+			sum += perlin.Reference(i);
+		s_sink += static_cast<uint64_t>(sum);
+	});
+
+	name = FormatString("perlin batched %dx%d", width, height);
+	bench.Run(name.data(), "cells", double(perlin.GetSize()), [&]() {
+		perlin.Fill(1);
+		s_sink += static_cast<uint64_t>(perlin.GetMap()[0] * 100);
+	});
+
+	unsigned threads = std::thread::hardware_concurrency();
+	name = FormatString("perlin batched %dx%d x%u", width, height, threads);
+	bench.Run(name.data(), "cells", double(perlin.GetSize()), [&]() {
+		perlin.Fill(threads);
+		s_sink += static_cast<uint64_t>(perlin.GetMap()[0] * 100);
+	});
+}
+
+
+// One bool per cell, double buffered: what Cellular::Smooth must agree with.
+static void SmoothReference(std::vector<bool> & cells, int width, int height)
+{
+	std::vector<bool> next(cells.size());
+	for (int x = 0; x < height; x++)
+	{
+		for (int y = 0; y < width; y++)
+		{
+			int count = 0;
+			for (int i = -1; i < 2; i++)
+				for (int j = -1; j < 2; j++)
+					if ((i || j) && x + i >= 0 && x + i < height && y + j >= 0 && y + j < width)
+						count += cells[(x + i) * width + (y + j)];
+
+			next[x * width + y] = cells[x * width + y] ? count >= 3 : count > 4;
+		}
+	}
+	cells.swap(next);
+}
+
+
+static void BenchCellular(Benchmark & bench, int width, int height)
+{
+	Cellular cellular(width, height, 50, -1, 1);
+	std::vector<bool> reference(cellular.GetSize());
+	for (int i = 0; i < cellular.GetSize(); i++)
+		reference[i] = cellular.IsAlive(i);
+
+	for (int k = 0; k < 5; k++)
+	{
+		SmoothReference(reference, width, height);
+		cellular.Smooth();
+	}
+	for (int i = 0; i < cellular.GetSize(); i++)
+		if (cellular.IsAlive(i) != reference[i])
+			throw std::runtime_error("Bit-packed cellular automaton does not match the reference");
+
+	auto name = FormatString("cellular reference %dx%d", width, height);
+	bench.Run(name.data(), "cells", double(cellular.GetSize()), [&]() {
+		SmoothReference(reference, width, height);
+		s_sink += reference[0];
+	});
+
+	name = FormatString("cellular bit-packed %dx%d", width, height);
+	bench.Run(name.data(), "cells", double(cellular.GetSize()), [&]() {
+		cellular.Smooth();
+		s_sink += cellular.IsAlive(0);
+	});
+}
+
+
+static void BenchVertexBuilding(Benchmark & bench, int width, int height)
+{
+	TileMap map(width, height);
+	map.Generate();
+	StreamAll(map);
+	std::vector<Geometry::ColoredRect<int>> rects;
+	std::vector<int> uvrectmap;
+	for (const auto & chunk : map.GetResidentChunks())
+	{
+		auto chunkRects = map.GetColoredRects(chunk.second);
+		auto chunkUvRectMap = map.GetUvRectMap(chunk.second);
+		rects.insert(rects.end(), chunkRects.begin(), chunkRects.end());
+		uvrectmap.insert(uvrectmap.end(), chunkUvRectMap.begin(), chunkUvRectMap.end());
+	}
+	const auto & uvrects = map.GetTextureMap();
+	std::vector<VertexColorType> vertices(4 * rects.size());
+
+	auto name = FormatString("sprites %dx%d", width, height);
+	bench.Run(name.data(), "quads", double(rects.size()), [&]() {
+		VertexBuilder::BuildSprites(vertices.data(), rects, uvrects, uvrectmap, 800, 600);
+		s_sink += static_cast<uint64_t>(vertices.back().position.x);
+	});
+
+	name = FormatString("colored rects %dx%d", width, height);
+	bench.Run(name.data(), "quads", double(rects.size()), [&]() {
+		VertexBuilder::BuildColoredRects(vertices.data(), rects, 800, 600);
+		s_sink += static_cast<uint64_t>(vertices.back().position.x);
+	});
+}
+
+
+// Packs every chunk's sprites against the chunk corner the way Tiles does,
+// and checks nothing moves by more than the quantization step.
+static void BenchVertexPacking(Benchmark & bench, int width, int height)
+{
+	const int screenWidth = 800, screenHeight = 600;
+	TileMap map(width, height);
+	map.Generate();
+	StreamAll(map);
+	const auto & uvrects = map.GetTextureMap();
+
+	struct Batch
+	{
+		POINT origin;
+		std::vector<VertexColorType> vertices;
+		std::vector<PackedVertexType> packed;
+	};
+	std::vector<Batch> batches;
+	size_t vertexCount = 0;
+	for (const auto & chunk : map.GetResidentChunks())
+	{
+		Batch batch;
+		batch.origin = { chunk.second.x * 128 - screenWidth / 2, screenHeight / 2 - chunk.second.y * 128 };
+		auto rects = map.GetColoredRects(chunk.second);
+		batch.vertices.resize(4 * rects.size());
+		batch.packed.resize(batch.vertices.size());
+		VertexBuilder::BuildSprites(batch.vertices.data(), rects, uvrects, map.GetUvRectMap(chunk.second), screenWidth, screenHeight);
+		vertexCount += batch.vertices.size();
+		batches.push_back(std::move(batch));
+	}
+
+	auto name = FormatString("pack vertices %dx%d", width, height);
+	bench.Run(name.data(), "vertices", double(vertexCount), [&]() {
+		for (auto & batch : batches)
+			VertexBuilder::PackVertices(batch.packed.data(), batch.vertices.data(), batch.vertices.size(), batch.origin);
+		s_sink += static_cast<uint64_t>(batches.back().packed.back().u);
+	});
+
+	for (const auto & batch : batches)
+	{
+		for (size_t i = 0; i < batch.vertices.size(); i++)
+		{
+			const auto & full = batch.vertices[i];
+			const auto & packed = batch.packed[i];
+			float
+				dx = std::fabs(packed.x + batch.origin.x - full.position.x),
+				dy = std::fabs(packed.y + batch.origin.y - full.position.y),
+				du = std::fabs(packed.u / 65535.0f - full.texture.x),
+				dv = std::fabs(packed.v / 65535.0f - full.texture.y),
+				dc = std::fabs(packed.color[3] / 255.0f - full.color.w);
+			if (dx > 0.5f || dy > 0.5f || du > 0.5f / 65535 || dv > 0.5f / 65535 || dc > 0.5f / 255)
+			{
+				throw std::runtime_error(
+					FormatString(
+						"Packed vertex %zu is off by (%g, %g) uv (%g, %g) alpha %g",
+						i, dx, dy, du, dv, dc
+					).data()
+				);
+			}
+		}
+	}
+	std::printf("pack %dx%d: %zu bytes per vertex instead of %zu (%zu KiB instead of %zu)\n",
+		width, height, sizeof(PackedVertexType), sizeof(VertexColorType),
+		sizeof(PackedVertexType) * vertexCount / 1024, sizeof(VertexColorType) * vertexCount / 1024);
+}
+
+
+// Builds one instance per tile for every chunk the way TileBatch does, then
+// expands them as TileVertexShader would and compares with BuildSprites.
+static void BenchTileInstances(Benchmark & bench, int width, int height)
+{
+	const int screenWidth = 800, screenHeight = 600;
+	TileMap map(width, height);
+	map.Generate();
+	StreamAll(map);
+	const auto & uvrects = map.GetTextureMap();
+	std::vector<DirectX::XMFLOAT4> atlas(uvrects.size());
+	VertexBuilder::BuildAtlasRects(atlas.data(), uvrects);
+
+	struct Batch
+	{
+		POINT origin;
+		std::vector<Geometry::ColoredRect<int>> rects;
+		std::vector<int> uvrectmap;
+		std::vector<TileInstanceType> instances;
+	};
+	std::vector<Batch> batches;
+	size_t tileCount = 0;
+	for (const auto & chunk : map.GetResidentChunks())
+	{
+		Batch batch;
+		batch.origin = { chunk.second.x * 128 - screenWidth / 2, screenHeight / 2 - chunk.second.y * 128 };
+		batch.rects = map.GetColoredRects(chunk.second);
+		batch.uvrectmap = map.GetUvRectMap(chunk.second);
+		batch.instances.resize(batch.rects.size());
+		tileCount += batch.rects.size();
+		batches.push_back(std::move(batch));
+	}
+
+	auto name = FormatString("tile instances %dx%d", width, height);
+	bench.Run(name.data(), "tiles", double(tileCount), [&]() {
+		for (auto & batch : batches)
+			VertexBuilder::BuildTileInstances(batch.instances.data(), batch.rects, uvrects.size(), batch.uvrectmap,
+				screenWidth, screenHeight, batch.origin);
+		s_sink += batches.back().instances.back().atlas;
+	});
+
+	const float corners[4][2] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+	for (const auto & batch : batches)
+	{
+		std::vector<VertexColorType> vertices(4 * batch.rects.size());
+		VertexBuilder::BuildSprites(vertices.data(), batch.rects, uvrects, batch.uvrectmap, screenWidth, screenHeight);
+		for (size_t i = 0; i < batch.instances.size(); i++)
+		{
+			const auto & instance = batch.instances[i];
+			for (int c = 0; c < 4; c++)
+			{
+				const auto & vertex = vertices[4 * i + c];
+				if (instance.width == 0 && instance.height == 0)
+				{
+					if (vertex.position.x != 0.0f || vertex.position.y != 0.0f)
+						throw std::runtime_error(FormatString("Tile instance %zu is hidden but its sprite is not", i).data());
+					continue;
+				}
+				const auto & uv = atlas[instance.atlas];
+				float
+					dx = std::fabs(batch.origin.x + instance.x + corners[c][0] * instance.width - vertex.position.x),
+					dy = std::fabs(batch.origin.y + instance.y - corners[c][1] * instance.height - vertex.position.y),
+					du = std::fabs(uv.x + (uv.z - uv.x) * corners[c][0] - vertex.texture.x),
+					dv = std::fabs(uv.y + (uv.w - uv.y) * corners[c][1] - vertex.texture.y);
+				if (dx > 0.0f || dy > 0.0f || du > 1e-6f || dv > 1e-6f)
+				{
+					throw std::runtime_error(
+						FormatString(
+							"Tile instance %zu corner %d is off by (%g, %g) uv (%g, %g)",
+							i, c, dx, dy, du, dv
+						).data()
+					);
+				}
+			}
+		}
+	}
+	std::printf("tile instances %dx%d: %zu bytes per tile instead of %zu\n",
+		width, height, sizeof(TileInstanceType), 4 * sizeof(VertexColorType));
+}
+
+
+// QuadIndexBuffer fills its 16-bit buffer with the same pattern as the
+// 32-bit one, so the two have to agree for every quad 16 bits can reach.
+static void BenchQuadIndices(Benchmark & bench, size_t quadCount)
+{
+	std::vector<uint16_t> shortIndices(6 * quadCount);
+	std::vector<uint32_t> longIndices(6 * quadCount);
+
+	auto name = FormatString("quad indices x%zu", quadCount);
+	bench.Run(name.data(), "quads", double(quadCount), [&]() {
+		VertexBuilder::BuildQuadIndices(shortIndices.data(), quadCount);
+		s_sink += shortIndices.back();
+	});
+
+	VertexBuilder::BuildQuadIndices(longIndices.data(), quadCount);
+	for (size_t i = 0; i < longIndices.size(); i++)
+		if (shortIndices[i] != longIndices[i])
+			throw std::runtime_error(FormatString("16-bit quad index %zu is %u, not %u", i, shortIndices[i], longIndices[i]).data());
+	std::printf("quad indices x%zu: %zu bytes shared instead of %zu per batch\n",
+		quadCount, sizeof(uint16_t) * shortIndices.size(), sizeof(uint32_t) * longIndices.size());
+}
+
+
+// What LargeBitmap does per frame when two tiles change, e.g. a drill click:
+// mark the rects dirty and rebuild and upload only those.
+static void BenchDirtyUploads(Benchmark & bench, int width, int height)
+{
+	TileMap map(width, height);
+	map.Generate();
+	StreamAll(map);
+	std::vector<Geometry::ColoredRect<int>> rects;
+	std::vector<int> uvrectmap;
+	for (const auto & chunk : map.GetResidentChunks())
+	{
+		auto chunkRects = map.GetColoredRects(chunk.second);
+		auto chunkUvRectMap = map.GetUvRectMap(chunk.second);
+		rects.insert(rects.end(), chunkRects.begin(), chunkRects.end());
+		uvrectmap.insert(uvrectmap.end(), chunkUvRectMap.begin(), chunkUvRectMap.end());
+	}
+	const auto & uvrects = map.GetTextureMap();
+	std::vector<VertexColorType> vertices(4 * rects.size()), full(vertices.size());
+	VertexBuilder::BuildSprites(vertices.data(), rects, uvrects, uvrectmap, 800, 600);
+
+	std::mt19937 random(1);
+	std::uniform_int_distribution<size_t> pick(0, rects.size() - 2);
+	DirtyRanges dirty;
+	size_t bytes = 0, frames = 0;
+	auto frame = [&]() {
+		size_t tile = pick(random);
+		uvrectmap[tile] = 14;
+		uvrectmap[tile + 1] = 12;
+		dirty.Add(tile);
+		dirty.Add(tile + 1);
+		for (const auto & range : dirty.GetRanges())
+		{
+			VertexBuilder::BuildSprites(vertices.data(), rects, uvrects, uvrectmap, 800, 600, range.begin, range.end - range.begin);
+			bytes += 4 * sizeof(VertexColorType) * (range.end - range.begin);
+		}
+		dirty.Clear();
+		frames++;
+	};
+
+	for (int i = 0; i < 100; i++)
+		frame();
+	VertexBuilder::BuildSprites(full.data(), rects, uvrects, uvrectmap, 800, 600);
+	if (std::memcmp(vertices.data(), full.data(), vertices.size() * sizeof(VertexColorType)) != 0)
+		throw std::runtime_error("Partial vertex rebuild does not match a full one");
+
+	auto name = FormatString("dirty upload %dx%d", width, height);
+	bench.Run(name.data(), "frames", 1.0, frame);
+	std::printf("dirty upload %dx%d: %zu bytes per frame instead of %zu\n",
+		width, height, bytes / frames, vertices.size() * sizeof(VertexColorType));
+}
+
+
+static void BenchSaveLoad(Benchmark & bench, int width, int height)
+{
+	TileMap map(width, height);
+	map.Generate();
+	int edited = width * height / 3;
+	map.GetTile(edited)->texidx = 3;
+	map.MarkChanged(edited);
+
+	// Only the map's size and the one edited chunk are kept.
+	SaveFile file;
+	map.Save(file);
+	std::ostringstream stream(std::ios::binary);
+	file.Save(stream);
+	auto bytes = stream.str();
+	auto data = reinterpret_cast<const std::byte *>(bytes.data());
+	SaveFile loaded;
+	TileMap copy(8, 8);
+	if (file.GetChunks().size() != 2 || !loaded.Load(data, bytes.size()) || !copy.Load(loaded)
+		|| copy.GetSize() != map.GetSize() || copy.GetTile(edited)->texidx != 3)
+		throw std::runtime_error("Edited tile did not survive save and load");
+
+	// Damage anywhere is caught, and leaves what was loaded alone.
+	auto damaged = bytes;
+	damaged[damaged.size() / 2] ^= 1;
+	if (loaded.Load(reinterpret_cast<const std::byte *>(damaged.data()), damaged.size())
+		|| loaded.Load(data, bytes.size() - 1) || loaded.GetChunks().size() != 2)
+		throw std::runtime_error("Loaded a damaged save");
+
+	// So is a map whose sides are each allowed but whose area is not.
+	SaveFile huge;
+	huge.WriteChunk(SaveFile::MakeChunkId('M', 0), [](BinaryWriter & writer) {
+		writer.Write(0xFFFF);
+		writer.Write(0xFFFF);
+	});
+	bool hugeThrew = false;
+	try
+	{
+		copy.Load(huge);
+	}
+	catch (std::runtime_error &)
+	{
+		hugeThrew = true;
+	}
+	if (!hugeThrew)
+		throw std::runtime_error("Loaded a map too large to index");
+
+	// Nothing changed, nothing written; an edit rewrites its chunk and
+	// undoing it drops the chunk again.
+	auto directory = std::filesystem::temp_directory_path() / "engine-benchmark-save";
+	auto path = (directory / "autosave.bin").string();
+	std::filesystem::create_directories(directory);
+	auto first = file.Save(path.data());
+	map.Save(file);
+	auto unchanged = file.Save(path.data());
+	map.GetTile(edited + 1)->texidx = 3;
+	map.MarkChanged(edited + 1);
+	map.Save(file);
+	auto changed = file.Save(path.data());
+	map.GetTile(edited)->texidx = 0;
+	map.GetTile(edited + 1)->texidx = 0;
+	map.MarkChanged(edited);
+	map.Save(file);
+	auto undone = file.Save(path.data());
+	if (first.bytesWritten != bytes.size() || unchanged.bytesWritten != 0 || changed.chunksChanged != 1
+		|| undone.chunksChanged != 1 || file.GetChunks().size() != 1 || std::filesystem::exists(path + ".tmp")
+		|| !loaded.Load(path.data()) || loaded.GetChunks().size() != 1)
+		throw std::runtime_error("Save file did not track its changes");
+	std::filesystem::remove_all(directory);
+
+	// One tile changed each cycle, as clicking does.
+	int cycle = 0;
+	auto name = FormatString("autosave %dx%d", width, height);
+	bench.Run(name.data(), "tiles", double(width) * height, [&]() {
+		int index = (cycle++ * 7919) % map.GetSize();
+		map.GetTile(index)->texidx = 3;
+		map.MarkChanged(index);
+		map.Save(file);
+		std::ostringstream out(std::ios::binary);
+		file.Save(out);
+		s_sink += out.tellp();
+	});
+	std::printf("autosave %dx%d: %zu bytes to disk in %.2f ms, %zu of them for one edit\n",
+		width, height, first.bytesWritten, first.time.count(), changed.bytesChanged);
+}
+
+// The game thread collecting what changed between two frames and handing
+// it to a thread that writes it, as SystemClass does.
+static void BenchSnapshot(Benchmark & bench, int width, int height)
+{
+	using Clock = std::chrono::steady_clock;
+	TileMap map(width, height);
+	map.Generate();
+	SaveFile state, written;
+
+	std::mutex mutex;
+	std::condition_variable signal;
+	std::vector<std::vector<SaveFile::Change>> snapshots;
+	bool isDone = false;
+	std::thread writer([&]() {
+		std::unique_lock<std::mutex> lock(mutex);
+		while (true)
+		{
+			signal.wait(lock, [&]() { return !snapshots.empty() || isDone; });
+			if (snapshots.empty())
+				break;
+			auto changes = std::move(snapshots.front());
+			snapshots.erase(snapshots.begin());
+			lock.unlock();
+			written.Apply(changes);
+			std::ostringstream out(std::ios::binary);
+			written.Save(out);
+			s_sink += out.tellp();
+			lock.lock();
+		}
+	});
+
+	// A few clicks between snapshots while the last one is still written.
+	const int cycles = 200;
+	std::chrono::duration<double, std::micro> longest{}, total{};
+	for (int cycle = 0; cycle < cycles; cycle++)
+	{
+		for (int click = 0; click < 3; click++)
+		{
+			int index = (cycle * 3 + click) * 7919 % map.GetSize();
+			map.GetTile(index)->texidx = static_cast<uint8_t>(cycle % 4);
+			map.MarkChanged(index);
+		}
+
+		auto start = Clock::now();
+		map.Save(state);
+		auto changes = state.TakeChanges();
+		std::chrono::duration<double, std::micro> pause = Clock::now() - start;
+		longest = std::max(longest, pause);
+		total += pause;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		snapshots.push_back(std::move(changes));
+		signal.notify_one();
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isDone = true;
+	}
+	signal.notify_one();
+	writer.join();
+
+	std::ostringstream expected(std::ios::binary), actual(std::ios::binary);
+	state.Save(expected);
+	written.Save(actual);
+	if (expected.str() != actual.str())
+		throw std::runtime_error("Snapshots did not add up to the game's state");
+
+	size_t unpacked = 0;
+	for (const auto & chunk : state.GetChunks())
+		unpacked += chunk.second->size();
+
+	int cycle = 0;
+	auto name = FormatString("autosave snapshot %dx%d", width, height);
+	bench.Run(name.data(), "snapshots", 1.0, [&]() {
+		int index = cycle++ * 7919 % map.GetSize();
+		map.GetTile(index)->texidx ^= 1;
+		map.MarkChanged(index);
+		map.Save(state);
+		s_sink += state.TakeChanges().size();
+	});
+	std::printf("autosave snapshot %dx%d: game paused %.1f us on average, %.1f us at most; %zu chunk bytes packed to %zu\n",
+		width, height, total.count() / cycles, longest.count(), unpacked, actual.str().size());
+}
+
+// Drives the scheduler with a clock that only moves when told to.
+static void BenchTickScheduler(Benchmark & bench)
+{
+	using namespace std::chrono_literals;
+	TickScheduler::TimePoint now{};
+	TickScheduler scheduler(60.0, 5, [&]() { return now; });
+	auto tick = scheduler.GetTickLength();
+
+	// Frames at twice the tick rate tick every other frame, the ones in
+	// between drawn halfway to the next tick.
+	now += tick / 2;
+	if (scheduler.BeginFrame() != 0 || std::abs(scheduler.GetAlpha() - 0.5f) > 1e-4f)
+		throw std::runtime_error("Tick scheduler ticked early");
+	now += tick / 2;
+	if (scheduler.BeginFrame() != 1 || scheduler.GetAlpha() > 1e-4f)
+		throw std::runtime_error("Tick scheduler missed a tick");
+	now += tick * 3;
+	if (scheduler.BeginFrame() != 3)
+		throw std::runtime_error("Tick scheduler did not catch up");
+
+	// A one second stall runs five ticks and drops the rest.
+	now += 1s;
+	if (scheduler.BeginFrame() != 5 || scheduler.GetDroppedTicks() != 55 || scheduler.GetTickCount() != 9)
+		throw std::runtime_error("Tick scheduler did not drop the ticks of a stall");
+
+	// The limiter holds the next frame back a frame's length, but not past
+	// now when the frame ran long.
+	scheduler.SetFrameRateLimit(30.0);
+	auto frameStart = now;
+	if (scheduler.GetNextFrameTime() != frameStart + std::chrono::duration_cast<TickScheduler::Duration>(1s) / 30)
+		throw std::runtime_error("Frame limiter waits the wrong time");
+	now += 50ms;
+	if (scheduler.GetNextFrameTime() != now)
+		throw std::runtime_error("Frame limiter waits after a long frame");
+	scheduler.SetFrameRateLimit(0.0);
+	if (scheduler.GetNextFrameTime() != now)
+		throw std::runtime_error("Frame limiter waits without a limit");
+
+	// Ten seconds comes to 600 ticks at any frame rate, and in between.
+	std::mt19937 random(1);
+	for (double rate : { 30.0, 60.0, 144.0, 240.0, 0.0 })
+	{
+		TickScheduler::TimePoint clock{};
+		TickScheduler run(60.0, 5, [&]() { return clock; });
+		size_t ticks = 0;
+		while (clock < TickScheduler::TimePoint(10s))
+		{
+			auto frame = rate > 0.0
+				? std::chrono::duration_cast<TickScheduler::Duration>(std::chrono::duration<double>(1.0 / rate))
+				: std::chrono::duration_cast<TickScheduler::Duration>(std::chrono::microseconds(1000 + random() % 40000));
+			clock = std::min(clock + frame, TickScheduler::TimePoint(10s));
+			ticks += run.BeginFrame();
+		}
+		if (ticks != 600 || run.GetDroppedTicks() != 0)
+			throw std::runtime_error(FormatString("Tick scheduler ran %zu ticks in ten seconds", ticks).data());
+	}
+
+	bench.Run("tick scheduler frame", "frames", 1.0, [&]() {
+		now += 7ms;
+		s_sink += scheduler.BeginFrame();
+		s_sink += static_cast<uint64_t>(scheduler.GetAlpha() * 100);
+	});
+}
+
+
+static std::vector<std::vector<FT_Byte>> ReadFonts(const std::string & filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	file.exceptions(std::fstream::failbit | std::fstream::badbit);
+	BinaryReader reader(file);
+	int32_t numFonts = reader.Get<int32_t>();
+	std::vector<std::vector<FT_Byte>> fonts(numFonts);
+
+	for (auto & font : fonts)
+	{
+		int32_t fontLength = reader.Get<int32_t>();
+		font.resize(fontLength);
+		reader.Read(font.data(), fontLength);
+	}
+
+	return fonts;
+}
+
+
+// Every glyph has to lie inside its page and no two may overlap, or one
+// would show bits of another.
+static void CheckGlyphAtlas(FontAtlas & atlas, const std::vector<char32_t> & extra)
+{
+	size_t size = atlas.GetPageSize();
+	std::vector<std::vector<char32_t>> owners(atlas.GetPageCount(), std::vector<char32_t>(size * size));
+	std::vector<char32_t> codePoints = extra;
+	for (char32_t c = 32; c < 127; c++)
+		codePoints.push_back(c);
+
+	for (char32_t c : codePoints)
+	{
+		const auto * glyph = atlas.GetGlyph(c);
+		if (glyph == nullptr)
+			throw std::runtime_error(FormatString("No glyph for U+%04X", unsigned(c)).data());
+		if (glyph->width == 0 || glyph->height == 0)
+			continue;
+
+		auto left = static_cast<size_t>((glyph->u0 - glyph->page) * size), top = static_cast<size_t>(glyph->v0 * size);
+		if (glyph->page >= owners.size() || left + glyph->width > size || top + glyph->height > size)
+			throw std::runtime_error(FormatString("Glyph U+%04X lies outside its page", unsigned(c)).data());
+		for (size_t y = top; y < top + glyph->height; y++)
+			for (size_t x = left; x < left + glyph->width; x++)
+			{
+				auto & owner = owners[glyph->page][y * size + x];
+				if (owner != 0)
+					throw std::runtime_error(FormatString("Glyphs U+%04X and U+%04X overlap", unsigned(owner), unsigned(c)).data());
+				owner = c;
+			}
+	}
+	std::printf("font atlas: %zu glyphs on %zu %zux%zu pages\n",
+		codePoints.size(), atlas.GetPageCount(), size, size);
+}
+
+
+// Bilinear read of a glyph's texels, clamped to its own rect the way its
+// zero margin makes the GPU read it.
+static float SampleGlyph(FontAtlas & atlas, const FontAtlas::Glyph & glyph, float column, float row)
+{
+	size_t size = atlas.GetPageSize();
+	auto left = static_cast<size_t>((glyph.u0 - glyph.page) * size), top = static_cast<size_t>(glyph.v0 * size);
+	auto texel = [&](int x, int y) {
+		x = std::min(std::max(x, 0), glyph.width - 1);
+		y = std::min(std::max(y, 0), glyph.height - 1);
+		return std::to_integer<int>(atlas.GetPixels(glyph.page)[(top + y) * size + left + x]) / 255.0f;
+	};
+	int x = static_cast<int>(std::floor(column)), y = static_cast<int>(std::floor(row));
+	float fx = column - x, fy = row - y;
+	return (texel(x, y) * (1 - fx) + texel(x + 1, y) * fx) * (1 - fy) +
+		(texel(x, y + 1) * (1 - fx) + texel(x + 1, y + 1) * fx) * fy;
+}
+
+
+// Draws every printable glyph from the distance field at size / GetPixelSize
+// times its own size and returns the mean difference from what FreeType
+// rasterizes at that size directly.
+static float CompareDistanceField(FontAtlas & field, FontAtlas & reference)
+{
+	float scale = static_cast<float>(reference.GetPixelSize()) / field.GetPixelSize();
+	double error = 0;
+	size_t pixels = 0;
+	for (char32_t c = 33; c < 127; c++)
+	{
+		const auto & expected = *reference.GetGlyph(c);
+		const auto & glyph = *field.GetGlyph(c);
+		for (int y = 0; y < expected.height; y++)
+			for (int x = 0; x < expected.width; x++)
+			{
+				// The pixel centre in the field's units, y up from the baseline,
+				// then in its texels.
+				float gx = (expected.left + x + 0.5f) / scale, gy = (expected.top - y - 0.5f) / scale;
+				float distance = SampleGlyph(field, glyph, gx - glyph.left - 0.5f, glyph.top - gy - 0.5f);
+
+				// The shader's ramp: one output pixel wide, centred on 0.5.
+				float alpha = std::min(std::max((distance - 0.5f) * 2 * FontAtlas::DistanceFieldSpread * scale + 0.5f, 0.0f), 1.0f);
+				float coverage = std::to_integer<int>(reference.GetPixels(expected.page)[
+					(static_cast<size_t>(expected.v0 * reference.GetPageSize()) + y) * reference.GetPageSize() +
+					static_cast<size_t>((expected.u0 - expected.page) * reference.GetPageSize()) + x]) / 255.0f;
+				error += std::fabs(alpha - coverage);
+				pixels++;
+			}
+	}
+	return static_cast<float>(error / pixels);
+}
+
+
+static void BenchText(Benchmark & bench, const std::string & dataDir)
+{
+	FT_Library library;
+	if (FT_Init_FreeType(&library))
+		throw std::runtime_error("Could not initialize FreeType");
+	// Declared first so every face is closed before the library goes.
+	std::unique_ptr<FT_LibraryRec_, decltype(&FT_Done_FreeType)> libraryOwner(library, FT_Done_FreeType);
+
+	auto fonts = ReadFonts(dataDir + "/fonts.dat");
+	bench.Run("font rasterization", "glyphs", 95.0 * fonts.size(), [&]() {
+		for (auto & font : fonts)
+		{
+			FontAtlas atlas;
+			if (!atlas.LoadTTF(library, font.data(), static_cast<FT_Long>(font.size()), 16))
+				throw std::runtime_error("Could not load font");
+			s_sink += atlas.GetPageSize();
+		}
+	});
+
+	// One distance field atlas has to stand in for coverage at every size.
+	FontAtlas field;
+	bench.Run("font distance field", "glyphs", 95.0, [&]() {
+		if (!field.LoadTTF(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), 32, FontAtlas::Mode::DistanceField))
+			throw std::runtime_error("Could not load font");
+		s_sink += field.GetPageSize();
+	});
+	for (FT_UInt size : { 16, 32, 64 })
+	{
+		FontAtlas reference;
+		if (!reference.LoadTTF(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), size))
+			throw std::runtime_error("Could not load font");
+		float error = CompareDistanceField(field, reference);
+		std::printf("distance field at %upx: mean error %.4f against coverage\n", size, error);
+		if (error > 0.06f)
+			throw std::runtime_error(FormatString("Distance field at %upx is off by %g", size, error).data());
+	}
+
+	// Text in other scripts: every glyph is rasterized the first time it is
+	// used, into whatever space the pages have left.
+	std::vector<char32_t> extra;
+	for (char32_t c = 0xA1; c <= 0x17F; c++)
+		extra.push_back(c);
+	for (char32_t c = 0x391; c <= 0x3C9; c++)
+		extra.push_back(c);
+	for (char32_t c = 0x410; c <= 0x44F; c++)
+		extra.push_back(c);
+	FontAtlas paged;
+	bench.Run("font atlas on demand", "glyphs", double(extra.size()), [&]() {
+		if (!paged.LoadTTF(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), 32))
+			throw std::runtime_error("Could not load font");
+		for (char32_t c : extra)
+			s_sink += paged.GetGlyph(c)->advance;
+	});
+	CheckGlyphAtlas(paged, extra);
+
+	FontAtlas atlas;
+	if (!atlas.LoadTTF(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), 16))
+		throw std::runtime_error("Could not load font");
+
+	// The old layout put every glyph side by side in one strip.
+	long stripWidth = 0, stripHeight = 0;
+	for (char32_t c = 32; c < 127; c++)
+	{
+		stripWidth += atlas.GetGlyph(c)->advance;
+		stripHeight = std::max<long>(stripHeight, atlas.GetGlyph(c)->height);
+	}
+	std::printf("font atlas 16px: %zu %zux%zu page instead of a %ldx%ld strip\n",
+		atlas.GetPageCount(), atlas.GetPageSize(), atlas.GetPageSize(), stripWidth, stripHeight);
+
+	const char * sentences[] = {
+		"Mouse {1234, 567}",
+		"Location {27520, -640}",
+		"FPS: 60 (t=16ms)",
+		"CPU: 12%",
+		"Game Paused",
+		"The quick brown fox jumps over the lazy dog",
+	};
+	size_t glyphs = 0;
+	for (auto sentence : sentences)
+		glyphs += std::strlen(sentence);
+	std::vector<VertexType> vertices(4 * 64);
+
+	bench.Run("text layout", "glyphs", double(glyphs), [&]() {
+		for (auto sentence : sentences)
+		{
+			atlas.BuildVertexArray(vertices.data(), sentence, -400.0f, 300.0f);
+			s_sink += atlas.MeasureString(sentence).x;
+		}
+	});
+
+	// A paragraph wrapped for a ListView row: no visible glyph may cross the
+	// edge unless it starts its line, and every glyph has to come out once,
+	// in order.
+	const char * paragraph =
+		"Kerning pairs like AV, To, Ta and LT sit closer together. The quick brown fox jumps over "
+		"the lazy dog.\nA second paragraph follows an explicit break, then an overlongwordthatcannotfitonaline.";
+	size_t paragraphGlyphs = std::strlen(paragraph) - 1;
+	const float wrapWidth = 120.0f;
+	FontAtlas::TextLayout layout;
+	bench.Run("text wrap", "glyphs", double(paragraphGlyphs), [&]() {
+		atlas.Layout(paragraph, layout, 1.0f, wrapWidth);
+		s_sink += layout.lines;
+	});
+	if (layout.glyphs.size() != paragraphGlyphs || layout.width > wrapWidth || layout.lines < 5)
+		throw std::runtime_error(FormatString("Wrapped %zu glyphs onto %zu lines %g wide",
+			layout.glyphs.size(), layout.lines, layout.width).data());
+	const char * expectedGlyph = paragraph;
+	for (size_t i = 0; i < layout.glyphs.size(); i++, expectedGlyph++)
+	{
+		if (*expectedGlyph == '\n')
+			expectedGlyph++;
+		const auto & position = layout.glyphs[i];
+		bool startsLine = i == 0 || position.y != layout.glyphs[i - 1].y;
+		if (position.glyph != atlas.GetGlyph(static_cast<unsigned char>(*expectedGlyph)) ||
+			(*expectedGlyph != ' ' && !startsLine && position.x + position.glyph->advance > wrapWidth))
+			throw std::runtime_error(FormatString("Glyph %zu of the wrapped text is out of place", i).data());
+	}
+
+	std::printf("text wrap: %zu glyphs on %zu lines of at most %g px\n",
+		layout.glyphs.size(), layout.lines, wrapWidth);
+
+	// Pairs the face kerns close up against their plain advances.
+	const char * kerned = "AVATAR To Ta LT";
+	atlas.Layout(kerned, layout);
+	float advances = 0;
+	for (const char * c = kerned; *c; c++)
+		advances += atlas.GetGlyph(static_cast<unsigned char>(*c))->advance;
+	std::printf("text kerning: %+.1f px over \"%s\"\n", layout.width - advances, kerned);
+
+	// The debug overlay: every sentence is set every frame, but only the
+	// FPS line actually changes, and only once a second.
+	const DirectX::XMFLOAT4 white = { 1, 1, 1, 1 }, green = { 0, 1, 0, 1 };
+	TextBatcher batcher;
+	for (size_t i = 0; i < std::size(sentences); i++)
+		batcher.Add();
+	std::vector<VertexType> batched;
+	std::vector<TextBatcher::Draw> draws;
+	size_t frame = 0;
+	bench.Run("text overlay frame", "frames", 1.0, [&]() {
+		for (size_t i = 0; i < std::size(sentences); i++)
+		{
+			const char * text = i == 2 && (frame / 60) % 2 ? "FPS: 59 (t=17ms)" : sentences[i];
+			batcher.Update(i, atlas, 1, text, -400.0f, 300.0f - 20.0f * i, i == 3 ? green : white);
+		}
+		if (batcher.IsDirty())
+			batcher.Build(batched, draws);
+		s_sink += draws.size();
+		frame++;
+	});
+	batcher.TakeStats();
+
+	// Nothing changed: no layout, no rebuild.
+	for (size_t i = 0; i < std::size(sentences); i++)
+		batcher.Update(i, atlas, 1, batcher.GetText(i).c_str(), -400.0f, 300.0f - 20.0f * i, i == 3 ? green : white);
+	auto stats = batcher.TakeStats();
+	if (stats.rebuiltGlyphs != 0 || batcher.IsDirty())
+		throw std::runtime_error(FormatString("Unchanged text rebuilt %zu glyphs", stats.rebuiltGlyphs).data());
+
+	// Two colours, two draws, and the quads are the same ones a direct layout
+	// gives, white sentences first.
+	batcher.Update(2, atlas, 1, sentences[2], -400.0f, 260.0f, white);
+	batcher.Build(batched, draws);
+	std::vector<VertexType> expected;
+	for (size_t i : { 0, 1, 2, 4, 5, 3 })
+	{
+		size_t quads = atlas.BuildVertexArray(vertices.data(), sentences[i], -400.0f, 300.0f - 20.0f * i);
+		expected.insert(expected.end(), vertices.begin(), vertices.begin() + 4 * quads);
+	}
+	if (draws.size() != 2 || batched.size() != expected.size() ||
+		std::memcmp(batched.data(), expected.data(), sizeof(VertexType) * expected.size()) != 0)
+		throw std::runtime_error(FormatString("Batched text does not match: %zu draws", draws.size()).data());
+	std::printf("text overlay: %zu glyphs in %zu draws instead of %zu\n",
+		batched.size() / 4, draws.size(), std::size(sentences));
+}
+
+
+// What Fonts does at startup, without and with the atlas cache.
+static void BenchFontCache(Benchmark & bench, const std::string & dataDir)
+{
+	FT_Library library;
+	if (FT_Init_FreeType(&library))
+		throw std::runtime_error("Could not initialize FreeType");
+	std::unique_ptr<FT_LibraryRec_, decltype(&FT_Done_FreeType)> libraryOwner(library, FT_Done_FreeType);
+
+	const FT_UInt size = 32;
+	const auto mode = FontAtlas::Mode::DistanceField;
+	auto fonts = ReadFonts(dataDir + "/fonts.dat");
+	auto cacheDir = std::filesystem::temp_directory_path() / "engine-benchmark-fonts";
+	std::filesystem::remove_all(cacheDir);
+	std::vector<std::string> paths;
+	for (size_t i = 0; i < fonts.size(); i++)
+		paths.push_back((cacheDir / FormatString("font%zu.dat", i).data()).string());
+
+	std::vector<FontAtlas> fresh(fonts.size()), cached(fonts.size());
+	bench.Run("font startup uncached", "fonts", double(fonts.size()), [&]() {
+		for (size_t i = 0; i < fonts.size(); i++)
+			if (!fresh[i].LoadTTF(library, fonts[i].data(), static_cast<FT_Long>(fonts[i].size()), size, mode))
+				throw std::runtime_error("Could not load font");
+	});
+
+	// The first run writes the cache, every later one maps it.
+	for (size_t i = 0; i < fonts.size(); i++)
+		cached[i].LoadCachedTTF(library, fonts[i].data(), static_cast<FT_Long>(fonts[i].size()), size, mode, paths[i].data());
+	bench.Run("font startup cached", "fonts", double(fonts.size()), [&]() {
+		for (size_t i = 0; i < fonts.size(); i++)
+			if (!cached[i].LoadCachedTTF(library, fonts[i].data(), static_cast<FT_Long>(fonts[i].size()), size, mode, paths[i].data()))
+				throw std::runtime_error("Could not load font");
+	});
+
+	// A cache hit has to be indistinguishable from rasterizing, including
+	// where glyphs asked for later end up.
+	for (size_t i = 0; i < fonts.size(); i++)
+	{
+		auto & a = fresh[i];
+		auto & b = cached[i];
+		for (char32_t c : { U'A', U'g', U'~', U'\u00e9', U'\u0416', U'\u03a9' })
+		{
+			if (std::memcmp(a.GetGlyph(c), b.GetGlyph(c), sizeof(FontAtlas::Glyph)) != 0)
+				throw std::runtime_error(FormatString("Cached font %zu has a different U+%04X", i, unsigned(c)).data());
+		}
+		bool samePages = a.GetPageSize() == b.GetPageSize() && a.GetPageCount() == b.GetPageCount() &&
+			a.GetLineHeight() == b.GetLineHeight();
+		for (size_t page = 0; samePages && page < a.GetPageCount(); page++)
+			samePages = std::memcmp(a.GetPixels(page), b.GetPixels(page), a.GetPageSize() * a.GetPageSize()) == 0;
+		if (!samePages)
+			throw std::runtime_error(FormatString("Cached font %zu has different pages", i).data());
+	}
+
+	// Anything else is a miss: another size, or a file cut short.
+	std::ifstream file(paths[0], std::ios::binary);
+	std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	auto data = reinterpret_cast<const std::byte *>(bytes.data());
+	FontAtlas stale;
+	if (stale.LoadCache(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), 16, mode, data, bytes.size()) ||
+		stale.LoadCache(library, fonts[0].data(), static_cast<FT_Long>(fonts[0].size()), size, mode, data, bytes.size() / 2))
+		throw std::runtime_error("Loaded a font cache that does not match");
+	std::printf("font cache: %zu fonts, %zu KiB\n", fonts.size(), bytes.size() / 1024);
+
+	std::filesystem::remove_all(cacheDir);
+}
+
+
+// A DDS file in memory: the 128 byte header, the DX10 one if format is not
+// UNKNOWN, then payload bytes of pixels counting up.
+static std::vector<std::byte> MakeDDS(uint32_t width, uint32_t height, uint32_t mips,
+	uint32_t fourCC, uint32_t caps2, DXGI_FORMAT format, uint32_t arraySize, uint32_t miscFlag, size_t payload)
+{
+	uint32_t header[32] = {};
+	header[0] = 0x20534444; // "DDS "
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+	header[3] = height;
+	header[4] = width;
+	header[7] = mips;
+	header[19] = 32;
+	header[20] = 0x4; // DDPF_FOURCC
+	header[21] = format != DXGI_FORMAT_UNKNOWN ? 0x30315844 : fourCC; // "DX10"
+	header[27] = 0x1000;
+	header[28] = caps2;
+
+	std::vector<std::byte> file(sizeof(header));
+	std::memcpy(file.data(), header, sizeof(header));
+	if (format != DXGI_FORMAT_UNKNOWN)
+	{
+		uint32_t extension[5] = { uint32_t(format), 3, miscFlag, arraySize, 0 };
+		file.resize(file.size() + sizeof(extension));
+		std::memcpy(file.data() + sizeof(header), extension, sizeof(extension));
+	}
+	for (size_t i = 0; i < payload; i++)
+		file.push_back(std::byte(i));
+	return file;
+}
+
+
+static void CheckDDS()
+{
+	// BC7 4 slices of 20x12 with every mip: blocks of 5x3, 3x2, 2x1, 1x1, 1x1.
+	size_t perSlice = 16 * (15 + 6 + 2 + 1 + 1);
+	auto file = MakeDDS(20, 12, 5, 0, 0, DXGI_FORMAT_BC7_UNORM, 4, 0, 4 * perSlice);
+	DDSFile array(file.data(), file.size());
+	if (array.GetMipCount() != 5 || array.GetArraySize() != 4 || array.IsCubeMap()
+		|| array.GetSurfaces().size() != 20 || array.GetSize() != 4 * perSlice)
+		throw std::runtime_error("BC7 array parsed wrong");
+	const DDSFile::Surface & last = array.GetSurface(4, 3);
+	if (last.width != 1 || last.height != 1 || last.rowPitch != 16
+		|| last.pixels + last.size != file.data() + file.size())
+		throw std::runtime_error("BC7 array surfaces in the wrong place");
+	if (array.GetSurface(1, 0).rowPitch != 48 || array.GetSurface(0, 1).pixels != file.data() + 148 + perSlice)
+		throw std::runtime_error("BC7 array pitches are wrong");
+
+	// A DX10 cube array is six slices a cube.
+	file = MakeDDS(8, 8, 1, 0, 0, DXGI_FORMAT_BC1_UNORM, 2, 0x4, 12 * 32);
+	DDSFile cubes(file.data(), file.size());
+	if (!cubes.IsCubeMap() || cubes.GetArraySize() != 12)
+		throw std::runtime_error("DX10 cube array parsed wrong");
+
+	// A legacy DXT1 cube map with mips, and no rounding away of odd sizes.
+	file = MakeDDS(16, 16, 5, 0x31545844, 0x200 | 0xfc00, DXGI_FORMAT_UNKNOWN, 1, 0, 6 * 8 * (16 + 4 + 1 + 1 + 1));
+	DDSFile cube(file.data(), file.size());
+	if (!cube.IsCubeMap() || cube.GetArraySize() != 6 || cube.GetMipCount() != 5
+		|| cube.GetFormat() != DXGI_FORMAT_BC1_UNORM || cube.GetSurfaces().size() != 30)
+		throw std::runtime_error("DXT1 cube map parsed wrong");
+	file = MakeDDS(10, 6, 1, 0x31545844, 0, DXGI_FORMAT_UNKNOWN, 1, 0, 8 * 3 * 2);
+	DDSFile odd(file.data(), file.size());
+	if (odd.GetWidth() != 10 || odd.GetHeight() != 6 || odd.GetPitch() != 24)
+		throw std::runtime_error("10x6 BC1 parsed wrong");
+
+	// A partial cube map, too many mips, a byte short, a surface whose size
+	// wraps in 32 bits and array sizes too large for the file all fail.
+	auto rejects = [](std::vector<std::byte> bad) {
+		try
+		{
+			DDSFile dds(bad.data(), bad.size());
+		}
+		catch (std::invalid_argument &)
+		{
+			return true;
+		}
+		return false;
+	};
+	if (!rejects(MakeDDS(16, 16, 5, 0x31545844, 0x200 | 0x400, DXGI_FORMAT_UNKNOWN, 1, 0, 4096))
+		|| !rejects(MakeDDS(4, 4, 4, 0x31545844, 0, DXGI_FORMAT_UNKNOWN, 1, 0, 4096))
+		|| !rejects(MakeDDS(10, 6, 1, 0x31545844, 0, DXGI_FORMAT_UNKNOWN, 1, 0, 8 * 3 * 2 - 1))
+		|| !rejects(MakeDDS(16384, 16384, 1, 0, 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, 64))
+		|| !rejects(MakeDDS(8, 8, 1, 0, 0, DXGI_FORMAT_BC1_UNORM, 0x30000000, 0x4, 64))
+		|| !rejects(MakeDDS(8, 8, 1, 0, 0, DXGI_FORMAT_BC1_UNORM, 0x10000000, 0, 64))
+		|| !rejects(std::vector<std::byte>(100)))
+		throw std::runtime_error("Malformed DDS files were accepted");
+}
+
+
+static void BenchDDS(Benchmark & bench, const std::string & dataDir)
+{
+	CheckDDS();
+
+	auto filename = dataDir + "/seafloor.dds";
+	MappedFile file(filename.c_str());
+	DDSFile dds(file.GetData(), file.GetSize());
+	if (dds.GetPixels() != file.GetData() + 128 || dds.GetSize() != file.GetSize() - 128)
+		throw std::runtime_error("DDS pixels were copied out of the file");
+	size_t bytes = dds.GetSize();
+
+	bench.Run("dds parse", "bytes", double(bytes), [&]() {
+		DDSFile dds(filename.c_str());
+		s_sink += std::to_integer<uint64_t>(dds.GetPixels()[0]);
+	});
+}
+
+
+static void CheckAssetLoader()
+{
+	AssetLoader loader(2);
+	auto answer = loader.Load([]() { return 42; });
+	auto failed = loader.Load([]() -> int { throw std::runtime_error("expected"); });
+
+	std::vector<int> finished;
+	std::thread::id finishThread;
+	loader.Load([]() { return 1; }, [&](int value) {
+		finished.push_back(value);
+		finishThread = std::this_thread::get_id();
+	});
+	loader.Load([]() {}, [&]() { finished.push_back(2); });
+	loader.Load([]() -> int { throw std::runtime_error("expected"); }, [&](int) { finished.push_back(3); });
+
+	bool futureThrew = false;
+	try
+	{
+		failed.get();
+	}
+	catch (std::runtime_error &)
+	{
+		futureThrew = true;
+	}
+	if (answer.get() != 42 || !futureThrew)
+		throw std::runtime_error("Asset loader futures are wrong");
+
+	// A finish step runs on the thread that pumps, a failed load throws there.
+	int pumpThrew = 0;
+	while (!loader.IsIdle())
+	{
+		try
+		{
+			loader.Pump();
+		}
+		catch (std::runtime_error &)
+		{
+			pumpThrew++;
+		}
+		std::this_thread::yield();
+	}
+	std::sort(finished.begin(), finished.end());
+	if (finished != std::vector<int>({ 1, 2 }) || pumpThrew != 1
+		|| finishThread != std::this_thread::get_id() || loader.GetProgress() != 1.0f)
+		throw std::runtime_error("Asset loader finish steps are wrong");
+
+	// Closing while loads are queued drops them rather than waiting.
+	AssetLoader closing(1);
+	for (int i = 0; i < 1000; i++)
+		closing.Load([]() { std::this_thread::sleep_for(std::chrono::milliseconds(1)); });
+}
+
+
+// What GraphicsClass loads at startup, all on one thread against the same
+// work on the loader with the main thread pumping as it would each frame.
+static void BenchAssetLoading(Benchmark & bench, const std::string & dataDir)
+{
+	CheckAssetLoader();
+
+	FT_Library library;
+	if (FT_Init_FreeType(&library))
+		throw std::runtime_error("Could not initialize FreeType");
+	std::unique_ptr<FT_LibraryRec_, decltype(&FT_Done_FreeType)> libraryOwner(library, FT_Done_FreeType);
+
+	auto fonts = ReadFonts(dataDir + "/fonts.dat");
+	auto seafloor = dataDir + "/seafloor.dds";
+	auto loadFonts = [&]() {
+		std::vector<FontAtlas> atlases(fonts.size());
+		for (size_t i = 0; i < fonts.size(); i++)
+			if (!atlases[i].LoadTTF(library, fonts[i].data(), static_cast<FT_Long>(fonts[i].size()), 32, FontAtlas::Mode::DistanceField))
+				throw std::runtime_error("Could not load font");
+		return atlases;
+	};
+
+	bench.Run("startup on main thread", "loads", 3.0, [&]() {
+		auto atlases = loadFonts();
+		DDSFile first(seafloor.c_str()), second(seafloor.c_str());
+		s_sink += atlases.size() + first.GetSize() + second.GetSize();
+	});
+
+	AssetLoader loader;
+	std::chrono::duration<double, std::milli> longestStep{};
+	bench.Run("startup on loader", "loads", 3.0, [&]() {
+		loader.Load(loadFonts, [&](std::vector<FontAtlas> atlases) { s_sink += atlases.size(); });
+		for (int i = 0; i < 2; i++)
+			loader.Load([&]() { return DDSFile(seafloor.c_str()); }, [&](DDSFile dds) { s_sink += dds.GetSize(); });
+
+		while (!loader.IsIdle())
+		{
+			auto start = std::chrono::steady_clock::now();
+			loader.Pump(std::chrono::milliseconds(8));
+			longestStep = std::max<std::chrono::duration<double, std::milli>>(longestStep, std::chrono::steady_clock::now() - start);
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+	std::printf("asset loader: %u workers, longest main thread step %.3f ms\n",
+		loader.GetThreadCount(), longestStep.count());
+}
+
+
+static bool SameKey(const ShaderCache::Key & a, const ShaderCache::Key & b)
+{
+	return !(a < b) && !(b < a);
+}
+
+
+// The cache as ShaderLibrary uses it, against the real shader sources with
+// stand-in blobs, since there is no compiler here.
+static void BenchShaderCache(Benchmark & bench, const std::string & dataDir)
+{
+	std::vector<std::pair<std::string, std::string>> shaders;
+	for (const char * file : { "VertexShader.hlsl", "PixelShader.hlsl" })
+	{
+		std::ifstream infile(dataDir + "/../" + file);
+		if (!infile)
+			throw std::runtime_error(FormatString("Could not open %s", file).data());
+		shaders.emplace_back(file, std::string((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>()));
+	}
+	const std::vector<std::pair<const char *, const char *>> entries = {
+		{ "TextureVertexShader", "vs_5_0" }, { "PackedVertexShader", "vs_5_0" }, { "TileVertexShader", "vs_5_0" },
+		{ "TexturePixelShader", "ps_5_0" }, { "HSV2RGBPixelShader", "ps_5_0" }, { "RGBPixelShader", "ps_5_0" },
+		{ "SDFPixelShader", "ps_5_0" }, { "FontPixelShader", "ps_5_0" },
+	};
+	auto keyFor = [&](size_t i, uint32_t flags = 0x800) {
+		const auto & source = shaders[entries[i].second[0] == 'v' ? 0 : 1].second;
+		return ShaderCache::MakeKey(source, entries[i].first, entries[i].second, flags);
+	};
+
+	// Anything that changes the bytecode changes the key.
+	auto key = keyFor(0);
+	if (!SameKey(key, keyFor(0)) || SameKey(key, keyFor(1)) || SameKey(key, keyFor(0, 0x801))
+		|| SameKey(key, ShaderCache::MakeKey(shaders[0].second + " ", entries[0].first, "vs_5_0", 0x800))
+		|| SameKey(key, ShaderCache::MakeKey(shaders[0].second, entries[0].first, "vs_4_0", 0x800)))
+		throw std::runtime_error("Shader cache keys collide");
+
+	// Compiles once per key, however often it is asked.
+	ShaderCache cache(47);
+	size_t compiles = 0;
+	auto compile = [&]() {
+		compiles++;
+		return ShaderCache::Bytecode(1024 + 64 * compiles, std::byte(compiles));
+	};
+	for (int round = 0; round < 3; round++)
+		for (size_t i = 0; i < entries.size(); i++)
+			cache.GetOrCompile(keyFor(i), compile);
+	if (compiles != entries.size() || cache.GetMisses() != entries.size()
+		|| cache.GetHits() != 2 * entries.size() || !cache.IsDirty())
+		throw std::runtime_error("Shader cache compiled more than once");
+
+	// What is saved loads back the same, and only for the same compiler.
+	std::ostringstream stream;
+	cache.Save(stream);
+	std::string file = stream.str();
+	auto data = reinterpret_cast<const std::byte *>(file.data());
+	ShaderCache loaded(47), otherCompiler(48), truncated(47);
+	if (!loaded.Load(data, file.size()) || loaded.GetCount() != entries.size() || loaded.IsDirty())
+		throw std::runtime_error("Shader cache did not load");
+	for (size_t i = 0; i < entries.size(); i++)
+	{
+		auto blob = loaded.Find(keyFor(i));
+		if (blob == nullptr || *blob != *cache.Find(keyFor(i)))
+			throw std::runtime_error("Shader cache loaded the wrong bytecode");
+	}
+	if (otherCompiler.Load(data, file.size()) || truncated.Load(data, file.size() - 1) || truncated.GetCount() != 0)
+		throw std::runtime_error("Loaded a shader cache that does not match");
+
+	auto path = std::filesystem::temp_directory_path() / "engine-benchmark-shaders" / "shaders.dat";
+	if (!cache.Save(path.string().data()) || cache.IsDirty() || !ShaderCache(47).Load(path.string().data()))
+		throw std::runtime_error("Shader cache file did not round trip");
+	std::filesystem::remove_all(path.parent_path());
+
+	bench.Run("shader cache load", "shaders", double(entries.size()), [&]() {
+		ShaderCache startup(47);
+		startup.Load(data, file.size());
+		s_sink += startup.GetCount();
+	});
+	bench.Run("shader cache lookup", "shaders", double(entries.size()), [&]() {
+		for (size_t i = 0; i < entries.size(); i++)
+			s_sink += loaded.Find(keyFor(i))->size();
+	});
+	std::printf("shader cache: %zu shaders, %zu KiB\n", entries.size(), file.size() / 1024);
+}
+
+
+// One draw the way ShaderClass and TextClass make it, against stand-in
+// objects, returning how many context calls would have gone through.
+static size_t TrackDraw(StateTracker & tracker, const void * const * objects, const float * matrices, const float * color)
+{
+	using Stage = StateTracker::Stage;
+	size_t calls = 0;
+	calls += tracker.Bind(Stage::VertexBuffer, 0, objects[0], uint64_t(sizeof(VertexType)) << 32);
+	calls += tracker.Bind(Stage::IndexBuffer, 0, objects[1], 57);
+	calls += tracker.Bind(Stage::Topology, 0, nullptr, 4);
+	calls += tracker.Update(objects[2], matrices, 3 * 16 * sizeof(float));
+	calls += tracker.Bind(Stage::VertexConstants, 0, objects[2]);
+	calls += tracker.Bind(Stage::PixelResource, 0, objects[3]);
+	calls += tracker.Update(objects[4], color, 4 * sizeof(float));
+	calls += tracker.Bind(Stage::PixelConstants, 0, objects[4]);
+	calls += tracker.Bind(Stage::InputLayout, 0, objects[5]);
+	calls += tracker.Bind(Stage::VertexShader, 0, objects[6]);
+	calls += tracker.Bind(Stage::PixelShader, 0, objects[7]);
+	calls += tracker.Bind(Stage::PixelSampler, 0, objects[8]);
+	return calls;
+}
+
+
+static void BenchStateTracker(Benchmark & bench)
+{
+	using Stage = StateTracker::Stage;
+	int handles[10];
+	const void * objects[9];
+	for (int i = 0; i < 9; i++)
+		objects[i] = &handles[i];
+	float matrices[48] = { 1.0f }, white[4] = { 1, 1, 1, 1 }, green[4] = { 0, 1, 0, 1 };
+
+	// The first draw binds everything, an identical one nothing, and one in
+	// another colour only writes the new colour.
+	StateTracker tracker;
+	RenderStats::EndFrame();
+	if (TrackDraw(tracker, objects, matrices, white) != 12 || TrackDraw(tracker, objects, matrices, white) != 0
+		|| TrackDraw(tracker, objects, matrices, green) != 1)
+		throw std::runtime_error("State tracker let the wrong calls through");
+
+	// Details count, untracked slots always go through, and Invalidate
+	// forgets both bindings and contents.
+	if (!tracker.Bind(Stage::VertexBuffer, 0, objects[0], 1) || !tracker.Bind(Stage::PixelResource, 9, objects[3])
+		|| !tracker.Bind(Stage::PixelResource, 9, objects[3]))
+		throw std::runtime_error("State tracker skipped a changed binding");
+	tracker.Invalidate();
+	if (TrackDraw(tracker, objects, matrices, green) != 12)
+		throw std::runtime_error("State tracker remembered state past Invalidate");
+
+	auto stats = RenderStats::Current();
+	RenderStats::EndFrame();
+	if (stats.constantUploads != 5 || stats.constantUploadsSkipped != 3
+		|| stats.stateBinds + stats.stateBindsSkipped != 4 * 10 + 3)
+		throw std::runtime_error("State tracker counted wrong");
+
+	// A frame of the overlay: one draw per sentence, same matrices, two
+	// colours, then the tiles with their own shader and texture.
+	const size_t draws = 64;
+	size_t calls = 0;
+	bench.Run("state tracker frame", "draws", double(draws), [&]() {
+		tracker.Invalidate();
+		calls = 0;
+		for (size_t i = 0; i < draws; i++)
+			calls += TrackDraw(tracker, objects, matrices, i % 8 == 0 ? green : white);
+		s_sink += calls;
+	});
+	RenderStats::EndFrame();
+	std::printf("state tracker: %zu of %zu calls made for %zu draws\n", calls, draws * 12, draws);
+}
+
+
+// Stands in for a chunk of world generation: enough arithmetic per index
+// that splitting it up pays off.
+static double Crunch(size_t first, size_t last)
+{
+	double sum = 0.0;
+	for (size_t i = first; i < last; i++)
+		for (int j = 1; j < 2000; j++)
+			sum += std::sqrt(double(i * j % 977));
+	return sum;
+}
+
+
+static void BenchJobSystem(Benchmark & bench)
+{
+	// Every index exactly once, from ranges of all sizes, even without workers.
+	JobSystem alone(0);
+	for (JobSystem * system : { &alone, &JobSystem::Get() })
+	{
+		std::vector<std::atomic<int>> hits(10007);
+		system->ParallelFor(0, hits.size(), 64, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; i++)
+				hits[i]++;
+		});
+		if (std::any_of(hits.begin(), hits.end(), [](const std::atomic<int> & hit) { return hit != 1; }))
+			throw std::runtime_error("Parallel for missed or repeated an index");
+	}
+
+	// Children keep their parent's counter open, a job can wait on its own,
+	// and the first error reaches whoever waits.
+	JobSystem & jobs = JobSystem::Get();
+	std::atomic<int> done = 0;
+	JobSystem::Counter parent;
+	for (int i = 0; i < 8; i++)
+		jobs.Run(parent, [&]() {
+			for (int j = 0; j < 8; j++)
+				jobs.Run(parent, [&]() { done++; });
+			JobSystem::Counter inner;
+			jobs.Run(inner, [&]() { done++; });
+			jobs.Wait(inner);
+		});
+	jobs.Wait(parent);
+	if (done != 8 * 9)
+		throw std::runtime_error(FormatString("Job system ran %d of %d jobs", int(done), 8 * 9).data());
+
+	JobSystem::Counter failing;
+	jobs.Run(failing, []() { throw std::logic_error("job failed"); });
+	jobs.Run(failing, [&]() { done++; });
+	bool hasThrown = false;
+	try
+	{
+		jobs.Wait(failing);
+	}
+	catch (std::logic_error &)
+	{
+		hasThrown = true;
+	}
+	if (!hasThrown || done != 8 * 9 + 1)
+		throw std::runtime_error("Job system lost an exception");
+
+	// What it costs to hand out and wait for an empty job from outside.
+	const size_t count = 1000;
+	bench.Run("job spawn and wait", "jobs", double(count), [&]() {
+		JobSystem::Counter counter;
+		for (size_t i = 0; i < count; i++)
+			jobs.Run(counter, []() {});
+		jobs.Wait(counter);
+	});
+
+	// And from a job, onto its worker's own deque. At least two workers so
+	// there is someone to steal them, even on one core.
+	JobSystem stealing(std::max(jobs.GetWorkerCount(), 2u));
+	bench.Run("job spawn from job", "jobs", double(count), [&]() {
+		JobSystem::Counter counter;
+		stealing.Run(counter, [&]() {
+			for (size_t i = 0; i < count; i++)
+				stealing.Run(counter, []() {});
+		});
+		stealing.Wait(counter);
+	});
+	std::printf("job steals: %zu with %u workers\n", stealing.GetStealCount(), stealing.GetWorkerCount());
+
+	// The same work over one more thread at a time, up to the core count.
+	const size_t items = 4096;
+	unsigned cores = std::max(std::thread::hardware_concurrency(), 1u);
+	double single = 0.0;
+	for (unsigned threads = 1; threads <= cores; threads++)
+	{
+		JobSystem system(threads - 1);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<double> sums((items + 63) / 64);
+		size_t runs = 0;
+		do
+		{
+			system.ParallelFor(0, items, 64, [&](size_t first, size_t last) { sums[first / 64] = Crunch(first, last); });
+			runs++;
+		} while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(250));
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / runs;
+		if (threads == 1)
+			single = seconds;
+		s_sink += uint64_t(sums[0]);
+		std::printf("job scaling: %2u threads %10.3f ms/run x%.2f\n", threads, seconds * 1e3, single / seconds);
+	}
+}
+
+
+static const Profiler::ScopeTotal * FindScope(const char * name, uint32_t depth)
+{
+	for (const auto & total : Profiler::LastFrame())
+		if (std::strcmp(total.name, name) == 0 && total.depth == depth)
+			return &total;
+	return nullptr;
+}
+
+
+static void BenchProfiler(Benchmark & bench)
+{
+	Profiler::SetEnabled(true);
+	Profiler::EndFrame();
+
+	// Nesting comes out of the times alone, and repeats add up.
+	{
+		PROFILE_SCOPE("outer");
+		for (int i = 0; i < 2; i++)
+		{
+			PROFILE_SCOPE("inner");
+		}
+	}
+	std::thread([]() {
+		Profiler::SetThreadName("Profiled thread");
+		PROFILE_SCOPE("other thread");
+	}).join();
+	Profiler::EndFrame();
+
+	auto outer = FindScope("outer", 0), inner = FindScope("inner", 1), other = FindScope("other thread", 0);
+	if (outer == nullptr || inner == nullptr || other == nullptr || outer->calls != 1 || inner->calls != 2
+		|| inner->nanoseconds > outer->nanoseconds)
+		throw std::runtime_error("Profiler got the scopes of a frame wrong");
+	if (Profiler::LastFrame().front().thread != outer->thread || other->thread == outer->thread
+		|| Profiler::GetThreadName(other->thread) != "Profiled thread")
+		throw std::runtime_error("Profiler mixed up its threads");
+
+	// Scopes are timed in clock ticks, but reported in nanoseconds.
+	{
+		PROFILE_SCOPE("sleep");
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	Profiler::EndFrame();
+	auto slept = FindScope("sleep", 0);
+	if (slept == nullptr || slept->nanoseconds < 4900000 || slept->nanoseconds > 500000000)
+		throw std::runtime_error("Profiler got the length of a scope wrong");
+
+	// Nothing while disabled, and what doesn't fit is counted.
+	Profiler::SetEnabled(false);
+	{
+		PROFILE_SCOPE("disabled");
+	}
+	Profiler::SetEnabled(true);
+	size_t dropped = Profiler::GetDroppedCount();
+	for (int i = 0; i < 10000; i++)
+	{
+		PROFILE_SCOPE("overflow");
+	}
+	Profiler::EndFrame();
+	auto overflow = FindScope("overflow", 0);
+	dropped = Profiler::GetDroppedCount() - dropped;
+	if (FindScope("disabled", 0) != nullptr || overflow == nullptr || dropped == 0 || overflow->calls + dropped != 10000)
+		throw std::runtime_error("Profiler recorded the wrong scopes");
+
+	// A capture holds every frame until it is written.
+	Profiler::StartCapture();
+	for (int frame = 0; frame < 3; frame++)
+	{
+		{
+			PROFILE_SCOPE("captured \"frame\"");
+		}
+		Profiler::EndFrame();
+	}
+	std::ostringstream trace;
+	Profiler::StopCapture(trace);
+	std::string json = trace.str();
+	size_t events = 0;
+	for (size_t at = json.find("\"ph\":\"X\""); at != std::string::npos; at = json.find("\"ph\":\"X\"", at + 1))
+		events++;
+	if (events != 3 || json.find("\"name\":\"captured \\\"frame\\\"\"") == std::string::npos
+		|| json.find("\"ph\":\"M\"") == std::string::npos || json.front() != '{' || json.find("],\"displayTimeUnit\"") == std::string::npos
+		|| Profiler::IsCapturing())
+		throw std::runtime_error("Profiler wrote a bad trace");
+
+	// What a scope costs, timed without the EndFrames in between.
+	auto perScope = [](bool isEnabled) {
+		Profiler::SetEnabled(isEnabled);
+		std::chrono::duration<double> spent{};
+		size_t scopes = 0;
+		while (spent.count() < 0.25)
+		{
+			auto start = std::chrono::steady_clock::now();
+			for (int i = 0; i < 4096; i++)
+			{
+				PROFILE_SCOPE("overhead");
+			}
+			spent += std::chrono::steady_clock::now() - start;
+			scopes += 4096;
+			Profiler::EndFrame();
+		}
+		Profiler::SetEnabled(true);
+		return spent.count() / scopes * 1e9;
+	};
+	double enabled = perScope(true), disabled = perScope(false);
+
+	// Two of these are the bulk of an enabled scope, and are up to the
+	// machine: a VM may take several times what real hardware does.
+	const size_t reads = 1 << 20;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < reads; i++)
+		s_sink += Profiler::Now();
+	double clock = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / reads;
+	std::printf("profiler scope: %.1f ns enabled, %.1f ns disabled, clock read %.1f ns\n", enabled, disabled, clock);
+
+	bench.Run("profiler end frame", "scopes", 4096.0, [&]() {
+		for (int i = 0; i < 64; i++)
+		{
+			PROFILE_SCOPE("parent");
+			for (int j = 0; j < 63; j++)
+			{
+				PROFILE_SCOPE("child");
+			}
+		}
+		Profiler::EndFrame();
+	});
+}
+
+
+static void BenchFrameStats(Benchmark & bench)
+{
+	using std::chrono::milliseconds;
+
+	// Percentiles are the top of their 0.1 ms bucket.
+	auto near = [](double a, double b) { return std::abs(a - b) < 0.1 + 1e-6; };
+
+	// Steady frames, then a hitch in every fifty: too few to move p95,
+	// enough to show in p99.
+	FrameStats stats(milliseconds(17));
+	for (int i = 0; i < 600; i++)
+		stats.AddFrame(milliseconds(16));
+	auto steady = stats.GetWindow();
+	if (steady.frames != 600 || steady.hitches != 0 || !near(steady.p50, 16.0) || !near(steady.p99, 16.0)
+		|| !near(steady.mean, 16.0) || !near(steady.max, 16.0))
+		throw std::runtime_error("Frame stats got steady frames wrong");
+
+	size_t hitches = 0;
+	for (int i = 0; i < 600; i++)
+		hitches += stats.AddFrame(milliseconds(i % 50 == 0 ? 50 : 16));
+	auto stutter = stats.GetWindow();
+	if (hitches != 12 || stutter.hitches != 12 || !near(stutter.p50, 16.0) || !near(stutter.p95, 16.0)
+		|| !near(stutter.p99, 50.0) || !near(stutter.max, 50.0))
+		throw std::runtime_error(FormatString("Frame stats missed the stutter: p95 %.1f, p99 %.1f, %zu hitches",
+			stutter.p95, stutter.p99, stutter.hitches).data());
+
+	// The window forgets, slowest frame included, and frames past the
+	// histogram still count at their own length.
+	for (int i = 0; i < 600; i++)
+		stats.AddFrame(milliseconds(10));
+	auto recovered = stats.GetWindow();
+	if (recovered.hitches != 0 || !near(recovered.max, 10.0) || !near(recovered.p99, 10.0))
+		throw std::runtime_error("Frame stats kept frames past the window");
+	stats.AddFrame(milliseconds(500));
+	if (!near(stats.GetWindow().max, 500.0) || !near(stats.GetWindow().p99, 10.0))
+		throw std::runtime_error("Frame stats clipped a long frame");
+	stats.SetBudget(milliseconds(5));
+	if (!stats.AddFrame(milliseconds(10)))
+		throw std::runtime_error("Frame stats ignored a new budget");
+
+	// 16 ms frames close a second every 63. Each second runs a little over,
+	// so the 26.1 s so far make 25 of them, and the CSV has a row for each.
+	size_t seconds = stats.GetSecondCount();
+	std::ostringstream csv;
+	stats.WriteCsv(csv);
+	std::string text = csv.str();
+	if (seconds != 25 || stats.GetSecond(0).index != 0 || stats.GetSecond(0).summary.frames != 63
+		|| size_t(std::count(text.begin(), text.end(), '\n')) != seconds + 1
+		|| text.compare(0, 15, "second,frames,h") != 0)
+		throw std::runtime_error(FormatString("Frame stats kept %zu seconds", seconds).data());
+
+	// Only the latest seconds are kept.
+	FrameStats recent(milliseconds(17), 10, 3);
+	for (int i = 0; i < 5; i++)
+		recent.AddFrame(std::chrono::seconds(1));
+	if (recent.GetSecondCount() != 3 || recent.GetSecond(0).index != 2 || recent.GetSecond(2).index != 4)
+		throw std::runtime_error("Frame stats kept the wrong seconds");
+
+	// A minute of noisy frames, as CpuClass feeds them.
+	stats.SetBudget(milliseconds(20));
+	std::mt19937 random(7);
+	std::lognormal_distribution<double> frameTimes(std::log(16.0), 0.2);
+	std::vector<FrameStats::Duration> frames(3600);
+	for (auto & frame : frames)
+		frame = std::chrono::duration_cast<FrameStats::Duration>(std::chrono::duration<double, std::milli>(frameTimes(random)));
+	FrameStats::Summary summary;
+	bench.Run("frame stats add", "frames", double(frames.size()), [&]() {
+		for (auto frame : frames)
+			stats.AddFrame(frame);
+	});
+	bench.Run("frame stats summary", "summaries", 1.0, [&]() {
+		summary = stats.GetWindow();
+	});
+	std::printf("frame stats: p50 %.1f p95 %.1f p99 %.1f max %.1f ms, %zu hitches in %zu frames\n",
+		summary.p50, summary.p95, summary.p99, summary.max, summary.hitches, summary.frames);
+}
+
+
+static size_t s_overruns = 0;
+
+
+static void BenchAllocationTracker(Benchmark & bench)
+{
+	using Subsystem = AllocationTracker::Subsystem;
+
+	// Scopes nest, whether or not anything is counted.
+	{
+		ALLOCATION_SCOPE(Tiles);
+		{
+			ALLOCATION_SCOPE(Text);
+			if (AllocationTracker::GetCurrent() != Subsystem::Text)
+				throw std::runtime_error("Allocation scope did not take");
+		}
+		if (AllocationTracker::GetCurrent() != Subsystem::Tiles)
+			throw std::runtime_error("Allocation scope did not restore the one before");
+	}
+	if (!AllocationTracker::IsTracking())
+	{
+		std::printf("allocation tracker: compiled out, configure with ENGINE_TRACK_ALLOCATIONS=ON\n");
+		return;
+	}
+	AllocationTracker::EndFrame();
+
+	// Blocks count against where they were allocated, even when freed
+	// elsewhere.
+	std::vector<int> kept;
+	{
+		ALLOCATION_SCOPE(Tiles);
+		kept.resize(1000);
+		for (int i = 0; i < 9; i++)
+			::operator delete(::operator new(sizeof(int)));
+	}
+	AllocationTracker::EndFrame();
+	auto tiles = AllocationTracker::LastFrame(Subsystem::Tiles);
+	if (tiles.allocations != 10 || tiles.bytes != 1000 * sizeof(int) + 9 * sizeof(int)
+		|| tiles.liveBytes != 1000 * sizeof(int) || tiles.peakBytes < tiles.liveBytes)
+		throw std::runtime_error(FormatString("Allocation tracker counted %zu allocations of %zu bytes, %zu live",
+			tiles.allocations, tiles.bytes, tiles.liveBytes).data());
+	{
+		ALLOCATION_SCOPE(Text);
+		kept = std::vector<int>();
+	}
+	AllocationTracker::EndFrame();
+	if (AllocationTracker::LastFrame(Subsystem::Tiles).liveBytes != 0 || AllocationTracker::LastFrame(Subsystem::Tiles).allocations != 0
+		|| AllocationTracker::LastFrame(Subsystem::Text).allocations != 0)
+		throw std::runtime_error("Allocation tracker freed against the wrong subsystem");
+
+	// Jobs count against whoever ran them.
+	JobSystem jobs(1);
+	{
+		ALLOCATION_SCOPE(Gui);
+		jobs.ParallelFor(0, 64, 1, [](size_t, size_t) { s_sink += *std::make_unique<int>(1); });
+	}
+	AllocationTracker::EndFrame();
+	if (AllocationTracker::LastFrame(Subsystem::Gui).allocations < 64)
+		throw std::runtime_error("Jobs lost their allocation subsystem");
+
+	// Going over budget reaches the handler once per subsystem and frame.
+	AllocationTracker::SetOverrunHandler([](Subsystem subsystem, const AllocationTracker::Counters &, const AllocationTracker::Budget &) {
+		s_overruns += subsystem == Subsystem::Text ? 1 : 100;
+	});
+	AllocationTracker::SetBudget(Subsystem::Text, { 5, 0, 0 });
+	for (int frame = 0; frame < 2; frame++)
+	{
+		ALLOCATION_SCOPE(Text);
+		for (int i = 0; i < 5 + frame; i++)
+			::operator delete(::operator new(sizeof(int)));
+		AllocationTracker::EndFrame();
+	}
+	AllocationTracker::SetBudget(Subsystem::Text, { 0, 0, 0 });
+	AllocationTracker::SetOverrunHandler(nullptr);
+	if (s_overruns != 1)
+		throw std::runtime_error("Allocation budget overruns went unreported");
+
+	// Called directly, as new expressions may be left out altogether.
+	bench.Run("tracked new and delete", "allocations", 1000.0, [&]() {
+		ALLOCATION_SCOPE(Tiles);
+		for (int i = 0; i < 1000; i++)
+			::operator delete(::operator new(sizeof(int)));
+	});
+
+	// What streaming costs in allocations while panning across the world.
+	TileMap map(1000, 1000);
+	map.Generate();
+	std::vector<int> loaded, evicted;
+	size_t frames = 300, total = 0, most = 0;
+	AllocationTracker::EndFrame();
+	for (size_t frame = 0; frame < frames; frame++)
+	{
+		{
+			ALLOCATION_SCOPE(Tiles);
+			loaded.clear();
+			evicted.clear();
+			map.Stream(TileMap::ViewFromCamera(16.0f * frame, -16.0f * frame, 800, 600), 4, loaded, evicted);
+		}
+		AllocationTracker::EndFrame();
+		total += AllocationTracker::LastFrame(Subsystem::Tiles).allocations;
+		most = std::max(most, AllocationTracker::LastFrame(Subsystem::Tiles).allocations);
+	}
+	std::printf("allocation tracker: streaming %.1f allocations a frame, at most %zu, tiles peak %zu KiB\n",
+		double(total) / frames, most, AllocationTracker::LastFrame(Subsystem::Tiles).peakBytes / 1024);
+}
+
+
+int main(int argc, char * argv[])
+{
+	std::string dataDir = argc > 1 ? argv[1] : ENGINE_DATA_DIR;
+	Benchmark bench(0.25);
+
+	try
+	{
+		BenchWorldGeneration(bench, 55, 55);
+		BenchWorldGeneration(bench, 256, 256);
+		BenchWorldStreaming(bench, 10000, 10000);
+		BenchPicking(bench, 55, 55);
+		BenchPicking(bench, 10000, 10000);
+		BenchPerlinNoise(bench, 55, 55);
+		BenchPerlinNoise(bench, 1024, 1024);
+		BenchCellular(bench, 55, 55);
+		BenchCellular(bench, 1000, 1000);
+		BenchVertexBuilding(bench, 55, 55);
+		BenchVertexBuilding(bench, 256, 256);
+		BenchVertexPacking(bench, 256, 256);
+		BenchTileInstances(bench, 256, 256);
+		BenchQuadIndices(bench, 65536 / 4);
+		BenchDirtyUploads(bench, 55, 55);
+		BenchSaveLoad(bench, 55, 55);
+		BenchSaveLoad(bench, 256, 256);
+		BenchSnapshot(bench, 55, 55);
+		BenchSnapshot(bench, 256, 256);
+		BenchTickScheduler(bench);
+		BenchFrameStats(bench);
+		BenchText(bench, dataDir);
+		BenchFontCache(bench, dataDir);
+		BenchAssetLoading(bench, dataDir);
+		BenchDDS(bench, dataDir);
+		BenchShaderCache(bench, dataDir);
+		BenchStateTracker(bench);
+		BenchJobSystem(bench);
+		BenchProfiler(bench);
+		BenchAllocationTracker(bench);
+	}
+	catch (std::exception & e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -4,28 +4,44 @@
 #include "LargeBitmap.h"
 
 
+static bool SameRect(const RECT & a, const RECT & b)
+{
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+static bool SameColor(const DirectX::XMFLOAT4 & a, const DirectX::XMFLOAT4 & b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+
 LargeBitmap::LargeBitmap(
 	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext, ShaderClass * p_FontShader,
 	int screenWidth, int screenHeight, const char * filename)
 	:
-	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight)
+	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight, TextureClass(p_device, filename).GetTexture())
 {
-	TextureClass tex(p_device, filename);
-	m_texture = tex.GetTexture();
 }
 
 LargeBitmap::LargeBitmap(
 	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext, ShaderClass * p_FontShader,
 	int screenWidth, int screenHeight)
 	:
+	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight, TextureClass(p_device).GetTexture())
+{
+}
+
+LargeBitmap::LargeBitmap(
+	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext, ShaderClass * p_FontShader,
+	int screenWidth, int screenHeight, ID3D11ShaderResourceView * texture)
+	:
 	device(p_device),
 	deviceContext(pdeviceContext),
 	m_screenWidth(screenWidth),
 	m_screenHeight(screenHeight),
-	m_FontShader(p_FontShader)
+	m_FontShader(p_FontShader),
+	m_texture(texture)
 {
-	TextureClass tex(p_device);
-	m_texture = tex.GetTexture();
 }
 
 
@@ -33,36 +49,67 @@ void LargeBitmap::UpdateColoredRects(const std::vector<Geometry::ColoredRect<int
 {
 	m_rects = coloredRects;
 
-	if (indexBuffer == nullptr)
+	if (indexBuffer == nullptr || GetVertexCount() != vertexCount)
 		CreateBuffers();
-	UpdateBuffers();
+	else
+		m_dirty.Add(0, m_rects.size());
 }
 
 
+// The single rect setters only mark what actually changed; the upload
+// happens once, in Render.
 void LargeBitmap::UpdateColoredRect(int i, const Geometry::ColoredRect<int> & coloredRect)
 {
-	m_rects[i] = coloredRect;
-	UpdateBuffers();
+	auto & rect = m_rects[i];
+	if (SameRect(rect.rect, coloredRect.rect) && SameColor(rect.color, coloredRect.color) && rect.hidden == coloredRect.hidden)
+		return;
+	rect = coloredRect;
+	m_dirty.Add(i);
 }
 
 void LargeBitmap::UpdateColoredRect(int i, RECT val)
 {
+	if (SameRect(m_rects[i].rect, val))
+		return;
 	m_rects[i].rect = val;
-	UpdateBuffers();
+	m_dirty.Add(i);
 }
 
 void LargeBitmap::UpdateColoredRect(int i, bool val)
 {
+	if (m_rects[i].hidden == val)
+		return;
 	m_rects[i].hidden = val;
-	UpdateBuffers();
+	m_dirty.Add(i);
+}
+
+// Has to be picked before the buffers are first created.
+void LargeBitmap::SetVertexFormat(VertexFormat format, POINT origin)
+{
+	m_format = format;
+	m_origin = origin;
+	vertexBuffer = nullptr;
+	indexBuffer = nullptr;
 }
 
 void LargeBitmap::Render(const DirectX::XMMATRIX & worldMatrix, const DirectX::XMMATRIX & orthoMatrix, const DirectX::XMMATRIX & viewMatrix)
 {
+	UpdateBuffers();
 	RenderBuffers();
-	m_FontShader->Render(indexCount, worldMatrix, viewMatrix,
-		orthoMatrix, m_texture.Get(), {1,1,1,1});
+
+	// Packed positions are relative to the batch origin; put it back here.
+	auto world = m_format == VertexFormat::Packed
+		? DirectX::XMMatrixTranslation(static_cast<float>(m_origin.x), static_cast<float>(m_origin.y), 0.0f) * worldMatrix
+		: worldMatrix;
+	m_FontShader->Render(indexCount, world, viewMatrix,
+		orthoMatrix, m_texture.Get(), {1,1,1,1}, m_format);
+}
+
+size_t LargeBitmap::GetVertexStride() const
+{
+	return m_format == VertexFormat::Packed ? sizeof(PackedVertexType) : sizeof(VertexColorType);
 }
+
 size_t LargeBitmap::GetVertexCount()
 {
 	return 4 * m_rects.size();
@@ -73,21 +120,12 @@ size_t LargeBitmap::GetIndexCount()
 	return 6 * m_rects.size();
 }
 
-std::vector<unsigned long> LargeBitmap::BuildIndexArray()
+// Every quad batch draws with the same shared index buffer.
+void LargeBitmap::CreateIndexBuffer()
 {
-	auto indices = std::vector<unsigned long>(indexCount);
-	for (size_t i = 0, v = 0, iii = 0; i < m_rects.size(); i++, v += 6, iii += 4)
-	{
-		indices[v] = iii;
-		indices[v + 1] = iii + 1;
-		indices[v + 2] = iii + 2;
-
-		indices[v + 3] = iii + 1;
-		indices[v + 4] = iii + 3;
-		indices[v + 5] = iii + 2;
-	}
-
-	return indices;
+	auto binding = QuadIndexBuffer::Get(device, m_rects.size());
+	indexBuffer = binding.buffer;
+	indexFormat = binding.format;
 }
 
 void LargeBitmap::CreateBuffers()
@@ -95,110 +133,112 @@ void LargeBitmap::CreateBuffers()
 	vertexCount = GetVertexCount();
 	indexCount = GetIndexCount();
 
-	// Create the vertex buffer.
+	m_vertices.assign(vertexCount, VertexColorType());
+	BuildVertexArray(m_vertices.data(), 0, m_rects.size());
+	m_dirty.Clear();
+
+	const void * initialData = m_vertices.data();
+	if (m_format == VertexFormat::Packed)
+	{
+		m_packed.resize(vertexCount);
+		VertexBuilder::PackVertices(m_packed.data(), m_vertices.data(), vertexCount, m_origin);
+		initialData = m_packed.data();
+	}
+
+	// Create the vertex buffer. It is only ever written in parts through
+	// UpdateSubresource, so it can live in GPU memory.
 	D3D11_BUFFER_DESC vertexBufferDesc =
 	{
-		sizeof(VertexColorType) * vertexCount,
-		D3D11_USAGE_DYNAMIC,
-		D3D11_BIND_VERTEX_BUFFER,
-		D3D11_CPU_ACCESS_WRITE
+		static_cast<UINT>(GetVertexStride() * vertexCount),
+		D3D11_USAGE_DEFAULT,
+		D3D11_BIND_VERTEX_BUFFER
 	};
-	auto verts = std::make_unique<VertexColorType[]>(vertexCount);
-	D3D11_SUBRESOURCE_DATA vertexData = { verts.get() };
+	D3D11_SUBRESOURCE_DATA vertexData = { initialData };
 	ThrowIfFailed(
 		device->CreateBuffer(&vertexBufferDesc, &vertexData, vertexBuffer.GetAddressOf()),
 		"Could not create the vertex buffer."
 	);
+	RenderStats::Current().bytesUploaded += vertexBufferDesc.ByteWidth;
+	RenderStats::Current().uploads++;
 
-	D3D11_BUFFER_DESC indexBufferDesc =
-	{
-		sizeof(unsigned long) * indexCount,
-		D3D11_USAGE_DEFAULT,
-		D3D11_BIND_INDEX_BUFFER
-	};
-	auto i = BuildIndexArray();
-	D3D11_SUBRESOURCE_DATA indexData = { i.data() };
-
-	ThrowIfFailed(
-		device->CreateBuffer(&indexBufferDesc, &indexData, indexBuffer.GetAddressOf()),
-		"Could not create the index buffer."
-	);
+	CreateIndexBuffer();
 }
 
 void LargeBitmap::UpdateBuffers()
 {
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	if (m_dirty.Empty() || vertexBuffer == nullptr)
+		return;
+	PROFILE_SCOPE("LargeBitmap::UpdateBuffers");
 
-	// Lock the vertex buffer so it can be written to.
-	ThrowIfFailed(
-		deviceContext->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
-		"Could not lock the vertex buffer."
-	);
+	auto & stats = RenderStats::Current();
+	const size_t perRect = GetVerticesPerRect(), stride = GetVertexStride();
+	for (const auto & range : m_dirty.GetRanges())
+	{
+		BuildVertexArray(m_vertices.data(), range.begin, range.end - range.begin);
 
-	// Clear the vertex buffer.
-	std::memset(mappedResource.pData, 0, (sizeof(VertexColorType) * vertexCount));
+		const void * source = &m_vertices[range.begin * perRect];
+		if (m_format == VertexFormat::Packed)
+		{
+			VertexBuilder::PackVertices(&m_packed[range.begin * perRect], &m_vertices[range.begin * perRect],
+				(range.end - range.begin) * perRect, m_origin);
+			source = &m_packed[range.begin * perRect];
+		}
 
-	BuildVertexArray(mappedResource.pData);
+		// The driver stages the copy, so unlike mapping with NO_OVERWRITE
+		// this can't race the GPU still drawing last frame's vertices.
+		UINT
+			begin = static_cast<UINT>(range.begin * perRect * stride),
+			end = static_cast<UINT>(range.end * perRect * stride);
+		D3D11_BOX box = { begin, 0, 0, end, 1, 1 };
+		deviceContext->UpdateSubresource(vertexBuffer.Get(), 0, &box, source, 0, 0);
 
-	// Unlock the vertex buffer.
-	deviceContext->Unmap(vertexBuffer.Get(), 0);
+		stats.bytesUploaded += end - begin;
+		stats.uploads++;
+	}
+	m_dirty.Clear();
 }
 
-void LargeBitmap::BuildVertexArray(void* vertices)
+void LargeBitmap::BuildVertexArray(VertexColorType * vertices, size_t first, size_t count)
 {
-	VertexColorType* vertexPtr = (VertexColorType*)vertices;
-
-	uint32_t index = 0;
-	for (const Geometry::ColoredRect<int> & position : m_rects)
-	{
-		if (position.hidden)
-		{
-			index += 4;
-			continue;
-		}
-		// Calculate the screen coordinates of the bitmap.
-		float
-			left = (float)position.rect.left - (float)(m_screenWidth / 2),
-			right = left + (float)position.rect.right,
-			top = (float)(m_screenHeight / 2) - (float)position.rect.top,
-			bottom = top - (float)position.rect.bottom;
-
-		// Create the vertex array.
-		vertexPtr[index++] = { { left, top, 0.0f },{ 0.0f, 0.0f }, position.color };  // Top left.
-		vertexPtr[index++] = { { right, top, 0.0f }, { 1.0f, 0.0f }, position.color }; // Top right.
-		vertexPtr[index++] = { { left, bottom, 0.0f },{ 0.0f, 1.0f }, position.color }; // Bottom left.
-		vertexPtr[index++] = { { right, bottom, 0.0f },{ 1.0f, 1.0f }, position.color }; // Bottom right.
-	}
+	VertexBuilder::BuildColoredRects(vertices, m_rects, m_screenWidth, m_screenHeight, first, count);
 }
 
 void LargeBitmap::RenderBuffers()
 {
-	auto stride = sizeof(VertexColorType), offset = 0u;
+	auto stride = static_cast<UINT>(GetVertexStride()), offset = 0u;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	RenderState::SetVertexBuffers(deviceContext, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	RenderState::SetIndexBuffer(deviceContext, indexBuffer.Get(), indexFormat);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	RenderState::SetTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
 
 void LargeBitmap::ResizeBuffers(int screenWidth, int screenHeight)
 {
 	m_screenWidth = screenWidth;
 	m_screenHeight = screenHeight;
+	m_dirty.Add(0, m_rects.size());
 }
 
 Spritemap::Spritemap(
 	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext, ShaderClass * p_FontShader,
 	int screenWidth, int screenHeight, const char * filename)
 	:
-	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight)
+	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight, filename)
+{
+}
+
+// Lets many sprite batches share one texture, e.g. the chunks of the world.
+Spritemap::Spritemap(
+	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext, ShaderClass * p_FontShader,
+	int screenWidth, int screenHeight, ID3D11ShaderResourceView * texture)
+	:
+	LargeBitmap(p_device, pdeviceContext, p_FontShader, screenWidth, screenHeight, texture)
 {
-	TextureClass tex(p_device, filename);
-	m_texture = tex.GetTexture();
 }
 
 void Spritemap::UpdateUvRects(const std::vector<RECT> && uvrects)
@@ -213,39 +253,15 @@ void Spritemap::SetRectUvMap(const std::vector<int> && uvrectmap)
 
 void Spritemap::UpdateUvRectMap(int i, int uvrect)
 {
+	if (m_uvrectmap[i] == uvrect)
+		return;
 	m_uvrectmap[i] = uvrect;
+	m_dirty.Add(i);
 }
 
-void Spritemap::BuildVertexArray(void * vertices)
+void Spritemap::BuildVertexArray(VertexColorType * vertices, size_t first, size_t count)
 {
-	VertexColorType* vertexPtr = (VertexColorType*)vertices;
-
-	uint32_t index = 0;
-	for (size_t i = 0u; i < m_rects.size(); i++)
-	{
-		auto position = m_rects[i];
-		if (position.hidden || m_uvrectmap[i] > m_uvrects.size() - 1)
-		{
-			index += 4;
-			continue;
-		}
-		// Calculate the screen coordinates of the bitmap.
-		float
-			left = (float)position.rect.left - (float)(m_screenWidth / 2),
-			right = left + (float)position.rect.right,
-			top = (float)(m_screenHeight / 2) - (float)position.rect.top,
-			bottom = top - (float)position.rect.bottom,
-			uvleft = (float)m_uvrects[m_uvrectmap[i]].left,
-			uvright = uvleft + (float)m_uvrects[m_uvrectmap[i]].right,
-			uvtop = (float)m_uvrects[m_uvrectmap[i]].top,
-			uvbottom = uvtop + (float)m_uvrects[m_uvrectmap[i]].bottom;
-
-		// Create the vertex array.
-		vertexPtr[index++] = { { left, top, 0.0f },{ uvleft/2048,uvtop/2048.f }, position.color };  // Top left.
-		vertexPtr[index++] = { { right, top, 0.0f }, { uvright/2048,uvtop/2048.f }, position.color }; // Top right.
-		vertexPtr[index++] = { { left, bottom, 0.0f },{ uvleft/2048,uvbottom/2048.f }, position.color }; // Bottom left.
-		vertexPtr[index++] = { { right, bottom, 0.0f },{ uvright/2048,uvbottom/2048.0f }, position.color }; // Bottom right.
-	}
+	VertexBuilder::BuildSprites(vertices, m_rects, m_uvrects, m_uvrectmap, m_screenWidth, m_screenHeight, first, count);
 }
 
 #include <random>
@@ -300,7 +316,6 @@ void PieChart::MakeChart(POINT origin, std::vector<float> dataPoints)
 	}
 	m_rects[m_rects.size() - 3].rect = m_rects[0].rect;
 	CreateBuffers();
-	UpdateBuffers();
 }
 
 size_t PieChart::GetVertexCount()
@@ -313,21 +328,32 @@ size_t PieChart::GetIndexCount()
 	return m_rects.size();
 }
 
-std::vector<unsigned long> PieChart::BuildIndexArray()
+// The chart is a plain triangle list, not quads, so it has its own.
+void PieChart::CreateIndexBuffer()
 {
-	auto indices = std::vector<unsigned long>(indexCount);
+	D3D11_BUFFER_DESC indexBufferDesc =
+	{
+		static_cast<UINT>(sizeof(uint32_t) * indexCount),
+		D3D11_USAGE_DEFAULT,
+		D3D11_BIND_INDEX_BUFFER
+	};
+	auto indices = std::vector<uint32_t>(indexCount);
 	std::iota(indices.begin(), indices.end(), 0);
+	D3D11_SUBRESOURCE_DATA indexData = { indices.data() };
 
-	return indices;
+	ThrowIfFailed(
+		device->CreateBuffer(&indexBufferDesc, &indexData, indexBuffer.GetAddressOf()),
+		"Could not create the index buffer."
+	);
+	indexFormat = DXGI_FORMAT_R32_UINT;
 }
 
-void PieChart::BuildVertexArray(void* vertices)
+void PieChart::BuildVertexArray(VertexColorType * vertexPtr, size_t first, size_t count)
 {
-	VertexColorType* vertexPtr = (VertexColorType*)vertices;
-
-	uint32_t index = 0;
-	for (const Geometry::ColoredRect<int> & position : m_rects)
+	size_t index = first;
+	for (size_t i = first; i < first + count && i < m_rects.size(); i++)
 	{
+		const Geometry::ColoredRect<int> & position = m_rects[i];
 		float
 			left = (float)position.rect.left - (float)(m_screenWidth / 2),
 			top = (float)(m_screenHeight / 2) - (float)position.rect.top;
@@ -338,14 +364,14 @@ void PieChart::BuildVertexArray(void* vertices)
 
 void PieChart::RenderBuffers()
 {
-	auto stride = sizeof(VertexColorType), offset = 0u;
+	auto stride = static_cast<UINT>(sizeof(VertexColorType)), offset = 0u;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
+	RenderState::SetVertexBuffers(deviceContext, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	RenderState::SetIndexBuffer(deviceContext, indexBuffer.Get(), DXGI_FORMAT_R32_UINT);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	RenderState::SetTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
@@ -4,6 +4,12 @@
 #include <numeric>
 #include "fontmanager.h"
 #include "fontshaderclass.h"
+#include "vertexbuilder.h"
+#include "dirtyranges.h"
+#include "alloctracker.h"
+#include "profiler.h"
+#include "renderstats.h"
+#include "quadindexbuffer.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: LargeBitmap
@@ -15,28 +21,45 @@ private:
 public:
 	LargeBitmap(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, int, int, const char *);
 	LargeBitmap(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, int, int);
+	LargeBitmap(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, int, int, ID3D11ShaderResourceView *);
 	void UpdateColoredRects(const std::vector<Geometry::ColoredRect<int>> &&);
 	void UpdateColoredRect(int, const Geometry::ColoredRect<int> &);
 	void UpdateColoredRect(int, RECT);
 	void UpdateColoredRect(int, bool);
 	void Render(const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &);
 	void ResizeBuffers(int, int);
+	void SetVertexFormat(VertexFormat, POINT);
 
 protected:
 	void CreateBuffers();
 	void UpdateBuffers();
-	virtual void BuildVertexArray(void *);
+	virtual void CreateIndexBuffer();
+	size_t GetVertexStride() const;
+	virtual void BuildVertexArray(VertexColorType *, size_t, size_t);
 	virtual void RenderBuffers();
 	virtual size_t GetVertexCount();
 	virtual size_t GetIndexCount();
-	virtual std::vector<unsigned long> BuildIndexArray();
+	virtual size_t GetVerticesPerRect() { return 4; }
 
 	ID3D11Device * device;
 	ID3D11DeviceContext * deviceContext;
 	ShaderClass * m_FontShader;
 	int m_screenWidth, m_screenHeight;
 	std::vector<Geometry::ColoredRect<int>> m_rects;
+
+	// The CPU copy of the vertex buffer and the rects in it that are out of
+	// date. Changes pile up until the next Render uploads just those.
+	std::vector<VertexColorType> m_vertices;
+	DirtyRanges m_dirty;
+
+	// Packed batches store positions relative to m_origin, in pixels, and
+	// upload a quantized copy of m_vertices instead of the full one.
+	VertexFormat m_format = VertexFormat::Full;
+	POINT m_origin = {};
+	std::vector<PackedVertexType> m_packed;
+
 	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer, indexBuffer;
+	DXGI_FORMAT indexFormat = DXGI_FORMAT_R32_UINT;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_texture;
 	size_t vertexCount, indexCount;
 };
@@ -48,6 +71,7 @@ class Spritemap : public LargeBitmap
 {
 public:
 	Spritemap(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, int, int, const char *);
+	Spritemap(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, int, int, ID3D11ShaderResourceView *);
 	void UpdateUvRects(const std::vector<RECT> &&);
 	void SetRectUvMap(const std::vector<int> &&);
 	void UpdateUvRectMap(int, int);
@@ -55,7 +79,7 @@ public:
 private:
 	std::vector<RECT> m_uvrects;
 	std::vector<int> m_uvrectmap;
-	void BuildVertexArray(void *) override;
+	void BuildVertexArray(VertexColorType *, size_t, size_t) override;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -68,11 +92,12 @@ public:
 	void MakeChart(POINT, std::vector<float>);
 
 private:
-	void BuildVertexArray(void *) override;
+	void BuildVertexArray(VertexColorType *, size_t, size_t) override;
 	void RenderBuffers();
 	size_t GetVertexCount() override;
 	size_t GetIndexCount() override;
-	std::vector<unsigned long> BuildIndexArray();
+	size_t GetVerticesPerRect() override { return 1; }
+	void CreateIndexBuffer() override;
 
 	double Lerp(double a, double b, double t)
 	{
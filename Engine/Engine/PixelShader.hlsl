@@ -1,6 +1,9 @@
 Texture2D shaderTexture;
 SamplerState SampleType;
 
+// Glyph pages; the integer part of u picks the slice.
+Texture2DArray fontPages : register(t0);
+
 cbuffer PixelBuffer
 {
 	float4 pixelColor;
@@ -33,10 +36,16 @@ float4 RGBPixelShader(PixelInputType input) : SV_TARGET
 
 float4 FontPixelShader(PixelInputType input) : SV_TARGET
 {
-	return shaderTexture.Sample(SampleType, input.tex).r * pixelColor;
+	float page = floor(input.tex.x);
+	return fontPages.Sample(SampleType, float3(input.tex.x - page, input.tex.y, page)).r * pixelColor;
 }
 
+// The field is 0.5 on the outline; fading over one screen pixel keeps the
+// edge equally sharp at every scale.
 float4 SDFPixelShader(PixelInputType input) : SV_TARGET
 {
-	return smoothstep(0.1, 0.9, shaderTexture.Sample(SampleType, input.tex).r) * pixelColor;
+	float page = floor(input.tex.x);
+	float distance = fontPages.Sample(SampleType, float3(input.tex.x - page, input.tex.y, page)).r;
+	float width = 0.5 * fwidth(distance);
+	return smoothstep(0.5 - width, 0.5 + width, distance) * pixelColor;
 }
\ No newline at end of file
@@ -13,6 +13,28 @@ struct VertexInputType
 	float3 instancePosition : INSTANCEPOS;
 };
 
+// PackedVertexType: pixel positions relative to the batch origin, which is
+// folded into the world matrix.
+struct PackedVertexInputType
+{
+	int2 position : POSITION;
+	float2 tex : TEXCOORD0;
+	float4 Color : COLOR0;
+};
+
+// TileInstanceType: one unit quad corner per vertex, one tile per instance.
+struct TileVertexInputType
+{
+	float2 corner : POSITION;
+	int2 instancePosition : INSTANCEPOS;
+	uint2 instanceSize : INSTANCESIZE;
+	uint atlas : ATLAS;
+	float4 Color : COLOR0;
+};
+
+// (left, top, right, bottom) UVs of every sprite in the tile atlas.
+StructuredBuffer<float4> atlasRects : register(t0);
+
 struct PixelInputType
 {
 	float4 position : SV_POSITION;
@@ -50,5 +72,43 @@ PixelInputType TextureVertexShader(VertexInputType input)
 
 	output.Color = input.Color;
 
+	return output;
+}
+
+PixelInputType PackedVertexShader(PackedVertexInputType input)
+{
+	PixelInputType output;
+
+	// Calculate the position of the vertex against the world, view, and projection matrices.
+	output.position = mul(float4(input.position, 0.0f, 1.0f), worldMatrix);
+	output.position = mul(output.position, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	// Store the texture coordinates for the pixel shader.
+	output.tex = input.tex;
+
+	output.Color = input.Color;
+
+	return output;
+}
+
+PixelInputType TileVertexShader(TileVertexInputType input)
+{
+	PixelInputType output;
+
+	// Y goes up in this space, so the quad grows down from the tile's top left corner.
+	float2 position = input.instancePosition + float2(input.corner.x, -input.corner.y) * input.instanceSize;
+
+	// Calculate the position of the vertex against the world, view, and projection matrices.
+	output.position = mul(float4(position, 0.0f, 1.0f), worldMatrix);
+	output.position = mul(output.position, viewMatrix);
+	output.position = mul(output.position, projectionMatrix);
+
+	// Look the sprite up in the atlas and pick this corner of it.
+	float4 uv = atlasRects[input.atlas];
+	output.tex = lerp(uv.xy, uv.zw, input.corner);
+
+	output.Color = input.Color;
+
 	return output;
 }
\ No newline at end of file
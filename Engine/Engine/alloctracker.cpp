@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: alloctracker.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "alloctracker.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+
+const char * AllocationTracker::GetName(Subsystem subsystem)
+{
+	static const char * const names[SubsystemCount] = { "other", "tiles", "text", "gui", "io" };
+	return Index(subsystem) < SubsystemCount ? names[Index(subsystem)] : "?";
+}
+
+
+void AllocationTracker::SetBudget(Subsystem subsystem, const Budget & budget)
+{
+	s_budgets[Index(subsystem)] = budget;
+}
+
+
+void AllocationTracker::SetOverrunHandler(OverrunHandler handler)
+{
+	s_overrunHandler = handler;
+}
+
+
+static void ReportOverrun(AllocationTracker::Subsystem subsystem,
+	const AllocationTracker::Counters & counters, const AllocationTracker::Budget & budget)
+{
+	std::clog << "Allocation budget of " << AllocationTracker::GetName(subsystem) << " exceeded: "
+		<< counters.allocations << " allocations (" << counters.bytes << " bytes) in a frame, "
+		<< counters.liveBytes << " bytes live; allowed " << budget.allocationsPerFrame << ", "
+		<< budget.bytesPerFrame << " and " << budget.liveBytes << std::endl;
+	assert(!"Allocation budget exceeded");
+}
+
+
+void AllocationTracker::EndFrame()
+{
+	for (size_t i = 0; i < SubsystemCount; i++)
+	{
+		LiveCounters & live = s_counters[i];
+		Counters & last = s_last[i];
+		last.allocations = live.allocations.exchange(0, std::memory_order_relaxed);
+		last.bytes = live.bytes.exchange(0, std::memory_order_relaxed);
+		last.liveBytes = live.liveBytes.load(std::memory_order_relaxed);
+		last.peakBytes = live.peakBytes.load(std::memory_order_relaxed);
+
+		auto over = [](size_t value, size_t limit) { return limit != 0 && value > limit; };
+		const Budget & budget = s_budgets[i];
+		if (over(last.allocations, budget.allocationsPerFrame) || over(last.bytes, budget.bytesPerFrame)
+			|| over(last.liveBytes, budget.liveBytes))
+			(s_overrunHandler != nullptr ? s_overrunHandler : ReportOverrun)(static_cast<Subsystem>(i), last, budget);
+	}
+}
+
+
+void AllocationTracker::OnAllocate(Subsystem subsystem, size_t size)
+{
+	LiveCounters & live = s_counters[Index(subsystem)];
+	live.allocations.fetch_add(1, std::memory_order_relaxed);
+	live.bytes.fetch_add(size, std::memory_order_relaxed);
+	size_t bytes = live.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = live.peakBytes.load(std::memory_order_relaxed);
+	while (bytes > peak && !live.peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+		;
+}
+
+
+void AllocationTracker::OnFree(Subsystem subsystem, size_t size)
+{
+	s_counters[Index(subsystem)].liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+
+#ifdef ENGINE_TRACK_ALLOCATIONS
+
+// Every block starts with what it was counted as, so freeing it takes off
+// the same, whichever subsystem or thread frees it. Keeping the header as
+// large as malloc's alignment keeps the block after it just as aligned.
+struct alignas(std::max_align_t) AllocationHeader
+{
+	size_t size;
+	AllocationTracker::Subsystem subsystem;
+};
+
+
+static void * TrackedAllocate(size_t size) noexcept
+{
+	if (size > SIZE_MAX - sizeof(AllocationHeader))
+		return nullptr;
+	auto header = static_cast<AllocationHeader *>(std::malloc(sizeof(AllocationHeader) + size));
+	if (header == nullptr)
+		return nullptr;
+	header->size = size;
+	header->subsystem = AllocationTracker::GetCurrent();
+	AllocationTracker::OnAllocate(header->subsystem, size);
+	return header + 1;
+}
+
+
+static void TrackedFree(void * block) noexcept
+{
+	if (block == nullptr)
+		return;
+	auto header = static_cast<AllocationHeader *>(block) - 1;
+	AllocationTracker::OnFree(header->subsystem, header->size);
+	std::free(header);
+}
+
+
+static void * AllocateOrThrow(size_t size)
+{
+	for (;;)
+	{
+		if (void * block = TrackedAllocate(size))
+			return block;
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+
+// Over-aligned types go through the align_val_t overloads, which are left
+// as they are and not counted.
+void * operator new(size_t size) { return AllocateOrThrow(size); }
+void * operator new[](size_t size) { return AllocateOrThrow(size); }
+void * operator new(size_t size, const std::nothrow_t &) noexcept { return TrackedAllocate(size); }
+void * operator new[](size_t size, const std::nothrow_t &) noexcept { return TrackedAllocate(size); }
+void operator delete(void * block) noexcept { TrackedFree(block); }
+void operator delete[](void * block) noexcept { TrackedFree(block); }
+void operator delete(void * block, size_t) noexcept { TrackedFree(block); }
+void operator delete[](void * block, size_t) noexcept { TrackedFree(block); }
+void operator delete(void * block, const std::nothrow_t &) noexcept { TrackedFree(block); }
+void operator delete[](void * block, const std::nothrow_t &) noexcept { TrackedFree(block); }
+
+#endif
@@ -0,0 +1,117 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: alloctracker.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+///////////////////////////////
+// PRE-PROCESSING DIRECTIVES //
+///////////////////////////////
+// Counts what the rest of the enclosing block allocates on this thread
+// against subsystem, rather than whatever it was counted against before.
+#define ALLOCATION_JOIN_(a, b) a##b
+#define ALLOCATION_JOIN(a, b) ALLOCATION_JOIN_(a, b)
+#define ALLOCATION_SCOPE(subsystem) \
+	AllocationTracker::Scope ALLOCATION_JOIN(allocationScope, __LINE__)(AllocationTracker::Subsystem::subsystem)
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: AllocationTracker
+//
+// Counts allocations and bytes made through operator new for each frame,
+// by subsystem, and the most each subsystem ever had live at once. Builds
+// defining ENGINE_TRACK_ALLOCATIONS replace the global operator new and
+// delete to do the counting; without it every count stays at 0 and the
+// scopes only set a tag nobody reads.
+//
+// A subsystem can have a budget for what it allocates in one frame and
+// what it holds. EndFrame hands every overrun to a handler, which by
+// default logs it and, in debug builds, asserts.
+////////////////////////////////////////////////////////////////////////////////
+class AllocationTracker
+{
+public:
+	enum class Subsystem : uint8_t { Other, Tiles, Text, Gui, Io, Count };
+
+	struct Counters
+	{
+		// In the frame.
+		size_t allocations;
+		size_t bytes;
+
+		// At the end of it, and the most ever.
+		size_t liveBytes;
+		size_t peakBytes;
+	};
+
+	// 0 for no limit.
+	struct Budget
+	{
+		size_t allocationsPerFrame;
+		size_t bytesPerFrame;
+		size_t liveBytes;
+	};
+
+	using OverrunHandler = void (*)(Subsystem, const Counters &, const Budget &);
+
+	class Scope
+	{
+	public:
+		explicit Scope(Subsystem subsystem) : m_previous(t_current) { t_current = subsystem; }
+		~Scope() { t_current = m_previous; }
+
+		Scope(const Scope &) = delete;
+		Scope & operator=(const Scope &) = delete;
+
+	private:
+		Subsystem m_previous;
+	};
+
+	static constexpr bool IsTracking()
+	{
+#ifdef ENGINE_TRACK_ALLOCATIONS
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static const char * GetName(Subsystem);
+	static Subsystem GetCurrent() { return t_current; }
+
+	static void SetBudget(Subsystem, const Budget &);
+	static void SetOverrunHandler(OverrunHandler);
+
+	// Closes the frame for every subsystem and checks the budgets. Only
+	// ever call it from one thread.
+	static void EndFrame();
+	static const Counters & LastFrame(Subsystem subsystem) { return s_last[Index(subsystem)]; }
+
+	// For operator new and delete; size is what was asked for.
+	static void OnAllocate(Subsystem, size_t size);
+	static void OnFree(Subsystem, size_t size);
+
+private:
+	static size_t Index(Subsystem subsystem) { return static_cast<size_t>(subsystem); }
+
+	static const size_t SubsystemCount = static_cast<size_t>(Subsystem::Count);
+
+	struct LiveCounters
+	{
+		std::atomic<size_t> allocations, bytes, liveBytes, peakBytes;
+	};
+
+	static inline thread_local Subsystem t_current = Subsystem::Other;
+	static inline LiveCounters s_counters[SubsystemCount];
+	static inline Counters s_last[SubsystemCount];
+	static inline Budget s_budgets[SubsystemCount];
+	static inline OverrunHandler s_overrunHandler = nullptr;
+};
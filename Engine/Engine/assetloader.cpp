@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: assetloader.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "assetloader.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "alloctracker.h"
+#include "profiler.h"
+
+
+AssetLoader::AssetLoader(unsigned threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	for (unsigned i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&AssetLoader::WorkerLoop, this);
+}
+
+
+AssetLoader::~AssetLoader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto & worker : m_workers)
+		worker.join();
+}
+
+
+size_t AssetLoader::Pump(std::chrono::microseconds budget)
+{
+	auto start = std::chrono::steady_clock::now();
+	size_t count = 0;
+	for (;;)
+	{
+		std::function<void()> finish;
+		{
+			std::lock_guard<std::mutex> lock(m_finishMutex);
+			if (m_finishers.empty())
+				break;
+			finish = std::move(m_finishers.front());
+			m_finishers.pop_front();
+		}
+
+		// Counted first so a load that throws is not waited on forever.
+		m_done++;
+		count++;
+		finish();
+
+		if (budget.count() != 0 && std::chrono::steady_clock::now() - start >= budget)
+			break;
+	}
+	return count;
+}
+
+
+float AssetLoader::GetProgress() const
+{
+	size_t total = m_total;
+	return total == 0 ? 1.0f : static_cast<float>(m_done) / total;
+}
+
+
+void AssetLoader::Enqueue(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_wake.notify_one();
+}
+
+
+void AssetLoader::Post(std::function<void()> finish)
+{
+	std::lock_guard<std::mutex> lock(m_finishMutex);
+	m_finishers.push_back(std::move(finish));
+}
+
+
+void AssetLoader::WorkerLoop()
+{
+	Profiler::SetThreadName("Asset loader");
+	ALLOCATION_SCOPE(Io);
+	for (;;)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_wake.wait(lock, [this]() { return m_stopping || !m_jobs.empty(); });
+			if (m_stopping)
+				return;
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		PROFILE_SCOPE("AssetLoader job");
+		job();
+	}
+}
@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: assetloader.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: AssetLoader
+//
+// Reads and decodes assets on worker threads so the window keeps drawing
+// while they come in. A load either hands back a future, or names a finish
+// step that runs later on whichever thread calls Pump; that is where GPU
+// resources get made, since the device context belongs to one thread.
+// Counts every load so a loading screen can show how far along it is.
+////////////////////////////////////////////////////////////////////////////////
+class AssetLoader
+{
+public:
+	// 0 means one worker per core but the one drawing, and at least one.
+	explicit AssetLoader(unsigned threadCount = 0);
+
+	// Lets each worker finish what it is on and drops the rest.
+	~AssetLoader();
+	AssetLoader(const AssetLoader &) = delete;
+	AssetLoader & operator=(const AssetLoader &) = delete;
+
+	// Runs work on a worker. The future holds what it returns or throws.
+	template<typename Work>
+	auto Load(Work work) -> std::future<std::invoke_result_t<Work &>>;
+
+	// Runs work on a worker, then passes what it returned to finish on the
+	// next Pump. If work throws, that Pump throws it instead.
+	template<typename Work, typename Finish>
+	void Load(Work work, Finish finish);
+
+	// Runs the finish steps that are ready, in the order their work ended,
+	// until none are left or budget, if not zero, has passed. Returns how
+	// many ran.
+	size_t Pump(std::chrono::microseconds budget = std::chrono::microseconds::zero());
+
+	// Loads not yet done, counting a finish step as part of its load.
+	size_t GetPending() const { return m_total - m_done; }
+	bool IsIdle() const { return GetPending() == 0; }
+
+	// Done over started, 1 when nothing was ever started.
+	float GetProgress() const;
+
+	unsigned GetThreadCount() const { return static_cast<unsigned>(m_workers.size()); }
+
+private:
+	void Enqueue(std::function<void()>);
+	void Post(std::function<void()>);
+	void WorkerLoop();
+
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_jobMutex;
+	std::condition_variable m_wake;
+	std::deque<std::function<void()>> m_jobs;
+	bool m_stopping = false;
+
+	std::mutex m_finishMutex;
+	std::deque<std::function<void()>> m_finishers;
+
+	std::atomic<size_t> m_total = 0, m_done = 0;
+};
+
+
+template<typename Work>
+auto AssetLoader::Load(Work work) -> std::future<std::invoke_result_t<Work &>>
+{
+	using Result = std::invoke_result_t<Work &>;
+
+	// std::function has to be copyable and a packaged_task is not.
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(work));
+	auto future = task->get_future();
+	m_total++;
+	Enqueue([this, task]() {
+		(*task)();
+		m_done++;
+	});
+	return future;
+}
+
+
+template<typename Work, typename Finish>
+void AssetLoader::Load(Work work, Finish finish)
+{
+	using Result = std::invoke_result_t<Work &>;
+
+	auto steps = std::make_shared<std::pair<Work, Finish>>(std::move(work), std::move(finish));
+	m_total++;
+	Enqueue([this, steps]() {
+		try
+		{
+			if constexpr (std::is_void_v<Result>)
+			{
+				steps->first();
+				Post([steps]() { steps->second(); });
+			}
+			else
+			{
+				auto result = std::make_shared<Result>(steps->first());
+				Post([steps, result]() { steps->second(std::move(*result)); });
+			}
+		}
+		catch (...)
+		{
+			Post([error = std::current_exception()]() { std::rethrow_exception(error); });
+		}
+	});
+}
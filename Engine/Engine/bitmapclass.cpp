@@ -24,6 +24,27 @@ BitmapClass::BitmapClass(
 	InitializeBuffers();
 }
 
+BitmapClass::BitmapClass(
+	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext,
+	int screenWidth, int screenHeight, const DDSFile & texture)
+	:
+	device(p_device),
+	deviceContext(pdeviceContext),
+
+	// Store the screen width and height.
+	m_screenWidth(screenWidth),
+	m_screenHeight(screenHeight),
+
+	// Create the texture object.
+	m_Texture(device, texture),
+
+	// Sttore an initial position that should be invalid.
+	m_previousPos({ -1, -1, 0, 0 })
+{
+	// Initialize the vertex and index buffers.
+	InitializeBuffers();
+}
+
 BitmapClass::BitmapClass(
 	ID3D11Device * p_device, ID3D11DeviceContext * pdeviceContext,
 	int screenWidth, int screenHeight)
@@ -232,14 +253,14 @@ void BitmapClass::UpdateBuffers(RECT position, float scale)
 void BitmapClass::RenderBuffers()
 {
 	// Set vertex buffer stride and offset.
-	auto stride = sizeof(VertexType), offset = 0u;
+	auto stride = static_cast<UINT>(sizeof(VertexType)), offset = 0u;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, &m_vertexBuffer, &stride, &offset);
+	RenderState::SetVertexBuffers(deviceContext, 1, &m_vertexBuffer, &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(m_indexBuffer, DXGI_FORMAT_R32_UINT, 0);
+	RenderState::SetIndexBuffer(deviceContext, m_indexBuffer, DXGI_FORMAT_R32_UINT);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	RenderState::SetTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 }
\ No newline at end of file
@@ -16,6 +16,7 @@
 ///////////////////////
 // MY CLASS INCLUDES //
 ///////////////////////
+#include "renderstate.h"
 #include "textureclass.h"
 #include "game.h" 
 
@@ -34,6 +35,7 @@ private:
 
 public:
 	BitmapClass(ID3D11Device *, ID3D11DeviceContext *, int, int, CHAR *);
+	BitmapClass(ID3D11Device *, ID3D11DeviceContext *, int, int, const DDSFile &);
 	BitmapClass(ID3D11Device *, ID3D11DeviceContext *, int, int);
 	void Render(RECT, float);
 	~BitmapClass();
@@ -36,38 +36,57 @@ public:
 		SetPosition(0.0f, 0.0f, -1.0f);
 		Render();
 	}
+	// Dragging follows the mouse exactly, once per frame, so it jumps both
+	// ends of the interpolation.
 	void Frame()
 	{
+		if (m_Input->IsKeyDown(VK_RBUTTON))
+		{
+			POINT temp = m_Input->GetMousePositionDelta();
+			m_position.x -= temp.x;
+			m_position.y += temp.y;
+			m_previousPosition.x -= temp.x;
+			m_previousPosition.y += temp.y;
+		}
+	}
+
+	// The arrow keys scroll at a fixed speed, whatever the frame rate.
+	void Tick(float seconds)
+	{
+		m_previousPosition = m_position;
+		float distance = ScrollSpeed * seconds;
+
 		if (m_Input->IsKeyDown(VK_LEFT))
-			m_position.x++;
+			m_position.x += distance;
 
 		if (m_Input->IsKeyDown(VK_RIGHT))
-			m_position.x--;
+			m_position.x -= distance;
 
 		if (m_Input->IsKeyDown(VK_UP))
-			m_position.y--;
+			m_position.y -= distance;
 
 		if (m_Input->IsKeyDown(VK_DOWN))
-			m_position.y++;
+			m_position.y += distance;
+	}
 
-		if (m_Input->IsKeyDown(VK_RBUTTON))
-		{
-			POINT temp = m_Input->GetMousePositionDelta();
-			m_position.x -= temp.x;
-			m_position.y += temp.y;
-		}
+	void Interpolate(float alpha)
+	{
+		DirectX::XMStoreFloat3(&m_drawPosition, DirectX::XMVectorLerp(
+			DirectX::XMLoadFloat3(&m_previousPosition), DirectX::XMLoadFloat3(&m_position), alpha));
 	}
+
+	// The view is made from where the camera is drawn, between ticks.
 	void Render()
 	{
 		DirectX::XMVECTOR
-			Eye = DirectX::XMVectorSet(m_position.x, m_position.y, -1.0f, 0.0f),
-			LookAt = DirectX::XMVectorSet(m_position.x, m_position.y, 0.0f, 0.0f),
+			Eye = DirectX::XMVectorSet(m_drawPosition.x, m_drawPosition.y, -1.0f, 0.0f),
+			LookAt = DirectX::XMVectorSet(m_drawPosition.x, m_drawPosition.y, 0.0f, 0.0f),
 			Up = DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
 
 		m_viewMatrix = DirectX::XMMatrixLookAtLH(Eye, LookAt, Up);
 	}
 
-	void SetPosition(float x, float y, float z) { m_position = DirectX::XMFLOAT3(x, y, z); }
+	void SetPosition(float x, float y, float z) { m_position = m_previousPosition = m_drawPosition = DirectX::XMFLOAT3(x, y, z); }
 	void SetRotation(float x, float y, float z) { m_rotation = DirectX::XMFLOAT3(x, y, z); }
 
 	void Save(BinaryWriter & writer)
@@ -78,8 +97,9 @@ public:
 
 	void Load(BinaryReader & reader)
 	{
-		m_position.x = reader.Get<float>();
-		m_position.y = reader.Get<float>();
+		float x = reader.Get<float>();
+		float y = reader.Get<float>();
+		SetPosition(x, y, m_position.z);
 	}
 
 	DirectX::XMMATRIX GetViewMatrix() const { return m_viewMatrix; }
@@ -147,7 +167,10 @@ public:
 	}
 
 private:
-	DirectX::XMFLOAT3 m_position, m_rotation;
+	// World units a second, as one a frame was at 60 frames a second.
+	static constexpr float ScrollSpeed = 60.0f;
+
+	DirectX::XMFLOAT3 m_position, m_previousPosition, m_drawPosition, m_rotation;
 	DirectX::XMMATRIX m_viewMatrix;
 	InputClass * m_Input;
 	DirectX::XMMATRIX worldMatrix, projectionMatrix;
@@ -9,12 +9,18 @@
 // INCLUDES //
 //////////////
 #include <chrono>
+#include <fstream>
+#include <iostream>
 
 
 ///////////////////////
 // MY CLASS INCLUDES //
 ///////////////////////
+#include "alloctracker.h"
+#include "framestats.h"
 #include "game.h"
+#include "profiler.h"
+#include "renderstats.h"
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -23,8 +29,10 @@
 class CpuClass : public IGameObject
 {
 public:
-	CpuClass(InputClass * p_Input, CameraClass * p_Camera, TextClass * p_Text)
+	CpuClass(InputClass * p_Input, CameraClass * p_Camera, TextClass * p_Text, const Settings & p_Settings)
 		:
+		m_frameStats(std::chrono::duration_cast<FrameStats::Duration>(
+			std::chrono::duration<float, std::milli>(p_Settings.frameBudget))),
 		m_Input(p_Input),
 		m_Camera(p_Camera),
 		m_Text(p_Text)
@@ -34,8 +42,10 @@ public:
 
 	void Frame()
 	{
+		// From the end of one frame to the end of the next, so the whole of
+		// every frame is counted.
 		end = std::chrono::high_resolution_clock::now();
-		auto timeDifference = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+		m_frameStats.AddFrame(std::chrono::duration_cast<FrameStats::Duration>(end - start));
 
 		m_count++;
 
@@ -46,10 +56,27 @@ public:
 
 			m_cpuUsage = static_cast<unsigned int>(GetCPULoad() * 100);
 			timetoprint = std::chrono::high_resolution_clock::now();
-			m_frameTime = static_cast<unsigned int>(timeDifference);
+			m_frameSummary = m_frameStats.GetWindow();
 		}
 
-		start = std::chrono::high_resolution_clock::now();
+		start = end;
+
+		// F11 starts a trace, and stops it again into TracePath.
+		bool isTraceKeyDown = m_Input->IsKeyDown(VK_F11);
+		if (isTraceKeyDown && !m_wasTraceKeyDown)
+			ToggleTrace();
+		m_wasTraceKeyDown = isTraceKeyDown;
+
+		// F9 writes the frame times of every second so far.
+		bool isCsvKeyDown = m_Input->IsKeyDown(VK_F9);
+		if (isCsvKeyDown && !m_wasCsvKeyDown)
+		{
+			std::ofstream file(FrameTimesPath);
+			m_frameStats.WriteCsv(file);
+			std::clog << "Frame times written to " << FrameTimesPath << std::endl;
+		}
+		m_wasCsvKeyDown = isCsvKeyDown;
+
 		UpdateDebugInfo();
 	}
 	void UpdateDebugInfo()
@@ -59,24 +86,46 @@ public:
 		// Get the location of the mouse from the input object,
 		m_Input->GetMousePositionForDebug(mouseX, mouseY);
 		m_Text->SetMousePosition(mouseX, mouseY);
-		m_Text->SetFps(GetFps(), GetFrameTimeDelta());
+		m_Text->SetFps(GetFps(), GetFrameStats());
 		m_Text->SetCpu(GetCpuPercentage());
 		m_Text->SetCameraPosition(m_Camera->GetPosition());
+		m_Text->SetRenderStats(RenderStats::LastFrame());
+		if (AllocationTracker::IsTracking())
+			m_Text->SetAllocations();
+		m_Text->SetProfile(Profiler::LastFrame());
+	}
+
+	void ToggleTrace()
+	{
+		if (!Profiler::IsCapturing())
+		{
+			Profiler::StartCapture();
+			return;
+		}
+
+		std::ofstream file(TracePath);
+		Profiler::StopCapture(file);
+		std::clog << "Profile trace written to " << TracePath << std::endl;
 	}
 
 
 	unsigned int GetFps() const { return m_fps; }
 	unsigned int GetCpuPercentage() const { return m_cpuUsage; }
-	unsigned int GetFrameTimeDelta() { return m_frameTime; }
+	const FrameStats::Summary & GetFrameStats() const { return m_frameSummary; }
 
 private:
+	static constexpr const char * TracePath = "trace.json";
+	static constexpr const char * FrameTimesPath = "frametimes.csv";
+
 	std::chrono::high_resolution_clock::time_point start, end, timetoprint;
 	unsigned int
 		m_fps = 0,
 		m_count = 0,
 		m_startTime = 0,
-		m_cpuUsage = 0,
-		m_frameTime = 0;
+		m_cpuUsage = 0;
+	FrameStats m_frameStats;
+	FrameStats::Summary m_frameSummary;
+	bool m_wasTraceKeyDown = false, m_wasCsvKeyDown = false;
 	InputClass * m_Input;
 	CameraClass * m_Camera;
 	TextClass * m_Text;
@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ddsfile.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "ddsfile.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+
+DDSFile::DDSFile(const char* FilePath)
+	:
+	m_file(FilePath)
+{
+	Parse(m_file.GetData(), m_file.GetSize());
+}
+
+
+DDSFile::DDSFile(const std::byte * data, size_t size)
+{
+	Parse(data, size);
+}
+
+
+void DDSFile::Parse(const std::byte * data, size_t size)
+{
+	if (size < sizeof(uint32_t) + sizeof(DDSURFACEDESC2))
+		throw std::invalid_argument("File too small to be a DDS.");
+	MemoryReader reader(data, size);
+
+	// magic number
+	if (reader.Get<uint32_t>() != MakeFourCC("DDS "))
+		throw std::invalid_argument("Magic number (fourCC) not found.");
+
+	// DDSURFACEDESC2
+	DDSURFACEDESC2 header = reader.Get<DDSURFACEDESC2>();
+	if (header.dwSize != sizeof(DDSURFACEDESC2) || header.ddpfPixelFormat.dwSize != sizeof(DDPIXELFORMAT))
+		throw std::invalid_argument("Bad DDS header size.");
+
+	width = header.dwWidth;
+	height = header.dwHeight;
+	depth = 1;
+	m_mipCount = header.dwMipMapCount == 0 ? 1 : header.dwMipMapCount;
+	m_arraySize = 1;
+	m_isCubeMap = false;
+	m_dimension = Dimension::Texture2D;
+
+	if ((header.ddpfPixelFormat.dwFlags & DDPF_FOURCC)
+		&& header.ddpfPixelFormat.dwFourCC == MakeFourCC("DX10"))
+	{
+		if (reader.GetRemaining() < sizeof(DDSHEADERDXT10))
+			throw std::invalid_argument("DX10 header is truncated.");
+		DDSHEADERDXT10 extension = reader.Get<DDSHEADERDXT10>();
+		m_format = static_cast<DXGI_FORMAT>(extension.dxgiFormat);
+		m_arraySize = extension.arraySize;
+		if (m_arraySize == 0)
+			throw std::invalid_argument("Array size cannot be zero.");
+
+		switch (extension.resourceDimension)
+		{
+		case DDS_DIMENSION_TEXTURE1D:
+			if (height != 1)
+				throw std::invalid_argument("A 1D texture must be one pixel high.");
+			m_dimension = Dimension::Texture1D;
+			break;
+
+		case DDS_DIMENSION_TEXTURE2D:
+			if (extension.miscFlag & DDS_RESOURCE_MISC_TEXTURECUBE)
+			{
+				m_isCubeMap = true;
+				if (m_arraySize > UINT32_MAX / 6)
+					throw std::invalid_argument("Too many cube maps in the array.");
+				m_arraySize *= 6;
+			}
+			break;
+
+		case DDS_DIMENSION_TEXTURE3D:
+			if (m_arraySize != 1)
+				throw std::invalid_argument("A volume texture cannot be an array.");
+			depth = header.dwDepth;
+			m_dimension = Dimension::Texture3D;
+			break;
+
+		default:
+			throw std::invalid_argument(
+				FormatString(
+					"Unknown resource dimension %u",
+					extension.resourceDimension
+				).data()
+			);
+		}
+	}
+	else
+	{
+		m_format = GetLegacyFormat(header.ddpfPixelFormat);
+		if (header.ddsCaps.dwCaps2 & DDSCAPS2_CUBEMAP)
+		{
+			// D3D has no partial cube maps.
+			if ((header.ddsCaps.dwCaps2 & DDSCAPS2_CUBEMAP_ALLFACES) != DDSCAPS2_CUBEMAP_ALLFACES)
+				throw std::invalid_argument("Cube map is missing faces.");
+			m_isCubeMap = true;
+			m_arraySize = 6;
+		}
+		else if (header.ddsCaps.dwCaps2 & DDSCAPS2_VOLUME)
+		{
+			depth = header.dwDepth;
+			m_dimension = Dimension::Texture3D;
+		}
+	}
+
+	uint32_t bpp = GetBitsPerPixel(m_format);
+	if (bpp == 0)
+		throw std::invalid_argument(
+			FormatString(
+				"DXGI format %u not supported",
+				static_cast<unsigned>(m_format)
+			).data()
+		);
+	if (width == 0 || height == 0 || depth == 0)
+		throw std::invalid_argument("Texture has no pixels.");
+
+	// A chain can go no further than 1x1x1.
+	uint32_t largest = std::max(std::max(width, height), depth), maxMips = 1;
+	while (largest >>= 1)
+		maxMips++;
+	if (m_mipCount > maxMips)
+		throw std::invalid_argument("Too many mip levels for the texture size.");
+
+	// Each surface takes at least a byte, which bounds how many there can be
+	// before anything is reserved for them.
+	uint64_t surfaceCount = static_cast<uint64_t>(m_arraySize) * m_mipCount;
+	if (surfaceCount > reader.GetRemaining())
+		throw std::invalid_argument("Pixel data is truncated.");
+
+	// Every surface is found by walking the file in order, pointing into it.
+	bool compressed = IsBlockCompressed(m_format);
+	m_surfaces.reserve(static_cast<size_t>(surfaceCount));
+	for (uint32_t slice = 0; slice < m_arraySize; slice++)
+	{
+		uint32_t w = width, h = height, d = depth;
+		for (uint32_t mip = 0; mip < m_mipCount; mip++)
+		{
+			Surface surface = {};
+			surface.width = w;
+			surface.height = h;
+			surface.depth = d;
+
+			// Worked out in 64 bits, as a crafted header can make them wrap in 32.
+			uint64_t rowPitch, rows = h;
+			if (compressed)
+			{
+				// 16 pixels to a block, so bits per pixel times two is bytes per block.
+				rowPitch = std::max<uint64_t>(1, (uint64_t(w) + 3) / 4) * bpp * 2;
+				rows = std::max<uint64_t>(1, (uint64_t(h) + 3) / 4);
+			}
+			else
+				rowPitch = (uint64_t(w) * bpp + 7) / 8;
+			uint64_t slicePitch = rowPitch * rows;
+			if (rowPitch > UINT32_MAX || slicePitch > UINT32_MAX)
+				throw std::invalid_argument("Surface is too large.");
+			uint64_t bytes = slicePitch * d;
+			if (reader.GetRemaining() < bytes)
+				throw std::invalid_argument("Pixel data is truncated.");
+
+			surface.rowPitch = static_cast<uint32_t>(rowPitch);
+			surface.slicePitch = static_cast<uint32_t>(slicePitch);
+			surface.size = static_cast<size_t>(bytes);
+			surface.pixels = reader.Read(surface.size);
+			m_size += surface.size;
+			m_surfaces.push_back(surface);
+
+			w = std::max(1u, w / 2);
+			h = std::max(1u, h / 2);
+			d = std::max(1u, d / 2);
+		}
+	}
+}
+
+
+DXGI_FORMAT DDSFile::GetLegacyFormat(const DDPIXELFORMAT & pf) const
+{
+	if (pf.dwFlags & DDPF_FOURCC)
+	{
+		switch (pf.dwFourCC)
+		{
+		case MakeFourCC('D', 'X', 'T', '1'): return DXGI_FORMAT_BC1_UNORM;
+		case MakeFourCC('D', 'X', 'T', '2'):
+		case MakeFourCC('D', 'X', 'T', '3'): return DXGI_FORMAT_BC2_UNORM;
+		case MakeFourCC('D', 'X', 'T', '4'):
+		case MakeFourCC('D', 'X', 'T', '5'): return DXGI_FORMAT_BC3_UNORM;
+		case MakeFourCC('A', 'T', 'I', '1'):
+		case MakeFourCC('B', 'C', '4', 'U'): return DXGI_FORMAT_BC4_UNORM;
+		case MakeFourCC('B', 'C', '4', 'S'): return DXGI_FORMAT_BC4_SNORM;
+		case MakeFourCC('A', 'T', 'I', '2'):
+		case MakeFourCC('B', 'C', '5', 'U'): return DXGI_FORMAT_BC5_UNORM;
+		case MakeFourCC('B', 'C', '5', 'S'): return DXGI_FORMAT_BC5_SNORM;
+
+		// Old D3DFORMAT values stored in place of a FourCC.
+		case 36: return DXGI_FORMAT_R16G16B16A16_UNORM;
+		case 111: return DXGI_FORMAT_R16_FLOAT;
+		case 112: return DXGI_FORMAT_R16G16_FLOAT;
+		case 113: return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		case 114: return DXGI_FORMAT_R32_FLOAT;
+		case 115: return DXGI_FORMAT_R32G32_FLOAT;
+		case 116: return DXGI_FORMAT_R32G32B32A32_FLOAT;
+		}
+	}
+	else if (pf.dwFlags & DDPF_RGB)
+	{
+		switch (pf.dwRGBBitCount)
+		{
+		case 32:
+			if (IsBitmask(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000, pf))
+				return DXGI_FORMAT_R8G8B8A8_UNORM;
+			if (IsBitmask(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000, pf))
+				return DXGI_FORMAT_B8G8R8A8_UNORM;
+			if (IsBitmask(0x00ff0000, 0x0000ff00, 0x000000ff, 0, pf))
+				return DXGI_FORMAT_B8G8R8X8_UNORM;
+
+			// Older writers swapped red and blue here, but no one means
+			// B10G10R10A2 and D3D11 has no such format anyway.
+			if (IsBitmask(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000, pf)
+				|| IsBitmask(0x000003ff, 0x000ffc00, 0x3ff00000, 0xc0000000, pf))
+				return DXGI_FORMAT_R10G10B10A2_UNORM;
+			if (IsBitmask(0x0000ffff, 0xffff0000, 0, 0, pf))
+				return DXGI_FORMAT_R16G16_UNORM;
+			if (IsBitmask(0xffffffff, 0, 0, 0, pf))
+				return DXGI_FORMAT_R32_FLOAT;
+			break;
+
+		case 16:
+			if (IsBitmask(0xf800, 0x07e0, 0x001f, 0, pf))
+				return DXGI_FORMAT_B5G6R5_UNORM;
+			if (IsBitmask(0x7c00, 0x03e0, 0x001f, 0x8000, pf))
+				return DXGI_FORMAT_B5G5R5A1_UNORM;
+			if (IsBitmask(0x0f00, 0x00f0, 0x000f, 0xf000, pf))
+				return DXGI_FORMAT_B4G4R4A4_UNORM;
+			break;
+		}
+	}
+	else if (pf.dwFlags & DDPF_LUMINANCE)
+	{
+		if (pf.dwRGBBitCount == 8 && IsBitmask(0xff, 0, 0, 0, pf))
+			return DXGI_FORMAT_R8_UNORM;
+		if (pf.dwRGBBitCount == 16 && IsBitmask(0xffff, 0, 0, 0, pf))
+			return DXGI_FORMAT_R16_UNORM;
+		if (pf.dwRGBBitCount == 16 && IsBitmask(0x00ff, 0, 0, 0xff00, pf))
+			return DXGI_FORMAT_R8G8_UNORM;
+	}
+	else if (pf.dwFlags & DDPF_ALPHA)
+	{
+		if (pf.dwRGBBitCount == 8)
+			return DXGI_FORMAT_A8_UNORM;
+	}
+
+	throw std::invalid_argument(
+		FormatString(
+			"Pixel format not supported (flags %#x, fourCC %#x, %u bits)",
+			pf.dwFlags, pf.dwFourCC, pf.dwRGBBitCount
+		).data()
+	);
+}
+
+
+bool DDSFile::IsBlockCompressed(DXGI_FORMAT format)
+{
+	return (format >= DXGI_FORMAT_BC1_UNORM && format <= DXGI_FORMAT_BC5_SNORM)
+		|| (format >= DXGI_FORMAT_BC6H_UF16 && format <= DXGI_FORMAT_BC7_UNORM_SRGB);
+}
+
+
+uint32_t DDSFile::GetBitsPerPixel(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		return 128;
+
+	case DXGI_FORMAT_R16G16B16A16_FLOAT:
+	case DXGI_FORMAT_R16G16B16A16_UNORM:
+	case DXGI_FORMAT_R32G32_FLOAT:
+		return 64;
+
+	case DXGI_FORMAT_R10G10B10A2_UNORM:
+	case DXGI_FORMAT_R11G11B10_FLOAT:
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_R16G16_FLOAT:
+	case DXGI_FORMAT_R16G16_UNORM:
+	case DXGI_FORMAT_R32_FLOAT:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_B8G8R8X8_UNORM:
+	case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
+		return 32;
+
+	case DXGI_FORMAT_R8G8_UNORM:
+	case DXGI_FORMAT_R16_FLOAT:
+	case DXGI_FORMAT_R16_UNORM:
+	case DXGI_FORMAT_B5G6R5_UNORM:
+	case DXGI_FORMAT_B5G5R5A1_UNORM:
+	case DXGI_FORMAT_B4G4R4A4_UNORM:
+		return 16;
+
+	// A 4x4 block of BC2, BC3, BC5, BC6H or BC7 is 16 bytes.
+	case DXGI_FORMAT_R8_UNORM:
+	case DXGI_FORMAT_A8_UNORM:
+	case DXGI_FORMAT_BC2_UNORM:
+	case DXGI_FORMAT_BC2_UNORM_SRGB:
+	case DXGI_FORMAT_BC3_UNORM:
+	case DXGI_FORMAT_BC3_UNORM_SRGB:
+	case DXGI_FORMAT_BC5_UNORM:
+	case DXGI_FORMAT_BC5_SNORM:
+	case DXGI_FORMAT_BC6H_UF16:
+	case DXGI_FORMAT_BC6H_SF16:
+	case DXGI_FORMAT_BC7_UNORM:
+	case DXGI_FORMAT_BC7_UNORM_SRGB:
+		return 8;
+
+	// And of BC1 or BC4, 8 bytes.
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+	case DXGI_FORMAT_BC4_UNORM:
+	case DXGI_FORMAT_BC4_SNORM:
+		return 4;
+
+	default:
+		return 0;
+	}
+}
+
+constexpr bool DDSFile::IsBitmask(uint32_t r, uint32_t g, uint32_t b, uint32_t a, const DDPIXELFORMAT & ddsPixelFormat) const noexcept
+{
+	return
+		ddsPixelFormat.dwRBitMask == r
+		&& ddsPixelFormat.dwGBitMask == g
+		&& ddsPixelFormat.dwBBitMask == b
+		&& ddsPixelFormat.dwRGBAlphaBitMask == a;
+}
@@ -0,0 +1,216 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: ddsfile.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "mappedfile.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: DDSFile
+//
+// A DDS file mapped into memory and validated, with every surface exposed
+// where it lies in the mapping: nothing is copied, so a GPU upload reads
+// straight from the page cache. Handles the legacy header and the DX10
+// extension, full mip chains, cube maps, texture arrays and volumes, and
+// the block compressed formats BC1 to BC7 alongside the common
+// uncompressed ones. Malformed or unsupported files throw
+// std::invalid_argument.
+////////////////////////////////////////////////////////////////////////////////
+class DDSFile
+{
+public:
+	// One mip level of one array slice, in the layout D3D11_SUBRESOURCE_DATA
+	// expects. For block compressed formats a row is a row of 4x4 blocks.
+	struct Surface
+	{
+		const std::byte * pixels;
+		size_t size;
+		uint32_t width, height, depth;
+		uint32_t rowPitch, slicePitch;
+	};
+
+	enum class Dimension
+	{
+		Texture1D,
+		Texture2D,
+		Texture3D,
+	};
+
+	DDSFile(const char* FilePath);
+
+	// Parses a file already in memory, which has to outlive this.
+	DDSFile(const std::byte *, size_t);
+
+	DXGI_FORMAT GetFormat() const { return m_format; }
+	Dimension GetDimension() const { return m_dimension; }
+	uint32_t GetWidth() const { return width; }
+	uint32_t GetHeight() const { return height; }
+	uint32_t GetDepth() const { return depth; }
+	uint32_t GetMipCount() const { return m_mipCount; }
+
+	// Six per cube, so a cube map has 6 and an array of two has 12.
+	uint32_t GetArraySize() const { return m_arraySize; }
+	bool IsCubeMap() const { return m_isCubeMap; }
+
+	// In D3D11 subresource order: every mip of slice 0, then of slice 1...
+	const std::vector<Surface> & GetSurfaces() const { return m_surfaces; }
+	const Surface & GetSurface(uint32_t mip, uint32_t slice = 0) const { return m_surfaces[slice * m_mipCount + mip]; }
+
+	// The top mip of the first slice, for callers that want one image.
+	const std::byte * GetPixels() const { return m_surfaces[0].pixels; }
+	uint32_t GetPitch() const { return m_surfaces[0].rowPitch; }
+
+	// Of all surfaces together.
+	size_t GetSize() const { return m_size; }
+
+	static bool IsBlockCompressed(DXGI_FORMAT);
+
+	// 0 for formats this loader does not know.
+	static uint32_t GetBitsPerPixel(DXGI_FORMAT);
+
+private:
+	///////////////////////////////////////////////////////////////////////////////
+	// DDS struct
+	///////////////////////////////////////////////////////////////////////////////
+
+	enum {
+		DDSCAPS2_CUBEMAP = 0x00000200l,
+		DDSCAPS2_CUBEMAP_ALLFACES = 0x0000fc00l,
+		DDSCAPS2_VOLUME = 0x00200000l,
+
+		DDS_RESOURCE_MISC_TEXTURECUBE = 0x4l,
+
+		DDSD_CAPS = 0x00000001l,
+		DDSD_HEIGHT = 0x00000002l,
+		DDSD_WITH = 0x00000004l,
+		DDSD_PITCH = 0x00000008l,
+		DDSD_ALPHABITDEPTH = 0x00000080l,
+		DDSD_PIXELFORMAT = 0x00001000l,
+		DDSD_MIPMAPCOUNT = 0x00020000l,
+		DDSD_LINEARSIZE = 0x00080000l,
+		DDSD_DEPTH = 0x00800000l,
+
+		DDPF_ALPHAPIXELS = 0x00000001l,
+		DDPF_ALPHA = 0x00000002l,
+		DDPF_FOURCC = 0x00000004l,
+		DDPF_RGB = 0x00000040l,
+		DDPF_LUMINANCE = 0x00020000l
+	};
+
+	// The D3D10_RESOURCE_DIMENSION values the DX10 header uses.
+	enum {
+		DDS_DIMENSION_TEXTURE1D = 2,
+		DDS_DIMENSION_TEXTURE2D = 3,
+		DDS_DIMENSION_TEXTURE3D = 4
+	};
+
+	struct DDPIXELFORMAT
+	{
+		uint32_t    dwSize;
+		uint32_t    dwFlags;
+		uint32_t    dwFourCC;
+		union
+		{
+			uint32_t    dwRGBBitCount;
+			uint32_t    dwYUVBitCount;
+			uint32_t    dwZBufferBitDepth;
+			uint32_t    dwAlphaBitDepth;
+		};
+		union
+		{
+			uint32_t    dwRBitMask;
+			uint32_t    dwYBitMask;
+		};
+		union
+		{
+			uint32_t    dwGBitMask;
+			uint32_t    dwUBitMask;
+		};
+		union {
+			uint32_t    dwBBitMask;
+		};
+		union
+		{
+			uint32_t    dwRGBAlphaBitMask;
+			uint32_t    dwYUVAlphaBitMask;
+		};
+	};
+	static_assert(sizeof(DDPIXELFORMAT) == 32);
+
+	struct DDSCAPS2
+	{
+		uint32_t dwCaps1;
+		uint32_t dwCaps2;
+		uint32_t Reserved[2];
+	};
+	static_assert(sizeof(DDSCAPS2) == 16);
+
+	struct DDSURFACEDESC2
+	{
+		uint32_t dwSize;
+		uint32_t dwFlags;
+		uint32_t dwHeight;
+		uint32_t dwWidth;
+		uint32_t dwPitchOrLinearSize;
+		uint32_t dwDepth;
+		uint32_t dwMipMapCount;
+		uint32_t dwReserved1[11];
+		DDPIXELFORMAT ddpfPixelFormat;
+		DDSCAPS2 ddsCaps;
+		uint32_t dwReserved2;
+	};
+	static_assert(sizeof(DDSURFACEDESC2) == 124);
+
+	// Follows the header when the pixel format's FourCC is DX10.
+	struct DDSHEADERDXT10
+	{
+		uint32_t dxgiFormat;
+		uint32_t resourceDimension;
+		uint32_t miscFlag;
+		uint32_t arraySize;
+		uint32_t miscFlags2;
+	};
+	static_assert(sizeof(DDSHEADERDXT10) == 20);
+
+	void Parse(const std::byte *, size_t);
+	DXGI_FORMAT GetLegacyFormat(const DDPIXELFORMAT &) const;
+
+	// the first argument (a) is the least significant byte of the fourcc (endianness doesn't matter)
+	// the function is evaluated at compile time if the arguments are known (no run-time overhead).
+	static constexpr uint32_t MakeFourCC(const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d) noexcept
+	{
+		return (d << 24) | (c << 16) | (b << 8) | a;
+	}
+
+	// the last character of the argument is the most significant byte of the fourcc
+	// the function is evaluated at compile time if the string argument is known (no run-time overhead).
+	static constexpr uint32_t MakeFourCC(const char p[5]) noexcept
+	{
+		return (p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+	}
+
+	constexpr bool IsBitmask(uint32_t, uint32_t, uint32_t, uint32_t, const DDPIXELFORMAT &) const noexcept;
+
+	MappedFile m_file;
+	std::vector<Surface> m_surfaces;
+	DXGI_FORMAT m_format;
+	Dimension m_dimension;
+	size_t m_size = 0;
+	uint32_t width, height, depth;
+	uint32_t m_mipCount, m_arraySize;
+	bool m_isCubeMap;
+};
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: dirtyranges.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: DirtyRanges
+//
+// Remembers which elements of a buffer changed since it was last uploaded, as
+// a short sorted list of [begin, end) ranges. Ranges closer together than
+// mergeGap are joined since one slightly larger upload is cheaper than two,
+// and past maxRanges everything collapses into a single range.
+////////////////////////////////////////////////////////////////////////////////
+class DirtyRanges
+{
+public:
+	struct Range
+	{
+		size_t begin, end;
+	};
+
+	DirtyRanges(size_t mergeGap = 8, size_t maxRanges = 8) : m_mergeGap(mergeGap), m_maxRanges(maxRanges) {}
+
+	void Add(size_t index) { Add(index, index + 1); }
+
+	void Add(size_t begin, size_t end)
+	{
+		if (begin >= end)
+			return;
+
+		// Skip the ranges that end too far before this one to be merged, then
+		// swallow every range that starts close enough after it.
+		auto first = std::lower_bound(m_ranges.begin(), m_ranges.end(), begin,
+			[this](const Range & range, size_t value) { return range.end + m_mergeGap < value; });
+		auto last = first;
+		for (; last != m_ranges.end() && last->begin <= end + m_mergeGap; ++last)
+		{
+			begin = std::min(begin, last->begin);
+			end = std::max(end, last->end);
+		}
+		m_ranges.insert(m_ranges.erase(first, last), { begin, end });
+
+		if (m_ranges.size() > m_maxRanges)
+		{
+			Range all = { m_ranges.front().begin, m_ranges.back().end };
+			m_ranges.assign(1, all);
+		}
+	}
+
+	void Clear() { m_ranges.clear(); }
+	bool Empty() const { return m_ranges.empty(); }
+	const std::vector<Range> & GetRanges() const { return m_ranges; }
+
+	// The number of elements covered.
+	size_t GetCount() const
+	{
+		size_t count = 0;
+		for (const auto & range : m_ranges)
+			count += range.end - range.begin;
+		return count;
+	}
+
+private:
+	size_t m_mergeGap, m_maxRanges;
+	std::vector<Range> m_ranges;
+};
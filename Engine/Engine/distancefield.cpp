@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: distancefield.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "distancefield.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+// Large enough to never be the nearest, small enough that subtracting two
+// of them is not NaN.
+static const float Far = 1e20f;
+
+
+void DistanceField::FromCoverage(std::byte * out, const std::byte * coverage,
+	int width, int height, int pitch, int spread)
+{
+	int fieldWidth = width + 2 * spread, fieldHeight = height + 2 * spread;
+	size_t size = static_cast<size_t>(fieldWidth) * fieldHeight;
+
+	// outer holds the squared distance to the glyph, inner the squared
+	// distance to the background. A partly covered pixel is treated as lying
+	// that far off the outline, which is what keeps small text from wobbling.
+	std::vector<float> outer(size, Far), inner(size, 0.0f);
+	for (int y = 0; y < height; y++)
+		for (int x = 0; x < width; x++)
+		{
+			float a = std::to_integer<int>(coverage[y * pitch + x]) / 255.0f;
+			size_t i = static_cast<size_t>(y + spread) * fieldWidth + x + spread;
+			if (a >= 1.0f)
+			{
+				outer[i] = 0.0f;
+				inner[i] = Far;
+			}
+			else if (a > 0.0f)
+			{
+				float d = std::max(0.0f, 0.5f - a), e = std::max(0.0f, a - 0.5f);
+				outer[i] = d * d;
+				inner[i] = e * e;
+			}
+		}
+
+	Transform(outer.data(), fieldWidth, fieldHeight);
+	Transform(inner.data(), fieldWidth, fieldHeight);
+
+	float scale = 0.5f / spread;
+	for (size_t i = 0; i < size; i++)
+	{
+		float distance = std::sqrt(outer[i]) - std::sqrt(inner[i]);
+		float value = std::min(std::max(0.5f - distance * scale, 0.0f), 1.0f);
+		out[i] = static_cast<std::byte>(value * 255.0f + 0.5f);
+	}
+}
+
+
+// Columns then rows, each an exact 1D transform, give the exact 2D one.
+void DistanceField::Transform(float * grid, int width, int height)
+{
+	size_t length = static_cast<size_t>(std::max(width, height));
+	std::vector<float> f(length), z(length + 1);
+	std::vector<int> v(length);
+	for (int x = 0; x < width; x++)
+		Transform1D(grid, x, width, height, f.data(), z.data(), v.data());
+	for (int y = 0; y < height; y++)
+		Transform1D(grid, static_cast<size_t>(y) * width, 1, width, f.data(), z.data(), v.data());
+}
+
+
+// Felzenszwalb and Huttenlocher: the lower envelope of the parabolas rooted
+// at each sample, in linear time.
+void DistanceField::Transform1D(float * grid, size_t offset, size_t stride, size_t length,
+	float * f, float * z, int * v)
+{
+	v[0] = 0;
+	z[0] = -Far;
+	z[1] = Far;
+	f[0] = grid[offset];
+
+	int k = 0;
+	for (int q = 1; q < static_cast<int>(length); q++)
+	{
+		f[q] = grid[offset + q * stride];
+		float s;
+		do
+		{
+			int r = v[k];
+			s = (f[q] - f[r] + static_cast<float>(q * q - r * r)) / (2.0f * (q - r));
+		} while (s <= z[k] && --k > -1);
+
+		k++;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = Far;
+	}
+
+	k = 0;
+	for (int q = 0; q < static_cast<int>(length); q++)
+	{
+		while (z[k + 1] < q)
+			k++;
+		int r = v[k];
+		grid[offset + q * stride] = f[r] + static_cast<float>((q - r) * (q - r));
+	}
+}
@@ -0,0 +1,35 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: distancefield.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: DistanceField
+//
+// Turns an antialiased coverage bitmap into a signed distance field with an
+// exact Euclidean distance transform, using the coverage to place the
+// outline inside edge pixels. The field is stored as 0.5 on the outline,
+// rising to 1 at spread pixels inside and falling to 0 at spread pixels
+// outside, so one 8-bit texture draws sharp edges at any scale.
+////////////////////////////////////////////////////////////////////////////////
+class DistanceField
+{
+public:
+	// Writes (width + 2 * spread) x (height + 2 * spread) bytes to out, the
+	// glyph centred with spread pixels of margin so the field has room to
+	// fall off on every side.
+	static void FromCoverage(std::byte * out, const std::byte * coverage,
+		int width, int height, int pitch, int spread);
+
+private:
+	static void Transform(float * grid, int width, int height);
+	static void Transform1D(float * grid, size_t offset, size_t stride, size_t length,
+		float * f, float * z, int * v);
+};
@@ -0,0 +1,591 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: fontatlas.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "fontatlas.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "distancefield.h"
+#include "jobsystem.h"
+#include "mappedfile.h"
+#include "profiler.h"
+
+
+// Reads one code point and advances past it. Malformed input decodes as
+// U+FFFD one byte at a time rather than swallowing what follows.
+static char32_t DecodeUtf8(std::string_view & text)
+{
+	auto byte = [&](size_t i) { return i < text.size() ? static_cast<unsigned char>(text[i]) : 0; };
+	unsigned char lead = byte(0);
+	size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+	if (length == 0)
+	{
+		text.remove_prefix(1);
+		return 0xFFFD;
+	}
+
+	char32_t codePoint = length == 1 ? lead : lead & (0x7F >> length);
+	for (size_t i = 1; i < length; i++)
+	{
+		if ((byte(i) & 0xC0) != 0x80)
+		{
+			text.remove_prefix(1);
+			return 0xFFFD;
+		}
+		codePoint = (codePoint << 6) | (byte(i) & 0x3F);
+	}
+	text.remove_prefix(length);
+	return codePoint;
+}
+
+
+bool FontAtlas::LoadTTF(FT_Library p_library, const FT_Byte* buffer, FT_Long length, FT_UInt pixelSize, Mode mode)
+{
+	PROFILE_SCOPE("FontAtlas::LoadTTF");
+
+	// FreeType reads the data for as long as the face is open.
+	Clear();
+	m_library = p_library;
+	m_fontData.assign(buffer, buffer + length);
+	m_mode = mode;
+	m_pixelSize = static_cast<int>(pixelSize);
+	if (!OpenFace())
+		return false;
+
+	FT_Face face = m_face.get();
+	m_lineHeight = face->size->metrics.height >> 6;
+	LoadKerning();
+
+	// Render the preloaded set first so the page can be sized to hold it.
+	std::vector<Bitmap> pending;
+	for (char32_t c = FirstPreloaded; c <= LastPreloaded; c++)
+	{
+		// Have to use FT_LOAD_RENDER.
+		// If use FT_LOAD_DEFAULT, the actual glyph bitmap won't be loaded,
+		// thus bitmap->rows will be incorrect, causing insufficient max_height.
+		if (FT_Load_Char(face, c, GetLoadFlags()) != 0)
+		{
+			throw std::runtime_error(
+				FormatString(
+					"Could not load glyph %d (%c)", c, c
+				).data()
+			);
+		}
+		pending.push_back(Render(face->glyph));
+	}
+
+	// FreeType is done with; the distance transforms are independent, so
+	// the glyphs are handed out a few at a time to the job system.
+	if (mode == Mode::DistanceField)
+	{
+		JobSystem::Get().ParallelFor(0, pending.size(), 4, [&](size_t first, size_t last) {
+			for (size_t i = first; i < last; i++)
+				ToDistanceField(pending[i]);
+		});
+	}
+
+	size_t area = 0;
+	for (const auto & bitmap : pending)
+		area += static_cast<size_t>(bitmap.glyph.width + Padding) * (bitmap.glyph.height + Padding);
+
+	// The smallest square that holds them, starting from a guess with some
+	// slack and doubling until everything fits.
+	m_pageSize = MinPageSize;
+	while (m_pageSize * m_pageSize < area + area / 4 && m_pageSize < MaxPageSize)
+		m_pageSize *= 2;
+	for (;; m_pageSize *= 2)
+	{
+		SkylinePacker packer(static_cast<int>(m_pageSize));
+		POINT position;
+		bool fits = true;
+		for (const auto & bitmap : pending)
+			fits = fits && packer.Pack(bitmap.glyph.width + Padding, bitmap.glyph.height + Padding, position);
+		if (fits || m_pageSize >= MaxPageSize)
+			break;
+	}
+
+	for (char32_t c = FirstPreloaded; c <= LastPreloaded; c++)
+		Insert(c, pending[c - FirstPreloaded]);
+
+ 	return true;
+}
+
+
+bool FontAtlas::OpenFace()
+{
+	FT_Face face;
+	if (FT_New_Memory_Face(m_library, m_fontData.data(), static_cast<FT_Long>(m_fontData.size()), 0, &face))
+		return false;
+	m_face.reset(face);
+	return FT_Set_Pixel_Sizes(face, 0, m_pixelSize) == 0;
+}
+
+
+void FontAtlas::Clear()
+{
+	m_face.reset();
+	m_fontData.clear();
+	m_lineHeight = 0;
+	m_pageSize = 0;
+	m_pages.clear();
+	m_glyphs.clear();
+	m_kerning.clear();
+	std::fill(std::begin(m_hasAscii), std::end(m_hasAscii), false);
+}
+
+
+// The cache starts with this, followed by the glyph table, then each page's
+// packer and pixels.
+struct CacheHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t fontHash;
+	uint32_t pixelSize, mode, lineHeight, pageSize, pageCount, glyphCount;
+};
+
+
+// FNV-1a, which is plenty to tell font files apart.
+uint64_t FontAtlas::Hash(const FT_Byte * data, size_t length)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (size_t i = 0; i < length; i++)
+		hash = (hash ^ data[i]) * 0x100000001b3ull;
+	return hash;
+}
+
+
+bool FontAtlas::LoadCachedTTF(FT_Library p_library, const FT_Byte* buffer, FT_Long length, FT_UInt pixelSize,
+	Mode mode, const char * cachePath)
+{
+	MappedFile cache;
+	if (cache.Open(cachePath) && LoadCache(p_library, buffer, length, pixelSize, mode, cache.GetData(), cache.GetSize()))
+		return true;
+
+	// Windows will not replace a file that is still mapped.
+	cache.Close();
+	if (!LoadTTF(p_library, buffer, length, pixelSize, mode))
+		return false;
+
+	// Written aside and renamed over the old one, so a crash never leaves a
+	// half written cache behind. Failing to write it only costs the next
+	// start the time this one took.
+	try
+	{
+		std::filesystem::path path(cachePath), temporary(cachePath);
+		temporary += ".tmp";
+		if (path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path());
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.exceptions(std::fstream::failbit | std::fstream::badbit);
+			SaveCache(file);
+		}
+		std::filesystem::rename(temporary, path);
+	}
+	catch (std::exception &)
+	{
+	}
+	return true;
+}
+
+
+void FontAtlas::SaveCache(std::ostream & stream) const
+{
+	std::vector<std::pair<uint32_t, const Glyph *>> glyphs;
+	for (char32_t c = 0; c < 128; c++)
+		if (m_hasAscii[c])
+			glyphs.emplace_back(c, &m_ascii[c]);
+	for (const auto & glyph : m_glyphs)
+		glyphs.emplace_back(glyph.first, &glyph.second);
+
+	CacheHeader header = {
+		{ 'F', 'A', 'T', 'L' }, CacheVersion, Hash(m_fontData.data(), m_fontData.size()),
+		static_cast<uint32_t>(m_pixelSize), static_cast<uint32_t>(m_mode), static_cast<uint32_t>(m_lineHeight),
+		static_cast<uint32_t>(m_pageSize), static_cast<uint32_t>(m_pages.size()), static_cast<uint32_t>(glyphs.size())
+	};
+	BinaryWriter writer(stream);
+	writer.Write(header);
+	for (const auto & glyph : glyphs)
+	{
+		writer.Write(glyph.first);
+		writer.Write(*glyph.second);
+	}
+	writer.Write(static_cast<uint32_t>(m_kerning.size()));
+	writer.Write(m_kerning.data(), m_kerning.size() * sizeof(int16_t));
+	for (const auto & page : m_pages)
+	{
+		page.packer.Save(writer);
+		writer.Write(page.pixels.get(), m_pageSize * m_pageSize);
+	}
+}
+
+
+bool FontAtlas::LoadCache(FT_Library p_library, const FT_Byte* buffer, FT_Long length, FT_UInt pixelSize,
+	Mode mode, const std::byte * data, size_t size)
+{
+	Clear();
+	try
+	{
+		MemoryReader reader(data, size);
+		auto header = reader.Get<CacheHeader>();
+		if (std::memcmp(header.magic, "FATL", 4) != 0 || header.version != CacheVersion ||
+			header.pixelSize != pixelSize || header.mode != static_cast<uint32_t>(mode) ||
+			header.fontHash != Hash(buffer, static_cast<size_t>(length)))
+			return false;
+		if (header.pageSize < MinPageSize || header.pageSize > MaxPageSize ||
+			(header.pageSize & (header.pageSize - 1)) != 0 || header.pageCount == 0)
+			throw std::out_of_range("Bad page size");
+
+		for (uint32_t i = 0; i < header.glyphCount; i++)
+		{
+			char32_t codePoint = reader.Get<uint32_t>();
+			auto glyph = reader.Get<Glyph>();
+			if (glyph.page >= header.pageCount)
+				throw std::out_of_range("Glyph on a page that is not there");
+			if (codePoint < 128)
+			{
+				m_ascii[codePoint] = glyph;
+				m_hasAscii[codePoint] = true;
+			}
+			else
+				m_glyphs[codePoint] = glyph;
+		}
+
+		auto kerningCount = reader.Get<uint32_t>();
+		if (kerningCount != 0 && kerningCount != PreloadedCount * PreloadedCount)
+			throw std::out_of_range("Bad kerning table");
+		m_kerning.resize(kerningCount);
+		reader.Read(m_kerning.data(), kerningCount * sizeof(int16_t));
+
+		m_pageSize = header.pageSize;
+		for (uint32_t i = 0; i < header.pageCount; i++)
+		{
+			AddPage();
+			auto & page = m_pages.back();
+			page.packer.Load(reader);
+			if (page.packer.GetSize() != static_cast<int>(m_pageSize))
+				throw std::out_of_range("Packer does not match its page");
+			reader.Read(page.pixels.get(), m_pageSize * m_pageSize);
+		}
+		m_lineHeight = static_cast<int>(header.lineHeight);
+	}
+	catch (std::exception &)
+	{
+		Clear();
+		return false;
+	}
+
+	// Kept for glyphs the cache lacks; the face itself is opened only then.
+	m_library = p_library;
+	m_fontData.assign(buffer, buffer + length);
+	m_mode = mode;
+	m_pixelSize = static_cast<int>(pixelSize);
+	return true;
+}
+
+
+// Distance fields are drawn at other sizes, where hinting for this one
+// would only distort the outlines.
+FT_Int32 FontAtlas::GetLoadFlags() const
+{
+	return m_mode == Mode::DistanceField ? FT_LOAD_RENDER | FT_LOAD_NO_HINTING : FT_LOAD_RENDER;
+}
+
+
+FontAtlas::Bitmap FontAtlas::Render(FT_GlyphSlot slot)
+{
+	Bitmap bitmap = {};
+	auto & glyph = bitmap.glyph;
+
+	// Advance is in 1/64 pixels, so bitshift by 6 to get value in pixels (2^6 = 64).
+	glyph.advance = static_cast<int16_t>((slot->advance.x + 32) >> 6);
+	glyph.left = static_cast<int16_t>(slot->bitmap_left);
+	glyph.top = static_cast<int16_t>(slot->bitmap_top);
+	glyph.width = static_cast<uint16_t>(slot->bitmap.width);
+	glyph.height = static_cast<uint16_t>(slot->bitmap.rows);
+
+	bitmap.pixels.resize(static_cast<size_t>(glyph.width) * glyph.height);
+	for (unsigned row = 0; row < glyph.height; row++)
+		std::memcpy(&bitmap.pixels[row * glyph.width], slot->bitmap.buffer + row * slot->bitmap.pitch, glyph.width);
+	return bitmap;
+}
+
+
+// The field needs a margin to fall off in, so the quad grows by the spread
+// on every side.
+void FontAtlas::ToDistanceField(Bitmap & bitmap)
+{
+	auto & glyph = bitmap.glyph;
+	if (glyph.width == 0 || glyph.height == 0)
+		return;
+
+	const int spread = DistanceFieldSpread;
+	std::vector<std::byte> field(static_cast<size_t>(glyph.width + 2 * spread) * (glyph.height + 2 * spread));
+	DistanceField::FromCoverage(field.data(), bitmap.pixels.data(), glyph.width, glyph.height, glyph.width, spread);
+	bitmap.pixels.swap(field);
+
+	glyph.left -= spread;
+	glyph.top += spread;
+	glyph.width += 2 * spread;
+	glyph.height += 2 * spread;
+}
+
+
+const FontAtlas::Glyph * FontAtlas::GetGlyph(char32_t codePoint)
+{
+	if (codePoint < 128)
+	{
+		if (m_hasAscii[codePoint])
+			return &m_ascii[codePoint];
+	}
+	else
+	{
+		auto glyph = m_glyphs.find(codePoint);
+		if (glyph != m_glyphs.end())
+			return &glyph->second;
+	}
+	return Rasterize(codePoint);
+}
+
+
+// Characters the face lacks come back as its .notdef box, which is cached
+// like any other glyph so the miss is only paid once.
+const FontAtlas::Glyph * FontAtlas::Rasterize(char32_t codePoint)
+{
+	if (m_face == nullptr && (m_fontData.empty() || !OpenFace()))
+		return nullptr;
+	if (FT_Load_Char(m_face.get(), codePoint, GetLoadFlags()) != 0)
+		return nullptr;
+
+	auto bitmap = Render(m_face->glyph);
+	if (m_mode == Mode::DistanceField)
+		ToDistanceField(bitmap);
+	return Insert(codePoint, bitmap);
+}
+
+
+const FontAtlas::Glyph * FontAtlas::Insert(char32_t codePoint, const Bitmap & bitmap)
+{
+	Glyph glyph = bitmap.glyph;
+	if (glyph.width > 0 && glyph.height > 0)
+	{
+		// Try the last page, then a fresh one; a glyph larger than a whole
+		// page is dropped.
+		POINT position;
+		if (m_pages.empty() || !m_pages.back().packer.Pack(glyph.width + Padding, glyph.height + Padding, position))
+		{
+			AddPage();
+			if (!m_pages.back().packer.Pack(glyph.width + Padding, glyph.height + Padding, position))
+				return nullptr;
+		}
+
+		auto & page = m_pages.back();
+		for (int y = 0; y < glyph.height; y++)
+			std::memcpy(&page.pixels[(position.y + y) * m_pageSize + position.x], &bitmap.pixels[y * glyph.width], glyph.width);
+
+		RECT rect = { position.x, position.y, position.x + glyph.width, position.y + glyph.height };
+		page.dirty = page.isDirty
+			? RECT{ std::min(page.dirty.left, rect.left), std::min(page.dirty.top, rect.top),
+				std::max(page.dirty.right, rect.right), std::max(page.dirty.bottom, rect.bottom) }
+			: rect;
+		page.isDirty = true;
+
+		float size = static_cast<float>(m_pageSize), index = static_cast<float>(m_pages.size() - 1);
+		glyph.page = static_cast<uint16_t>(m_pages.size() - 1);
+		glyph.u0 = index + rect.left / size;
+		glyph.u1 = index + rect.right / size;
+		glyph.v0 = rect.top / size;
+		glyph.v1 = rect.bottom / size;
+	}
+
+	if (codePoint < 128)
+	{
+		m_ascii[codePoint] = glyph;
+		m_hasAscii[codePoint] = true;
+		return &m_ascii[codePoint];
+	}
+	return &(m_glyphs[codePoint] = glyph);
+}
+
+
+void FontAtlas::AddPage()
+{
+	Page page;
+	page.pixels = std::make_unique<std::byte[]>(m_pageSize * m_pageSize);
+	page.packer.Reset(static_cast<int>(m_pageSize));
+	page.isDirty = false;
+	m_pages.push_back(std::move(page));
+}
+
+
+bool FontAtlas::TakeDirtyRect(size_t page, RECT & rect)
+{
+	if (page >= m_pages.size() || !m_pages[page].isDirty)
+		return false;
+	rect = m_pages[page].dirty;
+	m_pages[page].isDirty = false;
+	return true;
+}
+
+
+void FontAtlas::Layout(std::string_view text, TextLayout & layout, float scale, float maxWidth)
+{
+	auto & glyphs = layout.glyphs;
+	glyphs.clear();
+	layout.scale = scale;
+	layout.width = 0;
+	layout.lines = 1;
+
+	float lineHeight = m_lineHeight * scale, penX = 0, penY = 0;
+	char32_t previous = 0;
+
+	// The first glyph of the line, and the first after its last space along
+	// with where the line would end if broken there.
+	size_t lineStart = 0, wordStart = SIZE_MAX;
+	float wordBreakWidth = 0;
+
+	while (!text.empty())
+	{
+		char32_t codePoint = DecodeUtf8(text);
+		if (codePoint == '\n')
+		{
+			layout.width = std::max(layout.width, penX);
+			penX = 0;
+			penY -= lineHeight;
+			layout.lines++;
+			lineStart = glyphs.size();
+			wordStart = SIZE_MAX;
+			previous = 0;
+			continue;
+		}
+
+		const Glyph * glyph = GetGlyph(codePoint);
+		if (glyph == nullptr)
+			continue;
+		penX += GetKerning(previous, codePoint) * scale;
+		previous = codePoint;
+
+		// Spaces may hang past the edge; anything else starts a new line,
+		// taking the rest of its word along if the line has a space to break at.
+		float advance = glyph->advance * scale;
+		if (maxWidth > 0 && codePoint != ' ' && penX + advance > maxWidth && glyphs.size() > lineStart)
+		{
+			bool atSpace = wordStart != SIZE_MAX;
+			size_t first = atSpace ? wordStart : glyphs.size();
+			float shift = first < glyphs.size() ? glyphs[first].x : penX;
+			for (size_t i = first; i < glyphs.size(); i++)
+			{
+				glyphs[i].x -= shift;
+				glyphs[i].y -= lineHeight;
+			}
+			layout.width = std::max(layout.width, atSpace ? wordBreakWidth : penX);
+			penX -= shift;
+			penY -= lineHeight;
+			layout.lines++;
+			lineStart = first;
+			wordStart = SIZE_MAX;
+		}
+
+		glyphs.push_back({ glyph, penX, penY });
+		if (codePoint == ' ')
+		{
+			// A run of spaces does not count towards the broken line's width.
+			if (wordStart != glyphs.size() - 1)
+				wordBreakWidth = penX;
+			wordStart = glyphs.size();
+		}
+		penX += advance;
+	}
+
+	layout.width = std::max(layout.width, penX);
+	layout.height = layout.lines * lineHeight;
+}
+
+
+// The table is only kept for the preloaded glyphs, which is where nearly all
+// kerned pairs are; anything else is set solid.
+void FontAtlas::LoadKerning()
+{
+	m_kerning.clear();
+	FT_Face face = m_face.get();
+	if (!FT_HAS_KERNING(face))
+		return;
+
+	FT_UInt indices[PreloadedCount];
+	for (size_t i = 0; i < PreloadedCount; i++)
+		indices[i] = FT_Get_Char_Index(face, static_cast<FT_ULong>(FirstPreloaded + i));
+
+	// Unhinted distance fields are drawn scaled, so their kerning must not
+	// be rounded to this size's pixels either.
+	FT_UInt kerningMode = m_mode == Mode::DistanceField ? FT_KERNING_UNFITTED : FT_KERNING_DEFAULT;
+	bool any = false;
+	m_kerning.assign(PreloadedCount * PreloadedCount, 0);
+	for (size_t left = 0; left < PreloadedCount; left++)
+		for (size_t right = 0; right < PreloadedCount; right++)
+		{
+			FT_Vector kerning;
+			if (FT_Get_Kerning(face, indices[left], indices[right], kerningMode, &kerning) == 0 && kerning.x != 0)
+			{
+				m_kerning[left * PreloadedCount + right] = static_cast<int16_t>(kerning.x);
+				any = true;
+			}
+		}
+	if (!any)
+		m_kerning.clear();
+}
+
+
+float FontAtlas::GetKerning(char32_t left, char32_t right) const
+{
+	if (m_kerning.empty() || left < FirstPreloaded || left > LastPreloaded || right < FirstPreloaded || right > LastPreloaded)
+		return 0;
+	return m_kerning[(left - FirstPreloaded) * PreloadedCount + (right - FirstPreloaded)] / 64.0f;
+}
+
+
+size_t FontAtlas::BuildVertexArray(void* vertices, const TextLayout & layout, float drawX, float drawY) const
+{
+	VertexType* vertexPtr = (VertexType*)vertices;
+	float scale = layout.scale;
+
+	// Draw each letter onto a quad.
+	uint32_t index = 0;
+	for (const auto & position : layout.glyphs)
+	{
+		// Spaces and the like only move the pen.
+		const Glyph * glyph = position.glyph;
+		if (glyph->width == 0 || glyph->height == 0)
+			continue;
+
+		float
+			left = drawX + position.x + glyph->left * scale,
+			right = left + glyph->width * scale,
+			top = drawY + position.y + glyph->top * scale,
+			bottom = top - glyph->height * scale;
+		vertexPtr[index++] = { { left, top, 0 },{ glyph->u0, glyph->v0 } }; // Top left.
+		vertexPtr[index++] = { { right, top, 0 },{ glyph->u1, glyph->v0 } }; // Top right.
+		vertexPtr[index++] = { { left, bottom, 0 },{ glyph->u0, glyph->v1 } }; // Bottom left.
+		vertexPtr[index++] = { { right, bottom, 0 },{ glyph->u1, glyph->v1 } }; // Bottom right.
+	}
+
+	return index / 4;
+}
+
+
+size_t FontAtlas::BuildVertexArray(void* vertices, std::string_view sentence, float drawX, float drawY, float scale, float maxWidth)
+{
+	Layout(sentence, m_layout, scale, maxWidth);
+	return BuildVertexArray(vertices, m_layout, drawX, drawY);
+}
+
+
+POINT FontAtlas::MeasureString(std::string_view sentence, float scale, float maxWidth)
+{
+	Layout(sentence, m_layout, scale, maxWidth);
+	return { static_cast<LONG>(std::lround(m_layout.width)), static_cast<LONG>(std::lround(m_layout.height)) };
+}
@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: fontatlas.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include "ft2build.h"
+#include FT_FREETYPE_H
+#include FT_GLYPH_H
+#include <cstddef>
+#include <iosfwd>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "skylinepacker.h"
+#include "vertextypes.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: FontAtlas
+//
+// Rasterizes glyphs of a face into square, power of two pages and lays text
+// out against them. Printable ASCII is rasterized up front; any other code
+// point is rasterized the first time it is asked for, into free space on the
+// last page or onto a new page once that is full. Font turns the pages into
+// a texture array and keeps it in step.
+//
+// Pages hold either plain coverage, drawn at the size it was rasterized at,
+// or signed distance fields, which one atlas per face draws at any size.
+////////////////////////////////////////////////////////////////////////////////
+class FontAtlas
+{
+public:
+	// Metrics in whole pixels, with y up from the baseline, and where the
+	// glyph sits in the atlas. u0 and u1 include the page index as their
+	// integer part, which is how a quad tells the shader which page to read.
+	struct Glyph
+	{
+		int16_t advance, left, top;
+		uint16_t width, height, page;
+		float u0, v0, u1, v1;
+	};
+
+	// Where Layout put a glyph: its pen position on the baseline.
+	struct GlyphPosition
+	{
+		const Glyph * glyph;
+		float x, y;
+	};
+
+	// Text laid out from (0, 0) on the first baseline, with y going down a
+	// line height per line. Reused between calls, so laying out the same
+	// amount of text again allocates nothing.
+	struct TextLayout
+	{
+		float width = 0, height = 0, scale = 1;
+		size_t lines = 0;
+		std::vector<GlyphPosition> glyphs;
+	};
+
+	enum class Mode
+	{
+		Coverage,
+		DistanceField,
+	};
+
+	// How far the distance field reaches either side of the outline, in
+	// pixels at the size the atlas was rasterized at.
+	static const int DistanceFieldSpread = 4;
+
+	FontAtlas() = default;
+
+	// Keeps its own copy of the font data, and the face stays open for
+	// glyphs rasterized later. Distance fields of the preloaded glyphs are
+	// built on the JobSystem.
+	bool LoadTTF(FT_Library, const FT_Byte *, FT_Long, FT_UInt, Mode = Mode::Coverage);
+
+	// LoadTTF, restored from the cache file at cachePath if that was written
+	// for the same font data, size and mode by this version of the code, or
+	// else loaded normally and written there for next time. A cache hit
+	// starts FreeType only when a glyph the cache lacks is asked for.
+	bool LoadCachedTTF(FT_Library, const FT_Byte *, FT_Long, FT_UInt, Mode, const char * cachePath);
+
+	// The pages, the packer state and every glyph rasterized so far.
+	void SaveCache(std::ostream &) const;
+
+	// False, leaving nothing loaded, if the bytes are not a SaveCache of this
+	// font data at this size and mode.
+	bool LoadCache(FT_Library, const FT_Byte *, FT_Long, FT_UInt, Mode, const std::byte *, size_t);
+
+	// Nullptr if the face has no such glyph and no fallback box either.
+	const Glyph * GetGlyph(char32_t);
+
+	Mode GetMode() const { return m_mode; }
+	int GetPixelSize() const { return m_pixelSize; }
+	size_t GetPageSize() const { return m_pageSize; }
+	size_t GetPageCount() const { return m_pages.size(); }
+	const std::byte * GetPixels(size_t page) const { return m_pages[page].pixels.get(); }
+	int GetLineHeight() const { return m_lineHeight; }
+
+	// The part of a page written since the last call, if any.
+	bool TakeDirtyRect(size_t page, RECT &);
+
+	// One pass over UTF-8 text: each glyph moves the pen by its advance plus
+	// its kerning with the one before. Lines break at '\n' and, when
+	// maxWidth is above 0, before a word that would cross it; a word longer
+	// than that is broken between glyphs. scale is the drawn size over
+	// GetPixelSize, which only looks right away from 1 for distance fields.
+	void Layout(std::string_view, TextLayout &, float scale = 1.0f, float maxWidth = 0.0f);
+
+	// Four VertexType corners per visible glyph, ordered for BuildQuadIndices,
+	// with the first baseline at y. Returns how many glyph quads were written.
+	size_t BuildVertexArray(void *, const TextLayout &, float, float) const;
+	size_t BuildVertexArray(void *, std::string_view, float, float, float scale = 1.0f, float maxWidth = 0.0f);
+
+	// The widest line and the height of all of them, in pixels.
+	POINT MeasureString(std::string_view, float scale = 1.0f, float maxWidth = 0.0f);
+
+private:
+	struct Page
+	{
+		std::unique_ptr<std::byte[]> pixels;
+		SkylinePacker packer;
+		RECT dirty;
+		bool isDirty;
+	};
+
+	struct Bitmap
+	{
+		Glyph glyph;
+		std::vector<std::byte> pixels;
+	};
+
+	struct FaceDeleter
+	{
+		void operator()(FT_Face face) const { FT_Done_Face(face); }
+	};
+
+	// The code points rasterized up front.
+	static const char32_t FirstPreloaded = 32, LastPreloaded = 126;
+	static const int Padding = 1;
+	static const size_t MinPageSize = 64, MaxPageSize = 2048;
+
+	// Bump whenever the rasterized output or the file layout changes.
+	static const uint32_t CacheVersion = 2;
+	static const size_t PreloadedCount = LastPreloaded - FirstPreloaded + 1;
+
+	static uint64_t Hash(const FT_Byte *, size_t);
+	bool OpenFace();
+	void Clear();
+	void LoadKerning();
+	float GetKerning(char32_t, char32_t) const;
+
+	static Bitmap Render(FT_GlyphSlot);
+	static void ToDistanceField(Bitmap &);
+	FT_Int32 GetLoadFlags() const;
+	const Glyph * Rasterize(char32_t);
+	const Glyph * Insert(char32_t, const Bitmap &);
+	void AddPage();
+
+	FT_Library m_library = nullptr;
+	std::vector<FT_Byte> m_fontData;
+	std::unique_ptr<FT_FaceRec_, FaceDeleter> m_face;
+	Mode m_mode = Mode::Coverage;
+	int m_pixelSize = 0;
+	int m_lineHeight = 0;
+	size_t m_pageSize = 0;
+	std::vector<Page> m_pages;
+
+	// ASCII is looked up directly, the rest through the map.
+	Glyph m_ascii[128];
+	bool m_hasAscii[128] = {};
+	std::unordered_map<char32_t, Glyph> m_glyphs;
+
+	// Kerning between preloaded glyphs in 1/64 pixels, PreloadedCount
+	// squared, or empty if the face has none.
+	std::vector<int16_t> m_kerning;
+	TextLayout m_layout;
+};
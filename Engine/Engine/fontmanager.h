@@ -11,9 +11,6 @@
 ///////////////////////
 // INCLUDES //
 ///////////////////////
-#include "ft2build.h"
-#include FT_FREETYPE_H
-#include FT_GLYPH_H
 #include <wrl\client.h>
 
 
@@ -22,6 +19,7 @@
 ///////////////////////
 #include "textureclass.h"
 #include "fontshaderclass.h"
+#include "fontatlas.h"
 #include "game.h"
 
 
@@ -41,46 +39,43 @@ public:
 	Font(ID3D11Device * p_device, ID3D11DeviceContext * p_deviceContext)
 	:
 		m_device(p_device),
-		m_deviceContext(p_deviceContext),
-		m_numGlyphs(127 - 32)
+		m_deviceContext(p_deviceContext)
 	{}
 
-	bool LoadTTF(FT_Library, FT_Byte *, FT_Long);
-	auto GetTexture() const { return m_texture.Get(); }
-	void BuildVertexArray(void *, const char *, float, float);
-	POINT && MeasureString(const char *);
-
-private:
-	struct GlyphInfo 
-	{
-		uint32_t 
-			ax, // advance.x
-			ay, // advance.y
+	// One distance field atlas per face, rasterized at DistanceFieldSize
+	// and drawn at whatever size SetPixelSize asks for.
+	static const FT_UInt DistanceFieldSize = 32;
 
-			bw, // bitmap.width
-			bh, // bitmap.rows
+	// The atlas comes from the cache file when it is current, otherwise it
+	// is rasterized and the cache written. Touches no D3D state, so it can
+	// run off the render thread; the texture is made by the first Upload.
+	bool LoadTTF(FT_Library, FT_Byte *, FT_Long, const char * cachePath);
 
-			x, y; // Position of glyph on texture map in pixels.
+	// Changing the size, say for a new DPI, rasterizes nothing.
+	void SetPixelSize(float pixels) { m_scale = pixels / m_atlas.GetPixelSize(); }
+	float GetScale() const { return m_scale; }
 
-		float left, right; // UV coords of glyph on texture map.
-		FT_BBox bbox;
-	};
-	FT_Short
-		height,
-		max_advance_width;
+	// Copies glyphs rasterized since the last call into the texture, which
+	// is rebuilt if the atlas gained a page. Call before drawing with it.
+	void Upload();
+	auto GetTexture() const { return m_texture.Get(); }
+	size_t BuildVertexArray(void * vertices, const char * sentence, float drawX, float drawY)
+	{
+		return m_atlas.BuildVertexArray(vertices, sentence, drawX, drawY, m_scale);
+	}
+	FontAtlas & GetAtlas() { return m_atlas; }
+	POINT MeasureString(std::string_view sentence, float maxWidth = 0.0f) { return m_atlas.MeasureString(sentence, m_scale, maxWidth); }
 
-	void StitchGlyph(const std::byte *, const GlyphInfo &, uint32_t, uint32_t, std::byte *);
-	
 private:
+	void CreateTexture();
+
 	ID3D11Device * m_device;
 	ID3D11DeviceContext * m_deviceContext;
-	FT_Face m_face;
-	std::unique_ptr<GlyphInfo[]> m_glyphSlots;
+	FontAtlas m_atlas;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> m_pages;
 	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_texture;
-	size_t
-		m_width,
-		m_height = 0,
-		m_numGlyphs;
+	size_t m_pageCount = 0;
+	float m_scale = 1.0f;
 };
 
 class Fonts
@@ -92,11 +87,20 @@ public:
 		m_deviceContext(p_deviceContext)
 	{
 		FT_Init_FreeType(&m_library);
-		LoadFonts("data\\fonts.dat");
 	}
-	~Fonts() { FT_Done_FreeType(m_library); }
+	~Fonts()
+	{
+		// The faces belong to the library, so they have to go first.
+		m_fonts.reset();
+		FT_Done_FreeType(m_library);
+	}
+	// Reads and rasterizes every face but makes no textures, so it can run
+	// on a loader thread. Nothing else may use the fonts until it returns.
 	void LoadFonts(const char *);
 	void LoadFont(FT_Byte *, int32_t, int);
+
+	// The D3D half of loading, on the render thread.
+	void CreateTextures();
 	Font * GetFont(int idx) { return &m_fonts[idx]; }
 
 private:
@@ -104,4 +108,5 @@ private:
 	ID3D11DeviceContext * m_deviceContext;
 	FT_Library m_library;
 	std::unique_ptr<Font[]> m_fonts;
+	int m_fontCount = 0;
 };
\ No newline at end of file
@@ -7,13 +7,13 @@
 
 void ShaderClass::Render(int indexCount, const DirectX::XMMATRIX & worldMatrix,
 	const DirectX::XMMATRIX & viewMatrix, const DirectX::XMMATRIX & projectionMatrix, 
-	ID3D11ShaderResourceView* texture, const DirectX::XMVECTORF32 & pixelColor)
+	ID3D11ShaderResourceView* texture, const DirectX::XMVECTORF32 & pixelColor, VertexFormat format, int baseVertex)
 {
 	// Set the shader parameters that it will use for rendering.
 	SetShaderParameters(worldMatrix, viewMatrix, projectionMatrix, texture, pixelColor);
 
 	// Now render the prepared buffers with the shader.
-	RenderShader(indexCount);
+	RenderShader(indexCount, format, baseVertex);
 }
 
 
@@ -29,67 +29,28 @@ void ShaderClass::RenderInstanced(uint32_t indexCount, uint32_t instanceCount, c
 }
 
 
-void ShaderClass::InitializeShader()
+// Draws the shared unit quad bound to slot 0 once per TileInstanceType bound
+// to slot 1, looking the UVs up in atlas.
+void ShaderClass::RenderTiles(uint32_t instanceCount, const DirectX::XMMATRIX & worldMatrix,
+	const DirectX::XMMATRIX & viewMatrix, const DirectX::XMMATRIX & projectionMatrix,
+	ID3D11ShaderResourceView* texture, ID3D11ShaderResourceView* atlas)
 {
-	HRESULT result;
-	Microsoft::WRL::ComPtr<ID3DBlob>
-		errorMessage,
-		vertexShaderBuffer,
-		pixelShaderBuffer;
-	uint32_t flags = D3DCOMPILE_ENABLE_STRICTNESS;
-#if defined( DEBUG ) || defined( _DEBUG )
-	flags |= D3DCOMPILE_DEBUG;
-#endif
-	{
-		// Compile the vertex shader code.
-		std::ifstream infile("VertexShader.hlsl");
-		std::string lines((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
-		result = D3DCompile(lines.c_str(), lines.size(), NULL, NULL, NULL,
-			"TextureVertexShader", "vs_5_0", flags, 0, &vertexShaderBuffer, &errorMessage);
-		if (FAILED(result) && errorMessage)
-		{
-			// Pop a message up on the screen to notify the user to check the text file for compile errors.
-			throw std::runtime_error(
-				FormatString(
-					"Error compiling vertex shader.\n\n%s",
-					(char*)(errorMessage->GetBufferPointer())
-				).data()
-			);
-		}
-	}
-	{
-		auto psentrypoint = m_isFont ? "FontPixelShader" : "TexturePixelShader";
-
-		// Compile the pixel shader code.
-		std::ifstream infile("PixelShader.hlsl");
-		std::string lines((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
-		result = D3DCompile(lines.c_str(), lines.size(), NULL, NULL, NULL,
-			m_psentrypoint, "ps_5_0", flags, 0, &pixelShaderBuffer, &errorMessage);
-		if (FAILED(result) && errorMessage)
-		{
-			// Pop a message up on the screen to notify the user to check the text file for compile errors.
-			throw std::runtime_error(
-				FormatString(
-					"Error compiling pixel shader.\n\n%s",
-					(char*)(errorMessage->GetBufferPointer())
-				).data()
-			);
-		}
-	}
-	// Create the vertex shader from the buffer.
-	ThrowIfFailed(
-		m_device->CreateVertexShader(vertexShaderBuffer->GetBufferPointer(),
-			vertexShaderBuffer->GetBufferSize(), NULL, &m_vertexShader),
-		"Could not create the vertex shader buffer."
-	);
+	SetShaderParameters(worldMatrix, viewMatrix, projectionMatrix, texture, { 1, 1, 1, 1 });
 
-	ThrowIfFailed(
-		m_device->CreatePixelShader(pixelShaderBuffer->GetBufferPointer(),
-			pixelShaderBuffer->GetBufferSize(), NULL, &m_pixelShader),
-		"Could not create the pixel shader buffer."
-	);
+	RenderState::SetInputLayout(m_deviceContext, m_tileLayout.Get());
+	RenderState::SetVertexShader(m_deviceContext, m_tileVertexShader.Get());
+	RenderState::SetVertexShaderResource(m_deviceContext, 0, atlas);
+	RenderState::SetPixelShader(m_deviceContext, m_pixelShader.Get());
+	RenderState::SetPixelSampler(m_deviceContext, 0, m_sampleState.Get());
 
-	// Create the vertex input layout description.
+	m_deviceContext->DrawIndexedInstanced(6, instanceCount, 0, 0, 0);
+}
+
+
+void ShaderClass::InitializeShader()
+{
+	// The vertex shaders and layouts are the same for every instance, so
+	// the library makes them once; the bytecode usually comes from its cache.
 	// This setup needs to match the VertexType stucture in the ModelClass and in the shader.
 	D3D11_INPUT_ELEMENT_DESC polygonLayout[] =
 	{
@@ -101,16 +62,39 @@ void ShaderClass::InitializeShader()
 		//Instance buffer
 		{ "INSTANCEPOS", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
 	};
+	auto vertexStage = ShaderLibrary::GetVertexShader(m_device, "TextureVertexShader",
+		polygonLayout, static_cast<UINT>(std::size(polygonLayout)));
+	m_vertexShader = vertexStage.shader;
+	m_layout = vertexStage.layout;
 
-	// Get a count of the elements in the layout.
-	auto numElements = std::size(polygonLayout);
+	// This one needs to match PackedVertexType.
+	D3D11_INPUT_ELEMENT_DESC packedLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16_SINT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+	auto packedStage = ShaderLibrary::GetVertexShader(m_device, "PackedVertexShader",
+		packedLayout, static_cast<UINT>(std::size(packedLayout)));
+	m_packedVertexShader = packedStage.shader;
+	m_packedLayout = packedStage.layout;
 
-	// Create the vertex input layout.
-	ThrowIfFailed(
-		m_device->CreateInputLayout(polygonLayout, numElements, vertexShaderBuffer->GetBufferPointer(),
-			vertexShaderBuffer->GetBufferSize(), &m_layout),
-		"Could not create the vertex shader layout."
-	);
+	// The unit quad corners in slot 0 and TileInstanceType in slot 1.
+	D3D11_INPUT_ELEMENT_DESC tileLayout[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "INSTANCEPOS", 0, DXGI_FORMAT_R16G16_SINT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "INSTANCESIZE", 0, DXGI_FORMAT_R16G16_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "ATLAS", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+	auto tileStage = ShaderLibrary::GetVertexShader(m_device, "TileVertexShader",
+		tileLayout, static_cast<UINT>(std::size(tileLayout)));
+	m_tileVertexShader = tileStage.shader;
+	m_tileLayout = tileStage.layout;
+
+	auto psentrypoint = *m_psentrypoint ? m_psentrypoint : m_isFont ? "FontPixelShader" : "TexturePixelShader";
+	m_pixelShader = ShaderLibrary::GetPixelShader(m_device, psentrypoint);
 
 	// Setup the description of the dynamic constant buffer that is in the vertex shader.
 	D3D11_BUFFER_DESC constantBufferDesc =
@@ -165,81 +149,59 @@ void ShaderClass::SetShaderParameters(const DirectX::XMMATRIX & worldMatrix,
 	const DirectX::XMMATRIX & viewMatrix, const DirectX::XMMATRIX & projectionMatrix,
 	ID3D11ShaderResourceView* texture, const DirectX::XMVECTORF32 & pixelColor)
 {
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-
-
-	// Lock the constant buffer so it can be written to.
-	ThrowIfFailed(
-		m_deviceContext->Map(m_constantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
-		"Could not lock the vertex constant buffer pointer."
-	);
-
-	// Get a pointer to the data in the constant buffer.
-	auto dataPtr = (ConstantBufferType*)mappedResource.pData;
-
-	// Transpose the matrices to prepare them for the shader.
-	dataPtr->world = DirectX::XMMatrixTranspose(worldMatrix);
-	dataPtr->view = DirectX::XMMatrixTranspose(viewMatrix);
-	dataPtr->projection = DirectX::XMMatrixTranspose(projectionMatrix);
-
-	// Unlock the constant buffer.
-	m_deviceContext->Unmap(m_constantBuffer.Get(), 0);
+	// Transpose the matrices to prepare them for the shader. Text and
+	// batches draw many times with the same ones, so the buffer is only
+	// written when they differ from last time.
+	ConstantBufferType constants;
+	constants.world = DirectX::XMMatrixTranspose(worldMatrix);
+	constants.view = DirectX::XMMatrixTranspose(viewMatrix);
+	constants.projection = DirectX::XMMatrixTranspose(projectionMatrix);
+	RenderState::UpdateConstantBuffer(m_deviceContext, m_constantBuffer.Get(), &constants, sizeof(constants));
 
 	// Now set the constant buffer in the vertex shader with the updated values.
-	m_deviceContext->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+	RenderState::SetVertexConstantBuffer(m_deviceContext, 0, m_constantBuffer.Get());
 
 	// Set shader texture resource in the pixel shader.
-	m_deviceContext->PSSetShaderResources(0, 1, &texture);
-
-	// Lock the pixel constant buffer so it can be written to.
-	ThrowIfFailed(
-		m_deviceContext->Map(m_pixelBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
-		"Could not lock the pixel constant buffer pointer."
-	);
-
-	// Get a pointer to the data in the pixel constant buffer.
-	auto dataPtr2 = (PixelBufferType*)mappedResource.pData;
+	RenderState::SetPixelShaderResource(m_deviceContext, 0, texture);
 
-	// Copy the pixel color into the pixel constant buffer.
-	dataPtr2->pixelColor = static_cast<DirectX::XMFLOAT4>(pixelColor);
-
-	// Unlock the pixel constant buffer.
-	m_deviceContext->Unmap(m_pixelBuffer.Get(), 0);
-
-	// Now set the pixel constant buffer in the pixel shader with the updated value.
-	m_deviceContext->PSSetConstantBuffers(0, 1, m_pixelBuffer.GetAddressOf());
+	// The same for the pixel color.
+	PixelBufferType pixel = { static_cast<DirectX::XMFLOAT4>(pixelColor) };
+	RenderState::UpdateConstantBuffer(m_deviceContext, m_pixelBuffer.Get(), &pixel, sizeof(pixel));
+	RenderState::SetPixelConstantBuffer(m_deviceContext, 0, m_pixelBuffer.Get());
 }
 
 
-void ShaderClass::RenderShader(int indexCount)
+void ShaderClass::RenderShader(int indexCount, VertexFormat format, int baseVertex)
 {
+	bool packed = format == VertexFormat::Packed;
+
 	// Set the vertex input layout.
-	m_deviceContext->IASetInputLayout(m_layout.Get());
+	RenderState::SetInputLayout(m_deviceContext, packed ? m_packedLayout.Get() : m_layout.Get());
 
 	// Set the vertex and pixel shaders that will be used to render the triangles.
-	m_deviceContext->VSSetShader(m_vertexShader.Get(), NULL, 0);
-	m_deviceContext->PSSetShader(m_pixelShader.Get(), NULL, 0);
+	RenderState::SetVertexShader(m_deviceContext, packed ? m_packedVertexShader.Get() : m_vertexShader.Get());
+	RenderState::SetPixelShader(m_deviceContext, m_pixelShader.Get());
 
 	// Set the sampler state in the pixel shader.
-	m_deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+	RenderState::SetPixelSampler(m_deviceContext, 0, m_sampleState.Get());
 
 	// Render the triangles.
-	m_deviceContext->DrawIndexed(indexCount, 0, 0);
+	m_deviceContext->DrawIndexed(indexCount, 0, baseVertex);
 }
 
 
 void ShaderClass::RenderShaderInstanced(uint32_t indexCount, uint32_t instanceCount)
 {
 	// Set the vertex input layout.
-	m_deviceContext->IASetInputLayout(m_layout.Get());
+	RenderState::SetInputLayout(m_deviceContext, m_layout.Get());
 
 	// Set the vertex and pixel shaders that will be used to render the triangles.
-	m_deviceContext->VSSetShader(m_vertexShader.Get(), NULL, 0);
-	m_deviceContext->PSSetShader(m_pixelShader.Get(), NULL, 0);
+	RenderState::SetVertexShader(m_deviceContext, m_vertexShader.Get());
+	RenderState::SetPixelShader(m_deviceContext, m_pixelShader.Get());
 
 	// Set the sampler state in the pixel shader.
-	m_deviceContext->PSSetSamplers(0, 1, &m_sampleState);
+	RenderState::SetPixelSampler(m_deviceContext, 0, m_sampleState.Get());
 
 	// Render the triangles.
 	m_deviceContext->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
-}
\ No newline at end of file
+}
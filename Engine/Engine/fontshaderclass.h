@@ -10,7 +10,6 @@
 //////////////
 #include <DirectXMath.h>
 #include <d3d11.h>
-#include <d3dcompiler.h>
 #include <fstream>
 #include <string>
 #include <iterator>
@@ -21,30 +20,9 @@
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "game.h"
-
-
-#pragma comment(lib, "d3dcompiler.lib")
-
-
-struct VertexType
-{
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT2 texture;
-};
-
-
-struct VertexColorType
-{
-	DirectX::XMFLOAT3 position;
-	DirectX::XMFLOAT2 texture;
-	DirectX::XMFLOAT4 color;
-};
-
-
-struct InstanceType
-{
-	DirectX::XMFLOAT3 position;
-};
+#include "renderstate.h"
+#include "shaderlibrary.h"
+#include "vertextypes.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -84,23 +62,24 @@ public:
 		InitializeShader();
 	}
 
-	void Render(int, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, ID3D11ShaderResourceView *, const DirectX::XMVECTORF32 &);
+	void Render(int, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, ID3D11ShaderResourceView *, const DirectX::XMVECTORF32 &, VertexFormat = VertexFormat::Full, int = 0);
 	void RenderInstanced(uint32_t, uint32_t, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, ID3D11ShaderResourceView *, const DirectX::XMVECTORF32 &);
+	void RenderTiles(uint32_t, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, ID3D11ShaderResourceView *, ID3D11ShaderResourceView *);
 
 private:
 	void InitializeShader();
 	void SetShaderParameters(const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, ID3D11ShaderResourceView *, const DirectX::XMVECTORF32 &);
-	void RenderShader(int);
+	void RenderShader(int, VertexFormat, int);
 	void RenderShaderInstanced(uint32_t, uint32_t);
 
 private:
 	ID3D11Device * m_device;
 	ID3D11DeviceContext* m_deviceContext;
-	bool m_isFont;
+	bool m_isFont = false;
 	const char * m_psentrypoint = "";
-	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader, m_packedVertexShader, m_tileVertexShader;
 	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
-	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout;
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> m_layout, m_packedLayout, m_tileLayout;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_constantBuffer;
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_sampleState;
 	Microsoft::WRL::ComPtr<ID3D11Buffer> m_pixelBuffer;
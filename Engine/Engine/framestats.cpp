@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: framestats.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "framestats.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+
+
+static double ToMilliseconds(FrameStats::Duration time)
+{
+	return std::chrono::duration<double, std::milli>(time).count();
+}
+
+
+FrameStats::FrameStats(Duration budget, size_t windowFrames, size_t maxSeconds)
+	:
+	m_budget(budget),
+	m_frames(windowFrames),
+	m_seconds(maxSeconds)
+{
+	if (windowFrames == 0 || maxSeconds == 0)
+		throw std::invalid_argument("Frame stats need room for at least one frame and one second");
+}
+
+
+size_t FrameStats::BucketOf(Duration time)
+{
+	double bucket = ToMilliseconds(time) / BucketMilliseconds;
+	return bucket < BucketCount - 1 ? static_cast<size_t>(std::max(bucket, 0.0)) : BucketCount - 1;
+}
+
+
+void FrameStats::Histogram::Add(Duration time, bool isHitch)
+{
+	counts[BucketOf(time)]++;
+	frames++;
+	hitches += isHitch;
+	total += time;
+	max = std::max(max, time);
+}
+
+
+void FrameStats::Histogram::Remove(Duration time, bool isHitch)
+{
+	counts[BucketOf(time)]--;
+	frames--;
+	hitches -= isHitch;
+	total -= time;
+}
+
+
+FrameStats::Summary FrameStats::Histogram::Summarize() const
+{
+	Summary summary;
+	summary.frames = frames;
+	summary.hitches = hitches;
+	if (frames == 0)
+		return summary;
+	summary.mean = ToMilliseconds(total) / frames;
+	summary.max = ToMilliseconds(max);
+
+	// Where each rank falls, read off as the top of its bucket.
+	const double percentiles[] = { 0.50, 0.95, 0.99 };
+	double * results[] = { &summary.p50, &summary.p95, &summary.p99 };
+	size_t seen = 0, next = 0;
+	for (size_t bucket = 0; bucket < BucketCount && next < 3; bucket++)
+	{
+		seen += counts[bucket];
+		while (next < 3 && seen >= static_cast<size_t>(std::ceil(percentiles[next] * frames)))
+		{
+			double top = bucket == BucketCount - 1 ? summary.max : (bucket + 1) * BucketMilliseconds;
+			*results[next++] = std::min(top, summary.max);
+		}
+	}
+	return summary;
+}
+
+
+bool FrameStats::AddFrame(Duration time)
+{
+	bool isHitch = time > m_budget;
+
+	// Once the window is full each frame takes the place of the oldest.
+	Frame oldest = m_frames[m_nextFrame];
+	m_frames[m_nextFrame] = { time, isHitch };
+	m_nextFrame = (m_nextFrame + 1) % m_frames.size();
+	if (m_frameCount < m_frames.size())
+		m_frameCount++;
+	else
+	{
+		m_window.Remove(oldest.time, oldest.isHitch);
+
+		// Only when the slowest frame goes does the rest need a look.
+		if (oldest.time == m_window.max)
+		{
+			m_window.max = Duration::zero();
+			for (const auto & frame : m_frames)
+				m_window.max = std::max(m_window.max, frame.time);
+		}
+	}
+	m_window.Add(time, isHitch);
+
+	// A second is over with the frame that takes it past one.
+	m_second.Add(time, isHitch);
+	if (m_second.total >= std::chrono::seconds(1))
+	{
+		m_seconds[m_nextSecond] = { m_secondIndex++, m_second.Summarize() };
+		m_nextSecond = (m_nextSecond + 1) % m_seconds.size();
+		m_secondCount = std::min(m_secondCount + 1, m_seconds.size());
+		m_second = Histogram();
+	}
+	return isHitch;
+}
+
+
+FrameStats::Summary FrameStats::GetWindow() const
+{
+	return m_window.Summarize();
+}
+
+
+const FrameStats::Second & FrameStats::GetSecond(size_t i) const
+{
+	size_t oldest = m_secondCount < m_seconds.size() ? 0 : m_nextSecond;
+	return m_seconds[(oldest + i) % m_seconds.size()];
+}
+
+
+void FrameStats::WriteCsv(std::ostream & stream) const
+{
+	stream << "second,frames,hitches,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+	char line[160];
+	for (size_t i = 0; i < m_secondCount; i++)
+	{
+		const Second & second = GetSecond(i);
+		const Summary & s = second.summary;
+		std::snprintf(line, sizeof(line), "%llu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+			static_cast<unsigned long long>(second.index), s.frames, s.hitches, s.mean, s.p50, s.p95, s.p99, s.max);
+		stream << line;
+	}
+}
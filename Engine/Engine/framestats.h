@@ -0,0 +1,109 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: framestats.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: FrameStats
+//
+// Keeps how long the last few hundred frames took in a histogram, for the
+// percentiles a single average hides, and flags every frame over budget as
+// a hitch. Each second of frames is also summed up on its own, into a
+// series that can be written out as CSV.
+//
+// Seconds are counted in frame time rather than read off a clock, so
+// feeding it made up frames gives the same result every time. Memory is
+// all set aside up front; adding a frame never allocates.
+////////////////////////////////////////////////////////////////////////////////
+class FrameStats
+{
+public:
+	using Duration = std::chrono::steady_clock::duration;
+
+	// Times in milliseconds. Percentiles are as fine as the histogram's
+	// buckets, and never above the slowest frame.
+	struct Summary
+	{
+		size_t frames = 0;
+		size_t hitches = 0;
+		double mean = 0.0;
+		double p50 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	struct Second
+	{
+		uint64_t index;
+		Summary summary;
+	};
+
+	explicit FrameStats(Duration budget = std::chrono::microseconds(16667), size_t windowFrames = 600,
+		size_t maxSeconds = 3600);
+
+	// Whether the frame was a hitch.
+	bool AddFrame(Duration);
+
+	void SetBudget(Duration budget) { m_budget = budget; }
+	Duration GetBudget() const { return m_budget; }
+
+	// Over the last windowFrames frames.
+	Summary GetWindow() const;
+
+	// The most recent maxSeconds whole seconds, oldest first.
+	size_t GetSecondCount() const { return m_secondCount; }
+	const Second & GetSecond(size_t) const;
+
+	void WriteCsv(std::ostream &) const;
+
+private:
+	// A tenth of a millisecond each, up to a fifth of a second; slower
+	// frames all go in the last one.
+	static const size_t BucketCount = 2000;
+	static constexpr double BucketMilliseconds = 0.1;
+
+	struct Histogram
+	{
+		std::array<uint32_t, BucketCount> counts{};
+		size_t frames = 0, hitches = 0;
+		Duration total{}, max{};
+
+		void Add(Duration, bool isHitch);
+		void Remove(Duration, bool isHitch);
+		Summary Summarize() const;
+	};
+
+	struct Frame
+	{
+		Duration time;
+		bool isHitch;
+	};
+
+	static size_t BucketOf(Duration);
+
+	Duration m_budget;
+
+	// The window's frames, oldest overwritten first.
+	Histogram m_window;
+	std::vector<Frame> m_frames;
+	size_t m_nextFrame = 0, m_frameCount = 0;
+
+	// The second being filled, and the ones before it.
+	Histogram m_second;
+	uint64_t m_secondIndex = 0;
+	std::vector<Second> m_seconds;
+	size_t m_nextSecond = 0, m_secondCount = 0;
+};
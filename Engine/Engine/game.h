@@ -8,8 +8,20 @@
 #include <algorithm> 
 #include <memory> 
 #include <vector> 
-#include <Windows.h>
-#include <DirectXColors.h>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "platform.h"
+
+
+// In savefile.h, which needs BinaryWriter from here.
+class SaveFile;
 
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -41,7 +53,7 @@ public:
 	T Get()
 	{
 		T buf;
-		io.read(reinterpret_cast<char *>(&buf), sizeof T);
+		io.read(reinterpret_cast<char *>(&buf), sizeof(T));
 		return buf;
 	}
 };
@@ -67,11 +79,63 @@ public:
 		io.write(str.c_str(), len);
 	}
 
+	void Write(const void *p, size_t size)
+	{
+		io.write(reinterpret_cast<const char *>(p), size);
+	}
+
 	template<typename T>
 	void Write(T buf)
 	{
-		io.write(reinterpret_cast<char *>(&buf), sizeof T);
+		io.write(reinterpret_cast<char *>(&buf), sizeof(T));
+	}
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+// MemoryReader
+//
+// BinaryReader over bytes already in memory, such as a MappedFile. Reading
+// past the end throws std::out_of_range rather than returning garbage.
+///////////////////////////////////////////////////////////////////////////////
+class MemoryReader
+{
+	const std::byte *data;
+	size_t size, position = 0;
+
+public:
+	MemoryReader(const std::byte *data, size_t size)
+		:
+		data(data),
+		size(size)
+	{}
+
+	// Points into the buffer rather than copying.
+	const std::byte *Read(size_t count)
+	{
+		if (count > size - position)
+			throw std::out_of_range("Read past the end of the buffer");
+		const std::byte *p = data + position;
+		position += count;
+		return p;
+	}
+
+	void Read(void *p, size_t count)
+	{
+		const std::byte *source = Read(count);
+		if (count > 0)
+			std::memcpy(p, source, count);
+	}
+
+	template<typename T>
+	T Get()
+	{
+		T buf;
+		Read(&buf, sizeof(T));
+		return buf;
 	}
+
+	size_t GetRemaining() const { return size - position; }
 };
 
 
@@ -84,6 +148,12 @@ public:
 	virtual ~IGameObject() {}
 	virtual void Shutdown() {}
 	virtual void Frame() = 0;
+
+	// Advances the simulation one fixed step. Frame is called once per
+	// drawn frame instead, however many ticks came before it, and then
+	// Interpolate with how far the frame is from the last tick to the next.
+	virtual void Tick(float /*seconds*/) {}
+	virtual void Interpolate(float /*alpha*/) {}
 	virtual void Render(
 		const DirectX::XMMATRIX &,
 		const DirectX::XMMATRIX &,
@@ -93,6 +163,11 @@ public:
 		const DirectX::XMMATRIX &) {}
 	virtual void Save(BinaryWriter &) {}
 	virtual void Load(BinaryReader &) {}
+
+	// Objects with a lot of state keep it in chunks of their own instead,
+	// and only hand over the ones that changed.
+	virtual void Save(SaveFile &) {}
+	virtual void Load(const SaveFile &) {}
 	virtual void OnClick(const std::vector<bool>, POINT) {}
 };
 
@@ -110,6 +185,12 @@ public:
 	int drillCost = 10000;
 	int MaintenanceRate = 30;
 	int MaintCooldown = 30;
+
+	// Frames a second to draw at most, or 0 for as many as vsync allows.
+	int maxFrameRate = 0;
+
+	// Milliseconds a frame may take before it counts as a hitch.
+	float frameBudget = 1000.0f / 60.0f;
 	GameMode gameMode = GameMode::normal;
 };
 
@@ -168,7 +249,8 @@ namespace Geometry
 	struct ColoredRect
 	{
 		RECT rect;
-		DirectX::XMFLOAT4 color;
+		// Tiles are built from a bare Rectangle and never set a colour.
+		DirectX::XMFLOAT4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
 		bool hidden = false;
 
 		ColoredRect(Rectangle<T> rect)
@@ -201,6 +283,7 @@ namespace Geometry
 	};
 };
 
+#ifdef _WIN32
 // Helper class for COM exceptions
 class com_exception : public std::runtime_error
 {
@@ -263,6 +346,7 @@ inline void ThrowIfFailed(const HRESULT hr, const char * msg)
 	if (FAILED(hr))
 		throw com_exception(hr, msg);
 }
+#endif
 
 // snprintf with automatic string size measurement.
 template<typename... Args>
@@ -308,13 +392,12 @@ namespace Colors
 
 	inline DirectX::XMFLOAT4 Lerp(const DirectX::XMFLOAT4 & c1, const DirectX::XMFLOAT4 & c2, float t)
 	{
-		using namespace DirectX;
-		XMVECTOR C0 = XMLoadFloat4(&c1);
-		XMVECTOR C1 = XMLoadFloat4(&c2);
-
-		DirectX::XMFLOAT4 result;
-		XMStoreFloat4(&result, XMVectorLerp(C0, C1, t));
-		return result;
+		return {
+			c1.x + t * (c2.x - c1.x),
+			c1.y + t * (c2.y - c1.y),
+			c1.z + t * (c2.z - c1.z),
+			c1.w + t * (c2.w - c1.w)
+		};
 	}
 	// Standard colors (Red/Green/Blue/Alpha)
 	XMGLOBALCONST DirectX::XMFLOAT4 AliceBlue = { 0.941176534f, 0.972549081f, 1.000000000f, 1.000000000f };
@@ -4,10 +4,16 @@
 #include "graphicsclass.h"
 
 
+// Of each frame spent making GPU resources for loaded assets, so the
+// progress bar keeps moving.
+static const std::chrono::milliseconds LoadBudget(8);
+
+
 GraphicsClass::GraphicsClass(CameraClass * p_Camera,
 	size_t screenWidth, size_t screenHeight, size_t scale, HWND p_hwnd,
 	Settings * p_settings)
 	:
+	m_startTime(std::chrono::steady_clock::now()),
 	m_Camera(p_Camera),
 	m_screenWidth(screenWidth),
 	m_screenHeight(screenHeight),
@@ -21,52 +27,134 @@ GraphicsClass::GraphicsClass(CameraClass * p_Camera,
 	m_Font(m_D3D.GetDevice(), m_D3D.GetDeviceContext()),
 	m_Shader(m_D3D.GetDevice(), m_D3D.GetDeviceContext(), "TexturePixelShader"),
 	m_Shader2(m_D3D.GetDevice(), m_D3D.GetDeviceContext(), "HSV2RGBPixelShader"),
-	tiles(
-		m_D3D.GetDevice(), m_D3D.GetDeviceContext(), &m_Shader,
-		p_Camera, p_settings,
-		screenWidth, screenHeight,55,55,50,6,8,8,1// width, height, chanceToStartAlive, smoothingIterations,
-		//octaves, freq, seed
-	),
-	m_Bitmap(
-		m_D3D.GetDevice(), m_D3D.GetDeviceContext(),
-		screenWidth, screenHeight, "../Engine/data/seafloor.dds"
-	),
 	m_FontShader(m_D3D.GetDevice(), m_D3D.GetDeviceContext(), "RGBPixelShader"),
 	m_Bitmap2(
 		m_D3D.GetDevice(), m_D3D.GetDeviceContext(), &m_Shader2,
 		screenWidth, screenHeight
 	),
-	m_Text(
-		m_D3D.GetDevice(), m_D3D.GetDeviceContext(), &m_FontShader,
-		screenWidth, screenHeight, &m_Font, m_Camera->GetViewMatrix()
-	)
+	m_Progress(m_D3D.GetDevice(), m_D3D.GetDeviceContext(), screenWidth, screenHeight)
 {
 	m_D3D.GetWorldMatrix(worldMatrix);
 	m_D3D.GetProjectionMatrix(projectionMatrix);
 	m_D3D.GetOrthoMatrix(orthoMatrix);
 	m_Camera->ResizeBuffers(screenWidth, screenHeight, worldMatrix, orthoMatrix);
 	baseviewMatrix = m_Camera->GetViewMatrix();
-	m_gameObjects.push_back(&tiles);
-	m_gameObjects.push_back(&m_Text);
 	m_Bitmap2.MakeChart({ 8,8 }, std::vector<float>({ 0.2f, 0.3f, 0.4f, 0.1f }));
+
+	// Files are read, decoded and rasterized on the loader's threads. What
+	// needs the device is done in Frame, a few at a time.
+	m_loader.Load(
+		[this]() { m_Font.LoadFonts("data\\fonts.dat"); },
+		[this]() {
+			m_Font.CreateTextures();
+			m_Text = std::make_unique<TextClass>(
+				m_D3D.GetDevice(), m_D3D.GetDeviceContext(), &m_FontShader,
+				m_screenWidth, m_screenHeight, &m_Font, m_Camera->GetViewMatrix()
+			);
+		}
+	);
+	m_loader.Load(
+		[]() { return DDSFile("../Engine/data/seafloor.dds"); },
+		[this](DDSFile texture) {
+			m_Bitmap = std::make_unique<BitmapClass>(
+				m_D3D.GetDevice(), m_D3D.GetDeviceContext(),
+				m_screenWidth, m_screenHeight, texture
+			);
+		}
+	);
+	m_loader.Load(
+		[]() { return DDSFile("data/sprite.dds"); },
+		[this, p_settings](DDSFile sprites) {
+			tiles = std::make_unique<Tiles>(
+				m_D3D.GetDevice(), m_D3D.GetDeviceContext(), sprites, &m_Shader,
+				m_Camera, p_settings,
+				m_screenWidth, m_screenHeight, 55, 55
+			);
+		}
+	);
+}
+
+
+GraphicsClass::~GraphicsClass()
+{
+	// Everything else lets go of the shared buffers as it is destroyed, but
+	// the caches have to be told before the device goes.
+	QuadIndexBuffer::Release();
+	ShaderLibrary::Release();
 }
 
 
 void GraphicsClass::SetPausedState(bool isGamePaused)
 {
-	m_Text.SetPausedState(isGamePaused);
+	if (m_Text)
+		m_Text->SetPausedState(isGamePaused);
 }
 
 
 void GraphicsClass::Frame()
 {
+	if (!m_isLoaded)
+	{
+		RenderLoading();
+		return;
+	}
+
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Frame();
+
 	BeforeRender();
 	Render();
 	AfterRender();
+	RenderStats::EndFrame();
+
+	if (!m_hasPresented)
+	{
+		m_hasPresented = true;
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_startTime;
+		std::clog << FormatString("First frame after %.1f ms", elapsed.count()).data() << std::endl;
+	}
+}
+
+
+void GraphicsClass::RenderLoading()
+{
+	m_loader.Pump(LoadBudget);
+	if (m_loader.IsIdle())
+		FinishLoading();
+
+	RenderState::Invalidate();
+
+	m_D3D.BeginScene(DirectX::Colors::Black);
+	m_D3D.TurnZBufferOff();
+
+	LONG
+		width = static_cast<LONG>(m_screenWidth / 2),
+		height = ui::ScaleX(8),
+		left = static_cast<LONG>(m_screenWidth) / 4,
+		top = (static_cast<LONG>(m_screenHeight) - height) / 2;
+	LONG done = static_cast<LONG>(width * m_loader.GetProgress());
+	m_Progress.Render({ left, top, left + std::max(done, 1L), top + height });
+	m_Shader.Render(m_Progress.GetIndexCount(),
+		worldMatrix, baseviewMatrix, orthoMatrix, m_Progress.GetTexture(), {});
+
+	m_D3D.TurnZBufferOn();
+	m_D3D.EndScene();
+}
+
+
+void GraphicsClass::FinishLoading()
+{
+	m_gameObjects.push_back(tiles.get());
+	m_gameObjects.push_back(m_Text.get());
+	m_isLoaded = true;
 }
 
 void GraphicsClass::BeforeRender()
 {
+	// Nothing bound last frame is trusted: render targets are about to
+	// change, which can unbind shader resources behind the cache's back.
+	RenderState::Invalidate();
+
 	if (m_scale > 1)
 	{
 		m_RenderTexture.SetRenderTarget();
@@ -81,13 +169,16 @@ void GraphicsClass::BeforeRender()
 
 void GraphicsClass::AfterRender()
 {
+	PROFILE_SCOPE("GraphicsClass::AfterRender");
+
 	if (m_scale > 1)
 	{
 		m_D3D.SetBackBufferRenderTarget();
+		RenderState::Invalidate();
 		m_D3D.BeginScene(DirectX::Colors::Black);
 		m_D3D.SetViewport(m_screenWidth, m_screenHeight);
-		m_Bitmap.Render({ 0, 0, (LONG)m_screenWidth, (LONG)m_screenHeight });
-		m_Shader.Render(m_Bitmap.GetIndexCount(),
+		m_Bitmap->Render({ 0, 0, (LONG)m_screenWidth, (LONG)m_screenHeight });
+		m_Shader.Render(m_Bitmap->GetIndexCount(),
 			worldMatrix, baseviewMatrix, orthoMatrix, m_RenderTexture.GetShaderResourceView(), {});
 	}
 	m_D3D.TurnZBufferOn();
@@ -98,6 +189,8 @@ void GraphicsClass::AfterRender()
 
 void GraphicsClass::Render()
 {
+	PROFILE_SCOPE("GraphicsClass::Render");
+
 	// Generate the view matrix based on the camera's position.
 	m_Camera->Render();
 
@@ -124,10 +217,26 @@ void GraphicsClass::ResizeBuffers(int width, int height)
 	m_D3D.GetProjectionMatrix(projectionMatrix);
 	m_D3D.GetOrthoMatrix(orthoMatrix);
 	m_Camera->ResizeBuffers(width, height, worldMatrix, projectionMatrix);
-	m_Bitmap.ResizeBuffers(width, height);
-	m_Text.ResizeBuffers(width, height);
+	m_Progress.ResizeBuffers(width, height);
+	if (m_isLoaded)
+	{
+		m_Bitmap->ResizeBuffers(width, height);
+		m_Text->ResizeBuffers(width, height);
+	}
+}
+
+
+void GraphicsClass::Tick(float seconds)
+{
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Tick(seconds);
 }
 
+void GraphicsClass::Interpolate(float alpha)
+{
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Interpolate(alpha);
+}
 
 void GraphicsClass::Save(BinaryWriter & writer)
 {
@@ -141,6 +250,18 @@ void GraphicsClass::Load(BinaryReader & reader)
 		gameObject->Load(reader);
 }
 
+void GraphicsClass::Save(SaveFile & file)
+{
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Save(file);
+}
+
+void GraphicsClass::Load(const SaveFile & file)
+{
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Load(file);
+}
+
 void GraphicsClass::Click(const std::vector<bool> keys, POINT point)
 {
 	for (const auto & gameObject : m_gameObjects)
@@ -8,6 +8,9 @@
 ///////////////////////
 // INCLUDES //
 ///////////////////////
+#include <chrono>
+#include <iostream>
+#include <memory>
 
 
 ///////////////////////
@@ -22,6 +25,7 @@
 #include "cpuclass.h"
 #include "tiles.h"
 #include "LargeBitmap.h"
+#include "assetloader.h"
 
 
 /////////////
@@ -40,18 +44,32 @@ class GraphicsClass : public IGameObject
 {
 public:
 	GraphicsClass(CameraClass *, size_t, size_t, size_t, HWND, Settings *);
+	~GraphicsClass();
 	void SetPausedState(bool);
+
+	// Assets load in the background; until then Frame draws a progress bar
+	// and GetText returns nullptr.
+	bool IsLoaded() const { return m_isLoaded; }
 	void Frame();
+	void Tick(float);
+	void Interpolate(float);
 	void BeforeRender();
 	void AfterRender();
 	void Render();
 	void ResizeBuffers(int, int);
 	void Save(BinaryWriter &);
 	void Load(BinaryReader &);
+	void Save(SaveFile &);
+	void Load(const SaveFile &);
 	void Click(const std::vector<bool>, POINT);
-	auto GetText() { return &m_Text; }
+	auto GetText() { return m_Text.get(); }
 
 private:
+	void RenderLoading();
+	void FinishLoading();
+
+	// First, so time to first frame counts setting up the device too.
+	std::chrono::steady_clock::time_point m_startTime;
 	D3DClass m_D3D;
 	RenderTextureClass m_RenderTexture;
 	Fonts m_Font;
@@ -60,13 +78,18 @@ private:
 	ShaderClass m_Shader;
 	ShaderClass m_Shader2;
 	ShaderClass m_FontShader;
-	BitmapClass m_Bitmap;
+	std::unique_ptr<BitmapClass> m_Bitmap;
 	PieChart m_Bitmap2;
-	TextClass m_Text;
-	Tiles tiles;
+	BitmapClass m_Progress;
+	std::unique_ptr<TextClass> m_Text;
+	std::unique_ptr<Tiles> tiles;
 	DirectX::XMMATRIX worldMatrix, baseviewMatrix, viewMatrix, projectionMatrix, orthoMatrix;
 	std::vector<IGameObject *> m_gameObjects;
 	size_t m_screenWidth, m_screenHeight, m_scale;
+	bool m_isLoaded = false, m_hasPresented = false;
+
+	// Last, so its workers are stopped before anything they write to goes.
+	AssetLoader m_loader;
 };
 
 #endif
\ No newline at end of file
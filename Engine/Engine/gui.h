@@ -93,7 +93,7 @@
 		DirectX::XMFLOAT4 color = Colors::White;
 		DirectX::XMFLOAT4 hoverColor = Colors::Wheat;
 		std::vector<Geometry::Rectangle<int>> rc;
-		std::vector<std::tuple<const char *, float, float>> txtPos;
+		std::vector<std::tuple<const char *, float, float, float>> txtPos;
 		int selectedIndex = INT16_MAX, totalItemHeight = 0;
 		int scrollbarHeight;
 		float scrollTop;
@@ -117,14 +117,18 @@
 		auto UpdateItems(std::vector<const char *> items, Font * font)
 		{
 			int scrollbarWidth = ui::ScaleX(18);
+
+			// Long items wrap inside the row, which grows to fit them.
+			float padding = 10.0f, wrapWidth = rect.Width - scrollbarWidth - 2 * padding;
+			int lineHeight = font->MeasureString("").y;
 			for (size_t i = 0u; i < items.size(); i++)
 			{
-				auto size = font->MeasureString(items[i]);
-				int itemHeight = size.y + size.y / 2;
+				auto size = font->MeasureString(items[i], wrapWidth);
+				int itemHeight = size.y + lineHeight / 2;
 				rc.emplace_back(rect.left, rect.Top + totalItemHeight, rect.Width - scrollbarWidth, itemHeight);
 				totalItemHeight += itemHeight;
 				float y1 = rc[i].Top + ((rc[i].Height - size.y) / 2.0f);
-				txtPos.emplace_back(std::make_tuple(items[i], rc[i].left + 10.0f, y1));
+				txtPos.emplace_back(std::make_tuple(items[i], rc[i].left + padding, y1, wrapWidth));
 			}
 			for (size_t i = 0u; i < items.size(); i++)
 			{
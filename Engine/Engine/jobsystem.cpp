@@ -0,0 +1,174 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: jobsystem.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "jobsystem.h"
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "profiler.h"
+
+
+// Which system's worker, if any, the current thread is, and its queue.
+static thread_local const JobSystem * t_system = nullptr;
+static thread_local size_t t_worker = 0;
+
+
+JobSystem::JobSystem(unsigned workerCount)
+	:
+	m_workerCount(workerCount)
+{
+	for (unsigned i = 0; i <= workerCount; i++)
+		m_queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i < workerCount; i++)
+		m_threads.emplace_back(&JobSystem::WorkerLoop, this, i);
+}
+
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	for (auto & thread : m_threads)
+		thread.join();
+
+	// Without workers nothing else would run these.
+	while (TryRunOne())
+		;
+}
+
+
+JobSystem & JobSystem::Get()
+{
+	static JobSystem system(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+	return system;
+}
+
+
+void JobSystem::Run(Counter & counter, std::function<void()> job)
+{
+	counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+	Queue & queue = t_system == this ? *m_queues[t_worker] : *m_queues.back();
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back({ std::move(job), &counter, AllocationTracker::GetCurrent() });
+	}
+	m_queued++;
+
+	// Taking the lock means a worker about to sleep either sees the job or
+	// is already waiting for this.
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+	}
+	m_wake.notify_one();
+}
+
+
+void JobSystem::Wait(Counter & counter)
+{
+	while (!counter.IsDone())
+	{
+		if (!TryRunOne())
+			std::this_thread::yield();
+	}
+
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_errorMutex);
+		std::swap(error, counter.m_error);
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+
+// A worker's own newest job first, as its data is most likely still in the
+// cache, then the oldest shared one, then the oldest of another worker.
+bool JobSystem::TryRunOne()
+{
+	size_t workers = m_workerCount, self = t_system == this ? t_worker : workers;
+	Job job;
+	bool found = false;
+
+	auto take = [&](size_t index, bool isNewest) {
+		Queue & queue = *m_queues[index];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty())
+			return false;
+		if (isNewest)
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+		}
+		else
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+		}
+		return true;
+	};
+
+	if (self < workers)
+		found = take(self, true);
+	if (!found)
+		found = take(workers, false);
+	for (size_t i = 1; i <= workers && !found; i++)
+	{
+		size_t victim = (self + i) % (workers + 1);
+		if (victim != workers && take(victim, false))
+		{
+			found = true;
+			m_steals++;
+		}
+	}
+	if (!found)
+		return false;
+
+	m_queued--;
+	Execute(job);
+	return true;
+}
+
+
+void JobSystem::Execute(Job & job)
+{
+	Counter * counter = job.counter;
+	try
+	{
+		PROFILE_SCOPE("Job");
+		AllocationTracker::Scope allocations(job.subsystem);
+		job.work();
+	}
+	catch (...)
+	{
+		std::lock_guard<std::mutex> lock(counter->m_errorMutex);
+		if (!counter->m_error)
+			counter->m_error = std::current_exception();
+	}
+
+	// Whoever waits may destroy the counter as soon as this lands.
+	job.work = nullptr;
+	counter->m_pending.fetch_sub(1, std::memory_order_release);
+}
+
+
+void JobSystem::WorkerLoop(size_t index)
+{
+	t_system = this;
+	t_worker = index;
+	Profiler::SetThreadName("Job worker " + std::to_string(index));
+	for (;;)
+	{
+		if (TryRunOne())
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_wake.wait(lock, [this]() { return m_stopping || m_queued > 0; });
+		if (m_stopping && m_queued == 0)
+			return;
+	}
+}
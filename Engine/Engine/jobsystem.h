@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: jobsystem.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "alloctracker.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: JobSystem
+//
+// Runs short jobs on a fixed set of worker threads. Each worker has its own
+// deque: jobs it spawns go on the back and it takes them from there, while
+// idle workers steal the oldest ones from the front of someone else's.
+// Jobs from other threads go into one shared queue that every worker
+// drains. A thread waiting on a Counter runs jobs itself until it is done,
+// so waiting never blocks a worker and a system without workers still
+// gets everything done, just on the waiting thread.
+//
+// AssetLoader is for long loads that must not hold up a frame; this is for
+// splitting one piece of work up and waiting for it.
+////////////////////////////////////////////////////////////////////////////////
+class JobSystem
+{
+public:
+	// How many jobs are left of those run against it. A job that runs more
+	// against the same counter before it ends makes them its children: the
+	// counter is only done once they are too.
+	class Counter
+	{
+	public:
+		Counter() = default;
+		Counter(const Counter &) = delete;
+		Counter & operator=(const Counter &) = delete;
+
+		bool IsDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<size_t> m_pending = 0;
+		std::mutex m_errorMutex;
+		std::exception_ptr m_error;
+	};
+
+	explicit JobSystem(unsigned workerCount);
+
+	// Runs everything still queued, then stops the workers.
+	~JobSystem();
+	JobSystem(const JobSystem &) = delete;
+	JobSystem & operator=(const JobSystem &) = delete;
+
+	// One worker per core but the one calling, which helps while it waits.
+	static JobSystem & Get();
+
+	void Run(Counter &, std::function<void()> job);
+
+	// Runs jobs until the counter is done, then throws the first exception
+	// any of its jobs threw. Can be called from a job.
+	void Wait(Counter &);
+
+	// Calls body(first, last) for consecutive ranges of at most grain
+	// indices covering [begin, end), in parallel, and waits for them. The
+	// calling thread takes the first range; a range no bigger than grain
+	// is done right there without any jobs.
+	template<typename Body>
+	void ParallelFor(size_t begin, size_t end, size_t grain, const Body & body);
+
+	unsigned GetWorkerCount() const { return static_cast<unsigned>(m_workerCount); }
+
+	// Jobs taken from another worker's deque.
+	size_t GetStealCount() const { return m_steals; }
+
+private:
+	// Jobs count what they allocate against whatever the thread that ran
+	// them was counting against.
+	struct Job
+	{
+		std::function<void()> work;
+		Counter * counter;
+		AllocationTracker::Subsystem subsystem;
+	};
+
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	bool TryRunOne();
+	void Execute(Job &);
+	void WorkerLoop(size_t index);
+
+	// Fixed before the workers start, as they read it while m_threads fills.
+	size_t m_workerCount;
+
+	// One per worker, then the shared one.
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	std::atomic<size_t> m_queued = 0, m_steals = 0;
+	bool m_stopping = false;
+};
+
+
+template<typename Body>
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grain, const Body & body)
+{
+	grain = std::max<size_t>(grain, 1);
+	if (end <= begin)
+		return;
+	if (end - begin <= grain)
+	{
+		body(begin, end);
+		return;
+	}
+
+	Counter counter;
+	for (size_t first = begin + grain; first < end; first += grain)
+	{
+		size_t last = first + std::min(grain, end - first);
+		Run(counter, [&body, first, last]() { body(first, last); });
+	}
+
+	// The jobs hold on to body, so they have to be waited for even if the
+	// caller's own range throws.
+	std::exception_ptr error;
+	try
+	{
+		body(begin, begin + grain);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	try
+	{
+		Wait(counter);
+	}
+	catch (...)
+	{
+		if (!error)
+			error = std::current_exception();
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: mappedfile.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "mappedfile.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+
+
+MappedFile::MappedFile(const char * path)
+{
+	if (!Open(path))
+		throw std::runtime_error(FormatString("Could not map %s", path).data());
+}
+
+
+MappedFile::MappedFile(MappedFile && other) noexcept
+{
+	Swap(other);
+}
+
+
+MappedFile & MappedFile::operator=(MappedFile && other) noexcept
+{
+	if (this != &other)
+	{
+		Close();
+		Swap(other);
+	}
+	return *this;
+}
+
+
+void MappedFile::Swap(MappedFile & other) noexcept
+{
+	std::swap(m_data, other.m_data);
+	std::swap(m_size, other.m_size);
+	std::swap(m_isOpen, other.m_isOpen);
+#ifdef _WIN32
+	std::swap(m_file, other.m_file);
+	std::swap(m_mapping, other.m_mapping);
+#endif
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char * path)
+{
+	Close();
+
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	LARGE_INTEGER size;
+	if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+	{
+		Close();
+		return false;
+	}
+
+	// An empty file cannot be mapped, but is still a file.
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_isOpen = true;
+	if (m_size == 0)
+		return true;
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mapping != nullptr)
+		m_data = static_cast<const std::byte *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		UnmapViewOfFile(m_data);
+	if (m_mapping != nullptr)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = INVALID_HANDLE_VALUE;
+	m_size = 0;
+	m_isOpen = false;
+}
+
+#else
+
+bool MappedFile::Open(const char * path)
+{
+	Close();
+
+	// The mapping keeps the file alive, so the descriptor can go right away.
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+		return false;
+
+	struct stat status;
+	bool opened = fstat(file, &status) == 0;
+	if (opened && status.st_size > 0)
+	{
+		void * data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		opened = data != MAP_FAILED;
+		if (opened)
+			m_data = static_cast<const std::byte *>(data);
+	}
+	close(file);
+
+	if (!opened)
+		return false;
+	m_size = static_cast<size_t>(status.st_size);
+	m_isOpen = true;
+	return true;
+}
+
+
+void MappedFile::Close()
+{
+	if (m_data != nullptr)
+		munmap(const_cast<std::byte *>(m_data), m_size);
+	m_data = nullptr;
+	m_size = 0;
+	m_isOpen = false;
+}
+
+#endif
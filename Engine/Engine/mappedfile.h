@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: mappedfile.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "platform.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: MappedFile
+//
+// A whole file mapped read-only into memory. Pages are read in by the OS as
+// they are touched, so opening costs the same whatever the size and nothing
+// is copied through a stream buffer.
+////////////////////////////////////////////////////////////////////////////////
+class MappedFile
+{
+public:
+	MappedFile() = default;
+
+	// Throws std::runtime_error if the file cannot be mapped.
+	explicit MappedFile(const char *);
+	MappedFile(MappedFile &&) noexcept;
+	MappedFile & operator=(MappedFile &&) noexcept;
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+	~MappedFile() { Close(); }
+
+	// False, leaving the file closed, if it does not exist or cannot be mapped.
+	bool Open(const char *);
+	void Close();
+
+	bool IsOpen() const { return m_isOpen; }
+	const std::byte * GetData() const { return m_data; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	void Swap(MappedFile &) noexcept;
+
+	const std::byte * m_data = nullptr;
+	size_t m_size = 0;
+	bool m_isOpen = false;
+#ifdef _WIN32
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+#endif
+};
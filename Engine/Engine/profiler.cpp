@@ -0,0 +1,276 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: profiler.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "profiler.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+
+
+// Scopes a thread can close between two EndFrames before it drops some.
+static const size_t RingSize = 8192;
+
+// What a capture keeps at most; about a minute of a busy frame.
+static const size_t MaxCapturedEvents = size_t(1) << 20;
+
+
+// Where the tick count was when the steady clock read this, to measure
+// how fast it runs against.
+static const uint64_t s_startTicks = Profiler::Now();
+static const auto s_startTime = std::chrono::steady_clock::now();
+
+
+// The rate is taken over everything since the start, so it gets better
+// the longer the game runs. The first call waits until at least a
+// millisecond has passed, to start off somewhere close.
+static double GetNanosecondsPerTick()
+{
+#ifdef PROFILER_TSC
+	std::chrono::duration<double, std::nano> elapsed;
+	uint64_t ticks;
+	do
+	{
+		elapsed = std::chrono::steady_clock::now() - s_startTime;
+		ticks = Profiler::Now() - s_startTicks;
+	} while (elapsed < std::chrono::milliseconds(1) || ticks == 0);
+	return elapsed.count() / ticks;
+#else
+	return 1.0;
+#endif
+}
+
+
+// A ring only its thread writes to and only EndFrame reads from, so the
+// two positions are all they share.
+struct ThreadEvents
+{
+	struct Entry
+	{
+		const char * name;
+		uint64_t start, end;
+	};
+
+	Entry entries[RingSize];
+	std::atomic<uint64_t> head = 0, tail = 0, dropped = 0;
+
+	// Guarded by s_threadsMutex.
+	std::string name;
+	bool isInUse = true;
+};
+
+
+static std::mutex s_threadsMutex;
+static std::vector<std::unique_ptr<ThreadEvents>> s_threads;
+static thread_local ThreadEvents * t_events = nullptr;
+
+
+// Hands a thread's ring back when it ends, for the next thread to reuse.
+// Anything still in it is taken by the next EndFrame all the same.
+struct ThreadRegistration
+{
+	~ThreadRegistration()
+	{
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		t_events->isInUse = false;
+	}
+};
+
+
+static ThreadEvents & GetThreadEvents()
+{
+	if (t_events != nullptr)
+		return *t_events;
+
+	{
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		auto free = std::find_if(s_threads.begin(), s_threads.end(), [](const auto & events) { return !events->isInUse; });
+		if (free == s_threads.end())
+			free = s_threads.insert(free, std::make_unique<ThreadEvents>());
+		t_events = free->get();
+		t_events->name.clear();
+		t_events->isInUse = true;
+	}
+	static thread_local ThreadRegistration registration;
+	return *t_events;
+}
+
+
+void Profiler::Record(const char * name, uint64_t start, uint64_t end)
+{
+	ThreadEvents & events = GetThreadEvents();
+	uint64_t head = events.head.load(std::memory_order_relaxed);
+	if (head - events.tail.load(std::memory_order_acquire) == RingSize)
+	{
+		events.dropped.store(events.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return;
+	}
+	events.entries[head % RingSize] = { name, start, end };
+	events.head.store(head + 1, std::memory_order_release);
+}
+
+
+void Profiler::SetThreadName(std::string name)
+{
+	ThreadEvents & events = GetThreadEvents();
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	events.name = std::move(name);
+}
+
+
+std::string Profiler::GetThreadName(uint32_t thread)
+{
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	if (thread < s_threads.size() && !s_threads[thread]->name.empty())
+		return s_threads[thread]->name;
+	return "Thread " + std::to_string(thread);
+}
+
+
+size_t Profiler::GetDroppedCount()
+{
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	size_t dropped = 0;
+	for (const auto & events : s_threads)
+		dropped += events->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+
+void Profiler::EndFrame()
+{
+	s_frame.clear();
+	uint32_t self = 0;
+	{
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		for (size_t i = 0; i < s_threads.size(); i++)
+		{
+			ThreadEvents & events = *s_threads[i];
+			uint64_t head = events.head.load(std::memory_order_acquire);
+			for (uint64_t j = events.tail.load(std::memory_order_relaxed); j < head; j++)
+			{
+				const auto & entry = events.entries[j % RingSize];
+				s_frame.push_back({ entry.name, entry.start, entry.end, static_cast<uint32_t>(i) });
+			}
+			events.tail.store(head, std::memory_order_release);
+			if (&events == t_events)
+				self = static_cast<uint32_t>(i);
+		}
+	}
+
+	// Scopes are recorded as they close, so a parent comes after its
+	// children; in order of starting, the longer first on a tie, whatever
+	// is still open when one starts is what it is nested in.
+	auto order = [self](uint32_t thread) { return thread == self ? 0 : thread + 1; };
+	std::sort(s_frame.begin(), s_frame.end(), [&](const Event & a, const Event & b) {
+		if (a.thread != b.thread)
+			return order(a.thread) < order(b.thread);
+		return a.start != b.start ? a.start < b.start : a.end > b.end;
+	});
+
+	s_last.clear();
+	std::vector<uint64_t> open;
+	size_t threadStart = 0;
+	for (size_t i = 0; i < s_frame.size(); i++)
+	{
+		const Event & event = s_frame[i];
+		if (i > 0 && event.thread != s_frame[i - 1].thread)
+		{
+			open.clear();
+			threadStart = s_last.size();
+		}
+		while (!open.empty() && open.back() <= event.start)
+			open.pop_back();
+		auto depth = static_cast<uint32_t>(open.size());
+		open.push_back(event.end);
+
+		auto total = std::find_if(s_last.begin() + threadStart, s_last.end(), [&](const ScopeTotal & total) {
+			return total.name == event.name && total.depth == depth;
+		});
+		if (total == s_last.end())
+			total = s_last.insert(total, { event.name, event.thread, depth, 0, 0 });
+		total->calls++;
+		total->nanoseconds += event.end - event.start;
+	}
+
+	// Summed in ticks, which only now become time.
+	double nanosecondsPerTick = GetNanosecondsPerTick();
+	for (auto & total : s_last)
+		total.nanoseconds = static_cast<uint64_t>(total.nanoseconds * nanosecondsPerTick);
+
+	if (s_isCapturing)
+	{
+		size_t room = MaxCapturedEvents - std::min(MaxCapturedEvents, s_captured.size());
+		s_captured.insert(s_captured.end(), s_frame.begin(), s_frame.begin() + std::min(room, s_frame.size()));
+	}
+}
+
+
+void Profiler::StartCapture()
+{
+	s_captured.clear();
+	s_captureStart = Now();
+	s_isCapturing = true;
+}
+
+
+// Names are literals in the code, but may still hold a quote or backslash.
+static void WriteJsonString(std::ostream & stream, const std::string & text)
+{
+	stream << '"';
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			stream << '\\';
+		stream << c;
+	}
+	stream << '"';
+}
+
+
+void Profiler::StopCapture(std::ostream & stream)
+{
+	s_isCapturing = false;
+
+	std::vector<uint32_t> threads;
+	for (const auto & event : s_captured)
+		if (std::find(threads.begin(), threads.end(), event.thread) == threads.end())
+			threads.push_back(event.thread);
+
+	stream << "{\"traceEvents\":[\n";
+	const char * separator = "";
+	for (uint32_t thread : threads)
+	{
+		stream << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread << ",\"args\":{\"name\":";
+		WriteJsonString(stream, GetThreadName(thread));
+		stream << "}}";
+		separator = ",\n";
+	}
+
+	// Chrome wants microseconds; three decimals keep the nanoseconds.
+	double nanosecondsPerTick = GetNanosecondsPerTick();
+	auto toNanoseconds = [=](uint64_t ticks) { return static_cast<uint64_t>(ticks * nanosecondsPerTick); };
+	char times[64];
+	for (const auto & event : s_captured)
+	{
+		uint64_t start = toNanoseconds(event.start - std::min(event.start, s_captureStart));
+		uint64_t duration = toNanoseconds(event.end - event.start);
+		std::snprintf(times, sizeof(times), "%llu.%03llu,\"dur\":%llu.%03llu",
+			static_cast<unsigned long long>(start / 1000), static_cast<unsigned long long>(start % 1000),
+			static_cast<unsigned long long>(duration / 1000), static_cast<unsigned long long>(duration % 1000));
+		stream << separator << "{\"name\":";
+		WriteJsonString(stream, event.name);
+		stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << times << "}";
+		separator = ",\n";
+	}
+	stream << "\n],\"displayTimeUnit\":\"ns\"}\n";
+
+	s_captured.clear();
+	s_captured.shrink_to_fit();
+}
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: profiler.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define PROFILER_TSC
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define PROFILER_TSC
+#endif
+
+
+///////////////////////////////
+// PRE-PROCESSING DIRECTIVES //
+///////////////////////////////
+// Times the rest of the enclosing block under name, which has to outlive
+// the profiler, so in practice a string literal. Building with
+// ENGINE_NO_PROFILER defined compiles every scope out.
+#define PROFILE_JOIN_(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN_(a, b)
+#ifdef ENGINE_NO_PROFILER
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_JOIN(profileScope, __LINE__)(name)
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: Profiler
+//
+// Collects where the time in a frame went. Every thread writes the scopes it
+// closes into a ring of its own without taking a lock, and whoever calls
+// EndFrame, the game thread, drains them all. How scopes nest is worked out
+// from their times then, so a scope costs two clock reads and a store. On
+// x86 the clock is the CPU's time stamp counter, which is a few times
+// cheaper to read than the steady clock; EndFrame turns it into time.
+//
+// Scopes that don't fit in their thread's ring before the next EndFrame are
+// dropped and counted rather than waited for.
+////////////////////////////////////////////////////////////////////////////////
+class Profiler
+{
+public:
+	// The time one thread spent in a scope over the last frame, and how
+	// many scopes it was nested in. Listed by thread, the one that called
+	// EndFrame first, then in the order the scopes first began.
+	struct ScopeTotal
+	{
+		const char * name;
+		uint32_t thread;
+		uint32_t depth;
+		uint32_t calls;
+		uint64_t nanoseconds;
+	};
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char * name)
+			:
+			m_name(s_isEnabled.load(std::memory_order_relaxed) ? name : nullptr),
+			m_start(m_name != nullptr ? Now() : 0)
+		{
+		}
+
+		~Scope()
+		{
+			if (m_name != nullptr)
+				Record(m_name, m_start, Now());
+		}
+
+		Scope(const Scope &) = delete;
+		Scope & operator=(const Scope &) = delete;
+
+	private:
+		const char * m_name;
+		uint64_t m_start;
+	};
+
+	// Scopes opened while disabled are not recorded even if it is enabled
+	// again before they close.
+	static void SetEnabled(bool isEnabled) { s_isEnabled = isEnabled; }
+	static bool IsEnabled() { return s_isEnabled; }
+
+	// What traces call the calling thread.
+	static void SetThreadName(std::string);
+	static std::string GetThreadName(uint32_t thread);
+
+	// Takes what every thread recorded since the last call. Only ever call
+	// it from one thread.
+	static void EndFrame();
+	static const std::vector<ScopeTotal> & LastFrame() { return s_last; }
+
+	// Scopes lost to full rings since the start.
+	static size_t GetDroppedCount();
+
+	// Keeps what EndFrame takes, until StopCapture writes all of it as a
+	// Chrome trace, for chrome://tracing or Perfetto.
+	static void StartCapture();
+	static bool IsCapturing() { return s_isCapturing; }
+	static void StopCapture(std::ostream &);
+
+	// In ticks of whatever clock scopes are timed with.
+	static uint64_t Now()
+	{
+#ifdef PROFILER_TSC
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+private:
+	struct Event
+	{
+		const char * name;
+		uint64_t start, end;
+		uint32_t thread;
+	};
+
+	static void Record(const char * name, uint64_t start, uint64_t end);
+
+	static inline std::atomic<bool> s_isEnabled = true;
+	static inline bool s_isCapturing = false;
+	static inline uint64_t s_captureStart = 0;
+	static inline std::vector<Event> s_frame, s_captured;
+	static inline std::vector<ScopeTotal> s_last;
+};
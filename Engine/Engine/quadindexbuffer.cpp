@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: quadindexbuffer.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "quadindexbuffer.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <vector>
+
+
+QuadIndexBuffer::Binding QuadIndexBuffer::Get(ID3D11Device * device, size_t quadCount)
+{
+	bool isShort = quadCount <= MaxShortQuads;
+	Entry & entry = isShort ? s_short : s_long;
+	DXGI_FORMAT format = isShort ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+	if (entry.device == device && entry.buffer != nullptr && entry.capacity >= quadCount)
+		return { entry.buffer, format };
+
+	// Round up so a handful of growing batches only cause a rebuild or two.
+	size_t capacity = std::max(entry.device == device ? entry.capacity : 0, MinQuads);
+	while (capacity < quadCount)
+		capacity *= 2;
+	if (isShort)
+		capacity = std::min(capacity, MaxShortQuads);
+
+	D3D11_BUFFER_DESC indexBufferDesc = { 0, D3D11_USAGE_IMMUTABLE, D3D11_BIND_INDEX_BUFFER };
+	D3D11_SUBRESOURCE_DATA indexData = {};
+	std::vector<uint16_t> shortIndices;
+	std::vector<uint32_t> longIndices;
+	if (isShort)
+	{
+		shortIndices.resize(6 * capacity);
+		VertexBuilder::BuildQuadIndices(shortIndices.data(), capacity);
+		indexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint16_t) * shortIndices.size());
+		indexData.pSysMem = shortIndices.data();
+	}
+	else
+	{
+		longIndices.resize(6 * capacity);
+		VertexBuilder::BuildQuadIndices(longIndices.data(), capacity);
+		indexBufferDesc.ByteWidth = static_cast<UINT>(sizeof(uint32_t) * longIndices.size());
+		indexData.pSysMem = longIndices.data();
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	ThrowIfFailed(
+		device->CreateBuffer(&indexBufferDesc, &indexData, buffer.GetAddressOf()),
+		"Could not create the quad index buffer."
+	);
+
+	entry.device = device;
+	entry.buffer = buffer;
+	entry.capacity = capacity;
+	return { buffer, format };
+}
+
+
+void QuadIndexBuffer::Release()
+{
+	s_short = Entry();
+	s_long = Entry();
+}
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: quadindexbuffer.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <wrl\client.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "vertexbuilder.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: QuadIndexBuffer
+//
+// Every quad batch uses the same index pattern, so they all share one
+// immutable index buffer. It is 16-bit while the batch's vertices fit, and
+// only gets rebuilt, twice as large, when a longer batch asks for it. Holders
+// keep their own reference, so a rebuild never pulls a buffer out from under
+// anyone.
+////////////////////////////////////////////////////////////////////////////////
+class QuadIndexBuffer
+{
+public:
+	struct Binding
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		DXGI_FORMAT format;
+	};
+
+	// A buffer holding the indices of at least quadCount quads.
+	static Binding Get(ID3D11Device *, size_t quadCount);
+
+	// Drops the cached buffers; called before the device goes away.
+	static void Release();
+
+private:
+	struct Entry
+	{
+		ID3D11Device * device = nullptr;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		size_t capacity = 0;
+	};
+
+	// The largest batch 16-bit indices can address, four vertices per quad.
+	static const size_t MaxShortQuads = 65536 / 4;
+	static const size_t MinQuads = 64;
+
+	static Entry s_short, s_long;
+};
+
+
+// Defined out here, as Entry is not complete inside the class.
+inline QuadIndexBuffer::Entry QuadIndexBuffer::s_short, QuadIndexBuffer::s_long;
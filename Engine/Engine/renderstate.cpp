@@ -0,0 +1,140 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: renderstate.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "renderstate.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+
+
+using Stage = StateTracker::Stage;
+
+
+void RenderState::SetInputLayout(ID3D11DeviceContext * context, ID3D11InputLayout * layout)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::InputLayout, 0, layout))
+		context->IASetInputLayout(layout);
+}
+
+
+void RenderState::SetVertexShader(ID3D11DeviceContext * context, ID3D11VertexShader * shader)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::VertexShader, 0, shader))
+		context->VSSetShader(shader, NULL, 0);
+}
+
+
+void RenderState::SetPixelShader(ID3D11DeviceContext * context, ID3D11PixelShader * shader)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::PixelShader, 0, shader))
+		context->PSSetShader(shader, NULL, 0);
+}
+
+
+void RenderState::SetTopology(ID3D11DeviceContext * context, D3D11_PRIMITIVE_TOPOLOGY topology)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::Topology, 0, nullptr, topology))
+		context->IASetPrimitiveTopology(topology);
+}
+
+
+void RenderState::SetIndexBuffer(ID3D11DeviceContext * context, ID3D11Buffer * buffer, DXGI_FORMAT format)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::IndexBuffer, 0, buffer, format))
+		context->IASetIndexBuffer(buffer, format, 0);
+}
+
+
+void RenderState::SetVertexBuffers(ID3D11DeviceContext * context, UINT count, ID3D11Buffer * const * buffers,
+	const UINT * strides, const UINT * offsets)
+{
+	UseContext(context);
+
+	// Every slot is looked at so the tracker learns all of them.
+	bool changed = false;
+	for (UINT i = 0; i < count; i++)
+		changed |= s_tracker.Bind(Stage::VertexBuffer, i, buffers[i], uint64_t(strides[i]) << 32 | offsets[i]);
+	if (changed)
+		context->IASetVertexBuffers(0, count, buffers, strides, offsets);
+}
+
+
+void RenderState::SetVertexShaderResource(ID3D11DeviceContext * context, UINT slot, ID3D11ShaderResourceView * view)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::VertexResource, slot, view))
+		context->VSSetShaderResources(slot, 1, &view);
+}
+
+
+void RenderState::SetPixelShaderResource(ID3D11DeviceContext * context, UINT slot, ID3D11ShaderResourceView * view)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::PixelResource, slot, view))
+		context->PSSetShaderResources(slot, 1, &view);
+}
+
+
+void RenderState::SetPixelSampler(ID3D11DeviceContext * context, UINT slot, ID3D11SamplerState * sampler)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::PixelSampler, slot, sampler))
+		context->PSSetSamplers(slot, 1, &sampler);
+}
+
+
+void RenderState::SetVertexConstantBuffer(ID3D11DeviceContext * context, UINT slot, ID3D11Buffer * buffer)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::VertexConstants, slot, buffer))
+		context->VSSetConstantBuffers(slot, 1, &buffer);
+}
+
+
+void RenderState::SetPixelConstantBuffer(ID3D11DeviceContext * context, UINT slot, ID3D11Buffer * buffer)
+{
+	UseContext(context);
+	if (s_tracker.Bind(Stage::PixelConstants, slot, buffer))
+		context->PSSetConstantBuffers(slot, 1, &buffer);
+}
+
+
+void RenderState::UpdateConstantBuffer(ID3D11DeviceContext * context, ID3D11Buffer * buffer, const void * data, size_t size)
+{
+	UseContext(context);
+	if (!s_tracker.Update(buffer, data, size))
+		return;
+
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
+	ThrowIfFailed(
+		context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
+		"Could not lock the constant buffer."
+	);
+	std::memcpy(mappedResource.pData, data, size);
+	context->Unmap(buffer, 0);
+}
+
+
+// Only one context is ever drawn with, but a new one knows nothing of
+// what was bound to the old.
+void RenderState::UseContext(ID3D11DeviceContext * context)
+{
+	if (s_context == context)
+		return;
+	s_tracker.Invalidate();
+	s_context = context;
+}
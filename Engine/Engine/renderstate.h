@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: renderstate.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "statetracker.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: RenderState
+//
+// Sits in front of the immediate context for the bindings drawing code
+// changes all the time, and drops the calls that would leave them as they
+// are. Constant buffers are only mapped and written when their contents
+// change. Every draw has to bind through here, or the tracker goes stale.
+////////////////////////////////////////////////////////////////////////////////
+class RenderState
+{
+public:
+	static void SetInputLayout(ID3D11DeviceContext *, ID3D11InputLayout *);
+	static void SetVertexShader(ID3D11DeviceContext *, ID3D11VertexShader *);
+	static void SetPixelShader(ID3D11DeviceContext *, ID3D11PixelShader *);
+	static void SetTopology(ID3D11DeviceContext *, D3D11_PRIMITIVE_TOPOLOGY);
+	static void SetIndexBuffer(ID3D11DeviceContext *, ID3D11Buffer *, DXGI_FORMAT);
+
+	// All count buffers are bound if any of them changed.
+	static void SetVertexBuffers(ID3D11DeviceContext *, UINT count, ID3D11Buffer * const *,
+		const UINT * strides, const UINT * offsets);
+
+	static void SetVertexShaderResource(ID3D11DeviceContext *, UINT slot, ID3D11ShaderResourceView *);
+	static void SetPixelShaderResource(ID3D11DeviceContext *, UINT slot, ID3D11ShaderResourceView *);
+	static void SetPixelSampler(ID3D11DeviceContext *, UINT slot, ID3D11SamplerState *);
+	static void SetVertexConstantBuffer(ID3D11DeviceContext *, UINT slot, ID3D11Buffer *);
+	static void SetPixelConstantBuffer(ID3D11DeviceContext *, UINT slot, ID3D11Buffer *);
+
+	// Writes size bytes of data to a dynamic buffer unless it holds them
+	// already.
+	static void UpdateConstantBuffer(ID3D11DeviceContext *, ID3D11Buffer *, const void * data, size_t size);
+
+	// Call after changing render targets, and at the start of a frame.
+	static void Invalidate() { s_tracker.Invalidate(); }
+
+private:
+	static void UseContext(ID3D11DeviceContext *);
+
+	static inline ID3D11DeviceContext * s_context = nullptr;
+	static inline StateTracker s_tracker;
+};
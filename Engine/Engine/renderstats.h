@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: renderstats.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: RenderStats
+//
+// Counters the renderer bumps while it builds a frame. GraphicsClass closes
+// every frame with EndFrame, after which the totals of the frame just drawn
+// are available from LastFrame for the debug overlay.
+////////////////////////////////////////////////////////////////////////////////
+class RenderStats
+{
+public:
+	struct Counters
+	{
+		// Vertex data copied to the GPU and the number of copies it took.
+		size_t bytesUploaded = 0;
+		size_t uploads = 0;
+
+		// Text draw calls and glyphs laid out again because their sentence
+		// changed.
+		size_t textDraws = 0;
+		size_t glyphsRebuilt = 0;
+
+		// Context calls RenderState made or found it could skip, and the
+		// same for constant buffer writes.
+		size_t stateBinds = 0;
+		size_t stateBindsSkipped = 0;
+		size_t constantUploads = 0;
+		size_t constantUploadsSkipped = 0;
+	};
+
+	static Counters & Current() { return s_current; }
+	static const Counters & LastFrame() { return s_last; }
+
+	static void EndFrame()
+	{
+		s_last = s_current;
+		s_current = Counters();
+	}
+
+private:
+	static Counters s_current, s_last;
+};
+
+
+// Defined out here, as Counters is not complete inside the class.
+inline RenderStats::Counters RenderStats::s_current, RenderStats::s_last;
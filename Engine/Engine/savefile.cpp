@@ -0,0 +1,336 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: savefile.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "savefile.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#ifndef _WIN32
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "alloctracker.h"
+#include "jobsystem.h"
+#include "mappedfile.h"
+#include "profiler.h"
+
+
+// The file starts with this, followed by each chunk: its id, its size
+// before and after packing and a checksum of the unpacked bytes, then the
+// packed bytes.
+struct SaveFileHeader
+{
+	char magic[4];
+	uint32_t version, count;
+};
+
+
+struct SaveFileChunkHeader
+{
+	uint32_t id, size, packedSize, checksum;
+};
+
+
+// FNV-1a; it only has to catch damage, not tampering.
+uint32_t SaveFile::Checksum(const std::byte * data, size_t size)
+{
+	uint32_t hash = 0x811c9dc5u;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x01000193u;
+	return hash;
+}
+
+
+// PackBits: a control byte n below 128 is followed by n + 1 bytes as they
+// are, and one above by a byte repeated 257 - n times. Tile maps are mostly
+// long runs of sky and rock.
+void SaveFile::Pack(const Bytes & bytes, Bytes & packed)
+{
+	packed.clear();
+	size_t i = 0, size = bytes.size();
+	while (i < size)
+	{
+		size_t run = 1;
+		while (i + run < size && run < 128 && bytes[i + run] == bytes[i])
+			run++;
+		if (run >= 2)
+		{
+			packed.push_back(static_cast<std::byte>(257 - run));
+			packed.push_back(bytes[i]);
+			i += run;
+			continue;
+		}
+
+		// Literals until a run of three worth packing starts.
+		size_t start = i;
+		while (i < size && i - start < 128)
+		{
+			if (i + 2 < size && bytes[i] == bytes[i + 1] && bytes[i] == bytes[i + 2])
+				break;
+			i++;
+		}
+		packed.push_back(static_cast<std::byte>(i - start - 1));
+		packed.insert(packed.end(), bytes.begin() + start, bytes.begin() + i);
+	}
+}
+
+
+// False if the bytes do not unpack to exactly size of them.
+bool SaveFile::Unpack(const std::byte * packed, size_t packedSize, size_t size, Bytes & bytes)
+{
+	bytes.clear();
+	bytes.reserve(size);
+	size_t i = 0;
+	while (i < packedSize)
+	{
+		auto control = static_cast<uint8_t>(packed[i++]);
+		if (control < 128)
+		{
+			size_t count = control + 1;
+			if (count > packedSize - i || count > size - bytes.size())
+				return false;
+			bytes.insert(bytes.end(), packed + i, packed + i + count);
+			i += count;
+		}
+		else if (control > 128)
+		{
+			size_t count = 257 - control;
+			if (i == packedSize || count > size - bytes.size())
+				return false;
+			bytes.insert(bytes.end(), count, packed[i++]);
+		}
+	}
+	return bytes.size() == size;
+}
+
+
+bool SaveFile::SetChunk(ChunkId id, const void * data, size_t size)
+{
+	auto bytes = static_cast<const std::byte *>(data);
+	auto it = m_chunks.find(id);
+	if (it != m_chunks.end() && it->second->size() == size && std::memcmp(it->second->data(), bytes, size) == 0)
+		return false;
+
+	m_chunks[id] = std::make_shared<const Bytes>(bytes, bytes + size);
+	m_changed.insert(id);
+	return true;
+}
+
+
+bool SaveFile::RemoveChunk(ChunkId id)
+{
+	if (m_chunks.erase(id) == 0)
+		return false;
+	m_changed.insert(id);
+	return true;
+}
+
+
+const SaveFile::Bytes * SaveFile::FindChunk(ChunkId id) const
+{
+	auto it = m_chunks.find(id);
+	return it == m_chunks.end() ? nullptr : it->second.get();
+}
+
+
+std::vector<SaveFile::Change> SaveFile::TakeChanges()
+{
+	std::vector<Change> changes;
+	changes.reserve(m_changed.size());
+	for (auto id : m_changed)
+	{
+		auto it = m_chunks.find(id);
+		changes.push_back({ id, it == m_chunks.end() ? nullptr : it->second });
+	}
+	m_changed.clear();
+	return changes;
+}
+
+
+void SaveFile::Apply(const std::vector<Change> & changes)
+{
+	for (const auto & change : changes)
+	{
+		if (change.bytes != nullptr)
+			m_chunks[change.id] = change.bytes;
+		else
+			m_chunks.erase(change.id);
+		m_changed.insert(change.id);
+	}
+}
+
+
+bool SaveFile::Load(const char * path)
+{
+	ALLOCATION_SCOPE(Io);
+	MappedFile file;
+	return file.Open(path) && Load(file.GetData(), file.GetSize());
+}
+
+
+bool SaveFile::Load(const std::byte * data, size_t size)
+{
+	// Read in full before replacing anything, so a damaged file changes
+	// nothing.
+	std::map<ChunkId, SharedBytes> chunks;
+	try
+	{
+		MemoryReader reader(data, size);
+		auto header = reader.Get<SaveFileHeader>();
+		if (std::memcmp(header.magic, "SAVE", 4) != 0 || header.version != Version)
+			return false;
+
+		for (uint32_t i = 0; i < header.count; i++)
+		{
+			auto chunk = reader.Get<SaveFileChunkHeader>();
+			Bytes bytes;
+			if (!Unpack(reader.Read(chunk.packedSize), chunk.packedSize, chunk.size, bytes) ||
+				Checksum(bytes.data(), bytes.size()) != chunk.checksum)
+				return false;
+			if (!chunks.emplace(chunk.id, std::make_shared<const Bytes>(std::move(bytes))).second)
+				return false;
+		}
+		if (reader.GetRemaining() != 0)
+			return false;
+	}
+	catch (std::out_of_range &)
+	{
+		return false;
+	}
+
+	m_chunks = std::move(chunks);
+	m_changed.clear();
+	return true;
+}
+
+
+// Everything has to be on the disk before the rename, or a crash could
+// leave the new name pointing at a file that was never written out.
+static void WriteThrough(const std::string & path, const std::string & bytes)
+{
+	auto fail = [&]() {
+		throw std::runtime_error(FormatString("Could not write %s", path.data()).data());
+	};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.data(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		fail();
+	DWORD written = 0;
+	bool isWritten = WriteFile(file, bytes.data(), static_cast<DWORD>(bytes.size()), &written, NULL)
+		&& written == bytes.size() && FlushFileBuffers(file);
+	CloseHandle(file);
+#else
+	int file = open(path.data(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (file < 0)
+		fail();
+	size_t written = 0;
+	while (written < bytes.size())
+	{
+		auto count = write(file, bytes.data() + written, bytes.size() - written);
+		if (count <= 0)
+			break;
+		written += static_cast<size_t>(count);
+	}
+	bool isWritten = written == bytes.size() && fsync(file) == 0;
+	close(file);
+#endif
+	if (!isWritten)
+		fail();
+}
+
+
+static void Replace(const std::string & from, const std::string & to)
+{
+#ifdef _WIN32
+	if (!MoveFileExA(from.data(), to.data(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		throw std::runtime_error(FormatString("Could not replace %s", to.data()).data());
+#else
+	if (std::rename(from.data(), to.data()) != 0)
+		throw std::runtime_error(FormatString("Could not replace %s", to.data()).data());
+
+	// The rename itself lives in the directory.
+	auto slash = to.find_last_of('/');
+	std::string directory = slash == std::string::npos ? "." : to.substr(0, slash + 1);
+	int handle = open(directory.data(), O_RDONLY);
+	if (handle >= 0)
+	{
+		fsync(handle);
+		close(handle);
+	}
+#endif
+}
+
+
+SaveFile::Stats SaveFile::Save(const char * path)
+{
+	ALLOCATION_SCOPE(Io);
+
+	auto start = std::chrono::steady_clock::now();
+	Stats stats;
+	stats.chunks = m_chunks.size();
+	stats.chunksChanged = m_changed.size();
+	for (auto id : m_changed)
+		if (auto chunk = FindChunk(id))
+			stats.bytesChanged += chunk->size();
+	if (m_changed.empty())
+		return stats;
+
+	std::ostringstream stream(std::ios::binary);
+	Save(stream);
+	auto bytes = stream.str();
+	std::string temporary = std::string(path) + ".tmp";
+	WriteThrough(temporary, bytes);
+	Replace(temporary, path);
+
+	m_changed.clear();
+	stats.bytesWritten = bytes.size();
+	stats.time = std::chrono::steady_clock::now() - start;
+	return stats;
+}
+
+
+void SaveFile::Save(std::ostream & stream) const
+{
+	PROFILE_SCOPE("SaveFile::Save");
+	ALLOCATION_SCOPE(Io);
+
+	SaveFileHeader header = { { 'S', 'A', 'V', 'E' }, Version, static_cast<uint32_t>(m_chunks.size()) };
+	BinaryWriter writer(stream);
+	writer.Write(header);
+
+	// Chunks are packed and summed in parallel, then written in order.
+	std::vector<std::pair<ChunkId, const Bytes *>> chunks;
+	for (const auto & chunk : m_chunks)
+		chunks.emplace_back(chunk.first, chunk.second.get());
+	std::vector<Bytes> packed(chunks.size());
+	std::vector<uint32_t> checksums(chunks.size());
+	JobSystem::Get().ParallelFor(0, chunks.size(), 4, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++)
+		{
+			Pack(*chunks[i].second, packed[i]);
+			checksums[i] = Checksum(chunks[i].second->data(), chunks[i].second->size());
+		}
+	});
+
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		writer.Write(SaveFileChunkHeader{
+			chunks[i].first, static_cast<uint32_t>(chunks[i].second->size()), static_cast<uint32_t>(packed[i].size()),
+			checksums[i]
+		});
+		writer.Write(packed[i].data(), packed[i].size());
+	}
+}
@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: savefile.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SaveFile
+//
+// A save game made of independent chunks, each tagged with an id and kept
+// in memory between saves. Game objects hand over the bytes of the chunks
+// they own, and only ones that differ from what is held already count as
+// changed; a save with nothing changed writes nothing. The file is versioned
+// and every chunk carries a checksum, so a damaged or foreign file is
+// refused as a whole rather than half loaded.
+//
+// Saving writes the whole file aside, flushes it to the disk and renames it
+// over the old one, so a crash at any point leaves one or the other intact.
+// Chunks are run length packed on the way out.
+//
+// Chunk bytes are never changed in place, only replaced, so copies of a
+// SaveFile and the changes taken from one share them rather than copying.
+////////////////////////////////////////////////////////////////////////////////
+class SaveFile
+{
+public:
+	using ChunkId = uint32_t;
+	using Bytes = std::vector<std::byte>;
+	using SharedBytes = std::shared_ptr<const Bytes>;
+
+	// A kind of chunk, such as 'T' for tile map chunks, and which one of
+	// them, in the low 24 bits.
+	static constexpr ChunkId MakeChunkId(char kind, uint32_t index)
+	{
+		return static_cast<uint32_t>(static_cast<uint8_t>(kind)) << 24 | (index & 0xFFFFFF);
+	}
+	static constexpr char GetKind(ChunkId id) { return static_cast<char>(id >> 24); }
+	static constexpr uint32_t GetIndex(ChunkId id) { return id & 0xFFFFFF; }
+
+	// A chunk set to new bytes, or removed if they are null.
+	struct Change
+	{
+		ChunkId id;
+		SharedBytes bytes;
+	};
+
+	struct Stats
+	{
+		size_t chunks = 0, chunksChanged = 0;
+		size_t bytesChanged = 0, bytesWritten = 0;
+		std::chrono::duration<double, std::milli> time{};
+	};
+
+	// True if the chunk is new or its bytes differ from the ones held.
+	bool SetChunk(ChunkId, const void *, size_t);
+	bool RemoveChunk(ChunkId);
+
+	// Sets a chunk to whatever write puts through the BinaryWriter.
+	template<typename Write>
+	bool WriteChunk(ChunkId id, Write write)
+	{
+		std::ostringstream stream(std::ios::binary);
+		BinaryWriter writer(stream);
+		write(writer);
+		auto bytes = stream.str();
+		return SetChunk(id, bytes.data(), bytes.size());
+	}
+
+	// nullptr if there is no such chunk.
+	const Bytes * FindChunk(ChunkId) const;
+
+	// Hands a BinaryReader over the chunk to read, or returns false if
+	// there is no such chunk.
+	template<typename Read>
+	bool ReadChunk(ChunkId id, Read read) const
+	{
+		auto chunk = FindChunk(id);
+		if (chunk == nullptr)
+			return false;
+		std::istringstream stream(std::string(reinterpret_cast<const char *>(chunk->data()), chunk->size()), std::ios::binary);
+		BinaryReader reader(stream);
+		read(reader);
+		return true;
+	}
+
+	// Ordered by id, so all chunks of a kind are next to each other.
+	const std::map<ChunkId, SharedBytes> & GetChunks() const { return m_chunks; }
+
+	// Every chunk changed since the last call, Save or Load, sharing their
+	// bytes rather than copying them. Afterwards nothing counts as changed.
+	std::vector<Change> TakeChanges();
+
+	// Makes the changes taken from another SaveFile here as well.
+	void Apply(const std::vector<Change> &);
+
+	// Replaces every chunk with the file's, or returns false and keeps them
+	// if it is missing, from another version or damaged.
+	bool Load(const char * path);
+	bool Load(const std::byte *, size_t);
+
+	// Replaces path if anything changed since the last Save or Load, and
+	// says what it took. Throws std::runtime_error if the file could not be
+	// written, leaving the old one and every change in place for the next
+	// try.
+	Stats Save(const char * path);
+	void Save(std::ostream &) const;
+
+	bool IsDirty() const { return !m_changed.empty(); }
+
+private:
+	static const uint32_t Version = 2;
+
+	static uint32_t Checksum(const std::byte *, size_t);
+	static void Pack(const Bytes &, Bytes & packed);
+	static bool Unpack(const std::byte * packed, size_t packedSize, size_t size, Bytes &);
+
+	std::map<ChunkId, SharedBytes> m_chunks;
+	std::set<ChunkId> m_changed;
+};
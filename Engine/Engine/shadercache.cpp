@@ -0,0 +1,173 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: shadercache.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "shadercache.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <tuple>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "mappedfile.h"
+
+
+// The file starts with this, followed by each entry: its key, with the
+// strings length prefixed, then the blob's size and bytes.
+struct ShaderCacheHeader
+{
+	char magic[4];
+	uint32_t version, compilerVersion, count;
+};
+
+
+bool ShaderCache::Key::operator<(const Key & other) const
+{
+	return std::tie(sourceHash, entryPoint, target, flags)
+		< std::tie(other.sourceHash, other.entryPoint, other.target, other.flags);
+}
+
+
+// FNV-1a, as for font files.
+uint64_t ShaderCache::Hash(std::string_view data)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (char c : data)
+		hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ull;
+	return hash;
+}
+
+
+ShaderCache::Key ShaderCache::MakeKey(std::string_view source, const char * entryPoint, const char * target, uint32_t flags)
+{
+	return { Hash(source), entryPoint, target, flags };
+}
+
+
+const ShaderCache::Bytecode * ShaderCache::Find(const Key & key) const
+{
+	auto it = m_entries.find(key);
+	return it == m_entries.end() ? nullptr : &it->second;
+}
+
+
+const ShaderCache::Bytecode & ShaderCache::GetOrCompile(const Key & key, const std::function<Bytecode()> & compile)
+{
+	auto it = m_entries.find(key);
+	if (it != m_entries.end())
+	{
+		m_hits++;
+		return it->second;
+	}
+
+	m_misses++;
+	m_isDirty = true;
+	return m_entries.emplace(key, compile()).first->second;
+}
+
+
+bool ShaderCache::Load(const char * path)
+{
+	MappedFile file;
+	return file.Open(path) && Load(file.GetData(), file.GetSize());
+}
+
+
+bool ShaderCache::Load(const std::byte * data, size_t size)
+{
+	auto readString = [](MemoryReader & reader) {
+		auto length = reader.Get<uint32_t>();
+		return std::string(reinterpret_cast<const char *>(reader.Read(length)), length);
+	};
+
+	// Read in full before adding anything, so a damaged file adds nothing.
+	std::map<Key, Bytecode> entries;
+	try
+	{
+		MemoryReader reader(data, size);
+		auto header = reader.Get<ShaderCacheHeader>();
+		if (std::memcmp(header.magic, "SHDC", 4) != 0 || header.version != Version ||
+			header.compilerVersion != m_compilerVersion)
+			return false;
+
+		for (uint32_t i = 0; i < header.count; i++)
+		{
+			Key key;
+			key.sourceHash = reader.Get<uint64_t>();
+			key.flags = reader.Get<uint32_t>();
+			key.entryPoint = readString(reader);
+			key.target = readString(reader);
+			auto length = reader.Get<uint32_t>();
+			auto blob = reader.Read(length);
+			entries.emplace(std::move(key), Bytecode(blob, blob + length));
+		}
+		if (reader.GetRemaining() != 0)
+			return false;
+	}
+	catch (std::out_of_range &)
+	{
+		return false;
+	}
+
+	m_entries.merge(entries);
+	return true;
+}
+
+
+bool ShaderCache::Save(const char * cachePath)
+{
+	// Written aside and renamed over the old one, as the font caches are.
+	try
+	{
+		std::filesystem::path path(cachePath), temporary(cachePath);
+		temporary += ".tmp";
+		if (path.has_parent_path())
+			std::filesystem::create_directories(path.parent_path());
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			file.exceptions(std::fstream::failbit | std::fstream::badbit);
+			Save(file);
+		}
+		std::filesystem::rename(temporary, path);
+	}
+	catch (std::exception &)
+	{
+		return false;
+	}
+
+	m_isDirty = false;
+	return true;
+}
+
+
+void ShaderCache::Save(std::ostream & stream) const
+{
+	auto writeString = [](BinaryWriter & writer, const std::string & str) {
+		writer.Write(static_cast<uint32_t>(str.size()));
+		writer.Write(str.data(), str.size());
+	};
+
+	ShaderCacheHeader header = {
+		{ 'S', 'H', 'D', 'C' }, Version, m_compilerVersion, static_cast<uint32_t>(m_entries.size())
+	};
+	BinaryWriter writer(stream);
+	writer.Write(header);
+	for (const auto & entry : m_entries)
+	{
+		writer.Write(entry.first.sourceHash);
+		writer.Write(entry.first.flags);
+		writeString(writer, entry.first.entryPoint);
+		writeString(writer, entry.first.target);
+		writer.Write(static_cast<uint32_t>(entry.second.size()));
+		writer.Write(entry.second.data(), entry.second.size());
+	}
+}
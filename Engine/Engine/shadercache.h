@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: shadercache.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ShaderCache
+//
+// Compiled shader bytecode keyed by what went into compiling it: a hash of
+// the source, the entry point, the target profile and the compile flags.
+// Editing a shader changes its hash, so a stale blob is never handed out,
+// just left unused. The whole cache lives in one file, written aside and
+// renamed into place, and is thrown away if it was written by a different
+// compiler. Knows nothing of D3D; ShaderLibrary does the compiling.
+////////////////////////////////////////////////////////////////////////////////
+class ShaderCache
+{
+public:
+	using Bytecode = std::vector<std::byte>;
+
+	struct Key
+	{
+		uint64_t sourceHash;
+		std::string entryPoint, target;
+		uint32_t flags;
+
+		bool operator<(const Key &) const;
+	};
+
+	// Blobs from any other compiler version are not loaded.
+	explicit ShaderCache(uint32_t compilerVersion = 0) : m_compilerVersion(compilerVersion) {}
+
+	static uint64_t Hash(std::string_view);
+	static Key MakeKey(std::string_view source, const char * entryPoint, const char * target, uint32_t flags);
+
+	// nullptr on a miss.
+	const Bytecode * Find(const Key &) const;
+
+	// The cached blob, or what compile returns, which is then kept. The
+	// reference stays valid for the cache's lifetime.
+	const Bytecode & GetOrCompile(const Key &, const std::function<Bytecode()> & compile);
+
+	// Adds the file's entries, or returns false and adds none if it is
+	// missing, from another compiler or damaged.
+	bool Load(const char * path);
+	bool Load(const std::byte *, size_t);
+
+	// False if the file could not be written; the cache is still usable.
+	bool Save(const char * path);
+	void Save(std::ostream &) const;
+
+	// Whether anything was compiled since the last Save.
+	bool IsDirty() const { return m_isDirty; }
+	size_t GetCount() const { return m_entries.size(); }
+	size_t GetHits() const { return m_hits; }
+	size_t GetMisses() const { return m_misses; }
+
+private:
+	static const uint32_t Version = 1;
+
+	uint32_t m_compilerVersion;
+	std::map<Key, Bytecode> m_entries;
+	size_t m_hits = 0, m_misses = 0;
+	bool m_isDirty = false;
+};
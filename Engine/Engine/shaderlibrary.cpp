@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: shaderlibrary.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "shaderlibrary.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <fstream>
+#include <iterator>
+
+
+static const char * CachePath = "cache\\shaders.dat";
+
+static const uint32_t CompileFlags = D3DCOMPILE_ENABLE_STRICTNESS
+#if defined( DEBUG ) || defined( _DEBUG )
+	| D3DCOMPILE_DEBUG
+#endif
+	;
+
+
+ShaderLibrary::VertexStage ShaderLibrary::GetVertexShader(ID3D11Device * device, const char * entryPoint,
+	const D3D11_INPUT_ELEMENT_DESC * elements, UINT elementCount)
+{
+	UseDevice(device);
+	auto it = s_vertexShaders.find(entryPoint);
+	if (it != s_vertexShaders.end())
+		return it->second;
+
+	const auto & bytecode = GetBytecode("VertexShader.hlsl", entryPoint, "vs_5_0");
+	VertexStage stage;
+	ThrowIfFailed(
+		device->CreateVertexShader(bytecode.data(), bytecode.size(), NULL, &stage.shader),
+		FormatString("Could not create the vertex shader %s.", entryPoint).data()
+	);
+	ThrowIfFailed(
+		device->CreateInputLayout(elements, elementCount, bytecode.data(), bytecode.size(), &stage.layout),
+		FormatString("Could not create the input layout for %s.", entryPoint).data()
+	);
+	return s_vertexShaders.emplace(entryPoint, stage).first->second;
+}
+
+
+Microsoft::WRL::ComPtr<ID3D11PixelShader> ShaderLibrary::GetPixelShader(ID3D11Device * device, const char * entryPoint)
+{
+	UseDevice(device);
+	auto it = s_pixelShaders.find(entryPoint);
+	if (it != s_pixelShaders.end())
+		return it->second;
+
+	const auto & bytecode = GetBytecode("PixelShader.hlsl", entryPoint, "ps_5_0");
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> shader;
+	ThrowIfFailed(
+		device->CreatePixelShader(bytecode.data(), bytecode.size(), NULL, &shader),
+		FormatString("Could not create the pixel shader %s.", entryPoint).data()
+	);
+	return s_pixelShaders.emplace(entryPoint, shader).first->second;
+}
+
+
+void ShaderLibrary::Release()
+{
+	// Failing to write it only costs the next start the compiles.
+	if (s_cache.IsDirty())
+		s_cache.Save(CachePath);
+	s_vertexShaders.clear();
+	s_pixelShaders.clear();
+	s_device = nullptr;
+}
+
+
+const ShaderCache::Bytecode & ShaderLibrary::GetBytecode(const char * file, const char * entryPoint, const char * target)
+{
+	if (!s_isCacheLoaded)
+	{
+		s_cache.Load(CachePath);
+		s_isCacheLoaded = true;
+	}
+
+	const auto & source = GetSource(file);
+	auto key = ShaderCache::MakeKey(source, entryPoint, target, CompileFlags);
+	return s_cache.GetOrCompile(key, [&]() {
+		Microsoft::WRL::ComPtr<ID3DBlob> bytecode, errorMessage;
+		HRESULT result = D3DCompile(source.data(), source.size(), file, NULL, NULL,
+			entryPoint, target, CompileFlags, 0, &bytecode, &errorMessage);
+		if (FAILED(result))
+		{
+			// Pop a message up on the screen to notify the user to check the text file for compile errors.
+			throw std::runtime_error(
+				FormatString(
+					"Error compiling %s in %s.\n\n%s",
+					entryPoint, file,
+					errorMessage ? (char*)(errorMessage->GetBufferPointer()) : "No compiler output."
+				).data()
+			);
+		}
+
+		auto data = static_cast<const std::byte *>(bytecode->GetBufferPointer());
+		return ShaderCache::Bytecode(data, data + bytecode->GetBufferSize());
+	});
+}
+
+
+// Each file is read and hashed once, not once per entry point.
+const std::string & ShaderLibrary::GetSource(const char * file)
+{
+	auto it = s_sources.find(file);
+	if (it != s_sources.end())
+		return it->second;
+
+	std::ifstream infile(file);
+	if (!infile)
+		throw std::runtime_error(FormatString("Could not open %s", file).data());
+	std::string lines((std::istreambuf_iterator<char>(infile)), std::istreambuf_iterator<char>());
+	return s_sources.emplace(file, std::move(lines)).first->second;
+}
+
+
+// Objects made on one device mean nothing to another.
+void ShaderLibrary::UseDevice(ID3D11Device * device)
+{
+	if (s_device == device)
+		return;
+	s_vertexShaders.clear();
+	s_pixelShaders.clear();
+	s_device = device;
+}
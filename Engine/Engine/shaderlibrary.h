@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: shaderlibrary.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <map>
+#include <string>
+#include <wrl\client.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "shadercache.h"
+
+
+/////////////
+// LINKING //
+/////////////
+#pragma comment(lib, "d3dcompiler.lib")
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: ShaderLibrary
+//
+// Hands every ShaderClass the same shader objects for the same entry point,
+// so a vertex shader and its input layout are made once however many
+// pixel shaders are paired with it. Bytecode comes from the ShaderCache
+// file when the source is unchanged, and d3dcompiler only runs on a miss.
+////////////////////////////////////////////////////////////////////////////////
+class ShaderLibrary
+{
+public:
+	struct VertexStage
+	{
+		Microsoft::WRL::ComPtr<ID3D11VertexShader> shader;
+		Microsoft::WRL::ComPtr<ID3D11InputLayout> layout;
+	};
+
+	// The layout has to be the same every time an entry point is asked for.
+	static VertexStage GetVertexShader(ID3D11Device *, const char * entryPoint,
+		const D3D11_INPUT_ELEMENT_DESC *, UINT elementCount);
+	static Microsoft::WRL::ComPtr<ID3D11PixelShader> GetPixelShader(ID3D11Device *, const char * entryPoint);
+
+	// Writes out anything newly compiled and drops the shader objects;
+	// called before the device goes away.
+	static void Release();
+
+private:
+	static const ShaderCache::Bytecode & GetBytecode(const char * file, const char * entryPoint, const char * target);
+	static const std::string & GetSource(const char * file);
+	static void UseDevice(ID3D11Device *);
+
+	static inline ID3D11Device * s_device = nullptr;
+	static inline bool s_isCacheLoaded = false;
+	static inline ShaderCache s_cache{ D3D_COMPILER_VERSION };
+	static inline std::map<std::string, std::string> s_sources;
+	static inline std::map<std::string, VertexStage> s_vertexShaders;
+	static inline std::map<std::string, Microsoft::WRL::ComPtr<ID3D11PixelShader>> s_pixelShaders;
+};
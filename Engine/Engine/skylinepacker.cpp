@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: skylinepacker.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "skylinepacker.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+
+
+void SkylinePacker::Reset(int size)
+{
+	m_size = size;
+	m_usedArea = 0;
+	m_skyline.assign(1, { 0, 0, size });
+}
+
+
+int SkylinePacker::Fit(size_t i, int width, int height) const
+{
+	int x = m_skyline[i].x;
+	if (x + width > m_size)
+		return -1;
+
+	// The rect rests on the highest segment it spans.
+	int y = 0;
+	for (int remaining = width; remaining > 0; i++)
+	{
+		y = std::max(y, m_skyline[i].y);
+		if (y + height > m_size)
+			return -1;
+		remaining -= m_skyline[i].width;
+	}
+	return y;
+}
+
+
+bool SkylinePacker::Pack(int width, int height, POINT & position)
+{
+	if (width <= 0 || height <= 0)
+	{
+		position = { 0, 0 };
+		return width >= 0 && height >= 0;
+	}
+
+	// Lowest top edge wins, then the narrowest segment, which keeps the
+	// skyline flat and leaves the wide gaps for wide glyphs.
+	size_t best = SIZE_MAX;
+	int bestTop = INT_MAX, bestWidth = INT_MAX, bestY = 0;
+	for (size_t i = 0; i < m_skyline.size(); i++)
+	{
+		int y = Fit(i, width, height);
+		if (y < 0)
+			continue;
+		if (y + height < bestTop || (y + height == bestTop && m_skyline[i].width < bestWidth))
+		{
+			best = i;
+			bestTop = y + height;
+			bestWidth = m_skyline[i].width;
+			bestY = y;
+		}
+	}
+	if (best == SIZE_MAX)
+		return false;
+
+	position = { m_skyline[best].x, bestY };
+	m_usedArea += static_cast<long long>(width) * height;
+
+	// The new segment covers [x, x + width); trim or drop the ones it hides.
+	Segment segment = { m_skyline[best].x, bestY + height, width };
+	m_skyline.insert(m_skyline.begin() + best, segment);
+	for (size_t i = best + 1; i < m_skyline.size();)
+	{
+		auto & next = m_skyline[i];
+		int shadow = segment.x + segment.width - next.x;
+		if (shadow <= 0)
+			break;
+		if (shadow < next.width)
+		{
+			next.x += shadow;
+			next.width -= shadow;
+			break;
+		}
+		m_skyline.erase(m_skyline.begin() + i);
+	}
+
+	// Neighbours at the same height are one segment.
+	for (size_t i = 0; i + 1 < m_skyline.size();)
+	{
+		if (m_skyline[i].y == m_skyline[i + 1].y)
+		{
+			m_skyline[i].width += m_skyline[i + 1].width;
+			m_skyline.erase(m_skyline.begin() + i + 1);
+		}
+		else
+			i++;
+	}
+	return true;
+}
+
+
+void SkylinePacker::Save(BinaryWriter & writer) const
+{
+	writer.Write(static_cast<int32_t>(m_size));
+	writer.Write(static_cast<int64_t>(m_usedArea));
+	writer.Write(static_cast<uint32_t>(m_skyline.size()));
+	for (const auto & segment : m_skyline)
+	{
+		writer.Write(static_cast<int32_t>(segment.x));
+		writer.Write(static_cast<int32_t>(segment.y));
+		writer.Write(static_cast<int32_t>(segment.width));
+	}
+}
+
+
+void SkylinePacker::Load(MemoryReader & reader)
+{
+	m_size = reader.Get<int32_t>();
+	m_usedArea = reader.Get<int64_t>();
+	auto count = reader.Get<uint32_t>();
+	if (count > reader.GetRemaining() / (3 * sizeof(int32_t)))
+		throw std::out_of_range("Skyline is longer than the data");
+
+	// Pack walks the segments assuming they tile the width exactly.
+	m_skyline.resize(count);
+	int x = 0;
+	for (auto & segment : m_skyline)
+	{
+		segment.x = reader.Get<int32_t>();
+		segment.y = reader.Get<int32_t>();
+		segment.width = reader.Get<int32_t>();
+		if (segment.x != x || segment.width <= 0 || segment.y < 0 || segment.y > m_size)
+			throw std::out_of_range("Skyline segments do not tile the page");
+		x += segment.width;
+	}
+	if (x != m_size)
+		throw std::out_of_range("Skyline segments do not tile the page");
+}
+
+
+float SkylinePacker::GetOccupancy() const
+{
+	return m_size > 0 ? static_cast<float>(m_usedArea) / (static_cast<float>(m_size) * m_size) : 0.0f;
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: skylinepacker.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: SkylinePacker
+//
+// Places rectangles into a square of the given size, bottom-left first. Only
+// the top edge of what has been placed so far (the skyline) is remembered,
+// so packing costs time in the number of skyline segments rather than the
+// number of rectangles. Nothing is ever removed; a full packer is replaced.
+////////////////////////////////////////////////////////////////////////////////
+class SkylinePacker
+{
+public:
+	explicit SkylinePacker(int size = 0) { Reset(size); }
+
+	void Reset(int);
+	int GetSize() const { return m_size; }
+
+	// Finds room for a width x height rect, returning false if there is none.
+	bool Pack(int width, int height, POINT & position);
+
+	// Fraction of the square covered by the rects packed so far.
+	float GetOccupancy() const;
+
+	// Everything needed to carry on packing where this one left off.
+	void Save(BinaryWriter &) const;
+	void Load(MemoryReader &);
+
+private:
+	struct Segment
+	{
+		int x, y, width;
+	};
+
+	// The y a width wide rect would rest at if placed at segment i, or -1.
+	int Fit(size_t i, int width, int height) const;
+
+	int m_size;
+	long long m_usedArea;
+	std::vector<Segment> m_skyline;
+};
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: statetracker.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "statetracker.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstring>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "renderstats.h"
+
+
+bool StateTracker::Bind(Stage stage, size_t slot, const void * object, uint64_t details)
+{
+	auto & stats = RenderStats::Current();
+	if (slot >= SlotsPerStage)
+	{
+		stats.stateBinds++;
+		return true;
+	}
+
+	Binding & binding = m_bindings[static_cast<size_t>(stage)][slot];
+	if (binding.isKnown && binding.object == object && binding.details == details)
+	{
+		stats.stateBindsSkipped++;
+		return false;
+	}
+
+	binding = { object, details, true };
+	stats.stateBinds++;
+	return true;
+}
+
+
+bool StateTracker::Update(const void * buffer, const void * data, size_t size)
+{
+	auto & stats = RenderStats::Current();
+	auto & contents = m_contents[buffer];
+	if (contents.size() == size && std::memcmp(contents.data(), data, size) == 0)
+	{
+		stats.constantUploadsSkipped++;
+		return false;
+	}
+
+	auto bytes = static_cast<const std::byte *>(data);
+	contents.assign(bytes, bytes + size);
+	stats.constantUploads++;
+	return true;
+}
+
+
+// The shadow copies go too: a buffer released between frames could have
+// its address reused by a new one that was never written.
+void StateTracker::Invalidate()
+{
+	for (auto & stage : m_bindings)
+		for (auto & binding : stage)
+			binding = Binding();
+	m_contents.clear();
+}
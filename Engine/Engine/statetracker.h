@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: statetracker.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: StateTracker
+//
+// Remembers what is bound where and what was last written to each constant
+// buffer, to tell RenderState which calls would change nothing. Objects are
+// opaque pointers here, so it knows nothing of D3D. Everything it skips or
+// lets through is counted in RenderStats.
+//
+// It trusts that nothing is bound behind its back. Binding render targets
+// can make D3D unbind shader resources, so Invalidate is called whenever
+// they change, and at the start of every frame.
+////////////////////////////////////////////////////////////////////////////////
+class StateTracker
+{
+public:
+	enum class Stage
+	{
+		InputLayout,
+		VertexShader,
+		PixelShader,
+		Topology,
+		IndexBuffer,
+		VertexBuffer,
+		VertexResource,
+		PixelResource,
+		PixelSampler,
+		VertexConstants,
+		PixelConstants,
+		Count
+	};
+
+	// Higher slots are not tracked and always bound.
+	static const size_t SlotsPerStage = 4;
+
+	// True if the slot held something else, or the same object with other
+	// details, such as a vertex buffer's stride. It holds the new one after.
+	bool Bind(Stage, size_t slot, const void * object, uint64_t details = 0);
+
+	// True if size bytes of data differ from what was last written to buffer.
+	bool Update(const void * buffer, const void * data, size_t size);
+
+	// Forgets everything, so every later call goes through.
+	void Invalidate();
+
+private:
+	struct Binding
+	{
+		const void * object = nullptr;
+		uint64_t details = 0;
+		bool isKnown = false;
+	};
+
+	Binding m_bindings[static_cast<size_t>(Stage::Count)][SlotsPerStage];
+	std::unordered_map<const void *, std::vector<std::byte>> m_contents;
+};
@@ -17,27 +17,31 @@ SystemClass::SystemClass()
 		m_Input = new InputClass(m_hinstance, m_hwnd);
 		auto camera = new CameraClass(m_Input, screenWidth, screenHeight);
 		m_Graphics = new GraphicsClass(camera, screenWidth, screenHeight, 1, m_hwnd, &m_Settings);
-
-		m_gameObjects.push_back(new CpuClass(m_Input, camera, m_Graphics->GetText()));
 		m_gameObjects.push_back(camera);
 		m_gameObjects.push_back(m_Input);
 		m_gameObjects.push_back(m_Graphics);
 
-		std::ifstream file;
-		file.open("autosave.bin", std::ios_base::binary);
-		if (file.is_open())
+		// Closed before everything came in.
+		if (!WaitForAssets())
+			return;
+		m_gameObjects.insert(m_gameObjects.begin(), new CpuClass(m_Input, camera, m_Graphics->GetText(), m_Settings));
+
+		// Objects with little state share one chunk, written one after the
+		// other as before.
+		if (m_saveFile.Load(AutosavePath))
 		{
-			BinaryReader reader(file);
+			m_saveFile.ReadChunk(ObjectsChunk, [&](BinaryReader & reader) {
+				for (const auto & gameObject : m_gameObjects)
+					gameObject->Load(reader);
+			});
 			for (const auto & gameObject : m_gameObjects)
-				gameObject->Load(reader);
+				gameObject->Load(m_saveFile);
+			m_saveState = m_saveFile;
 		}
-		file.close();
-
-		// Fire up the autosave thread.
-		thread_to_save_file = std::thread(&SystemClass::Autosave, this);
 
-		// Allow the autosave loop to start.
+		// Allow the autosave loop to start, then fire up its thread.
 		m_keepSavingFile.store(true);
+		thread_to_save_file = std::thread(&SystemClass::Autosave, this);
 
 		// Game can start now.
 		Run();
@@ -55,8 +59,13 @@ SystemClass::SystemClass()
 
 SystemClass::~SystemClass()
 {
-	// End the autosave loop.
-	m_keepSavingFile.store(false);
+	// End the autosave loop, waking it if it sleeps or waits for a
+	// snapshot.
+	{
+		std::lock_guard<std::mutex> lock(m_snapshotMutex);
+		m_keepSavingFile.store(false);
+	}
+	m_snapshotSignal.notify_all();
 
 	// All GameObjects must be ended.
 	for (auto gameObject : m_gameObjects)
@@ -69,43 +78,86 @@ SystemClass::~SystemClass()
 	ShutdownWindows();
 
 	// Wait until the autosave thread finishes.	
-	thread_to_save_file.join();
+	if (thread_to_save_file.joinable())
+		thread_to_save_file.join();
+}
+
+
+// Sleeping is only as precise as the system timer, so the last stretch
+// is spun instead.
+static void WaitUntil(TickScheduler::TimePoint time)
+{
+	using namespace std::chrono_literals;
+	auto margin = 2ms;
+	auto now = TickScheduler::Clock::now();
+	if (time - now > margin)
+		std::this_thread::sleep_for(time - now - margin);
+	while (TickScheduler::Clock::now() < time)
+		std::this_thread::yield();
 }
 
 
 void SystemClass::Run()
 {
 	MSG msg;
+	TickScheduler scheduler(TicksPerSecond);
+	scheduler.SetFrameRateLimit(m_Settings.maxFrameRate);
+	Profiler::SetThreadName("Game");
+
+	// Loose enough for chunk streaming and the overlay, so only something
+	// that starts allocating far more than it did goes over.
+	using Subsystem = AllocationTracker::Subsystem;
+	AllocationTracker::SetBudget(Subsystem::Tiles, { 4096, 16 << 20, 0 });
+	AllocationTracker::SetBudget(Subsystem::Text, { 256, 64 << 10, 0 });
+	AllocationTracker::SetBudget(Subsystem::Gui, { 64, 64 << 10, 0 });
 
 	// Loop until there is a quit message from the window or the user.
 	bool done = false;
 	while (!done)
 	{
-		// Handle the windows messages.
-		if (!m_isGameHalted && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		// Oh, but we minimized, so freeze while waiting for a message.
+		if (m_isGameHalted)
 		{
-			TranslateMessage(&msg);
-			DispatchMessage(&msg);
+			if (GetMessage(&msg, 0, 0, 0) > 0)
+			{
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+			else
+				done = true;
 		}
-		// Oh, but we minimized, so freeze while waiting for a message.
-		else if (m_isGameHalted && GetMessage(&msg, 0, 0, 0))
+
+		// Handle every waiting windows message before the next frame. If
+		// windows signals to end the application then exit out.
+		while (!done && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
+			if (msg.message == WM_QUIT)
+				done = true;
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
 
-		// If windows signals to end the application then exit out.
-		if (msg.message == WM_QUIT)
-		{
-			done = true;
-		}
-		else if (!m_isGameHalted)
+		if (!done && !m_isGameHalted)
 		{
 			// Otherwise do the frame processing.  If frame processing fails then exit.
 			try
 			{
+				PROFILE_SCOPE("Frame");
 				m_Graphics->SetPausedState(!m_isGameActive);
 
+				// The simulation catches up in fixed steps, then the frame
+				// is drawn between the last two of them.
+				size_t ticks = scheduler.BeginFrame();
+				for (size_t i = 0; i < ticks; i++)
+				{
+					PROFILE_SCOPE("Tick");
+					for (const auto & gameObject : m_gameObjects)
+						gameObject->Tick(scheduler.GetTickSeconds());
+				}
+
+				for (const auto & gameObject : m_gameObjects)
+					gameObject->Interpolate(scheduler.GetAlpha());
+
 				for (const auto & gameObject : m_gameObjects)
 				{
 					gameObject->Frame();
@@ -119,12 +171,69 @@ void SystemClass::Run()
 				MessageBoxA(m_hwnd, buf, "Error", MB_OK | MB_ICONERROR);
 				done = true;
 			}
+
+			// What the overlay shows next frame.
+			Profiler::EndFrame();
+			AllocationTracker::EndFrame();
 		}
 
+		// Between frames nothing is half changed. While halted this waits
+		// for the next message, but then nothing changes either.
+		if (m_isSnapshotWanted)
+			TakeSnapshot();
+
 		// Check if the user pressed escape and wants to exit the application.
 		if (m_Input->IsKeyDown(VK_ESCAPE))
 			done = true;
+
+		if (!done && !m_isGameHalted)
+			WaitUntil(scheduler.GetNextFrameTime());
+	}
+}
+
+
+// Only chunks marked changed are serialised again, so the pause is as long
+// as the few tiles clicked since the last one take, plus the camera.
+void SystemClass::TakeSnapshot()
+{
+	PROFILE_SCOPE("SystemClass::TakeSnapshot");
+	ALLOCATION_SCOPE(Io);
+
+	auto start = std::chrono::steady_clock::now();
+	m_saveState.WriteChunk(ObjectsChunk, [&](BinaryWriter & writer) {
+		for (const auto & gameObject : m_gameObjects)
+			gameObject->Save(writer);
+	});
+	for (const auto & gameObject : m_gameObjects)
+		gameObject->Save(m_saveState);
+	Snapshot snapshot{ m_saveState.TakeChanges(), std::chrono::steady_clock::now() - start };
+
+	{
+		std::lock_guard<std::mutex> lock(m_snapshotMutex);
+		m_snapshot = std::move(snapshot);
+		m_isSnapshotWanted = false;
+	}
+	m_snapshotSignal.notify_all();
+}
+
+
+// Keeps the window responsive, drawing the loading screen, until the
+// graphics have all their assets. False if the window was closed first.
+bool SystemClass::WaitForAssets()
+{
+	MSG msg = {};
+	while (!m_Graphics->IsLoaded())
+	{
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
+		{
+			if (msg.message == WM_QUIT)
+				return false;
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+		m_Graphics->Frame();
 	}
+	return true;
 }
 
 
@@ -247,9 +356,12 @@ LRESULT CALLBACK SystemClass::MessageHandler(HWND hwnd, UINT umsg, WPARAM wparam
 	case WM_MBUTTONUP:
 	case WM_XBUTTONDOWN:
 	case WM_XBUTTONUP:
+	{
+		ALLOCATION_SCOPE(Gui);
 		m_Input->WndMouse(umsg, wparam);
 		m_Graphics->Click(m_Input->GetKeys(), m_Input->GetMousePosition());
 		break;
+	}
 
 	case WM_MOUSEWHEEL:
 		m_Input->WndMouseWheel(GET_WHEEL_DELTA_WPARAM(wparam));
@@ -322,42 +434,51 @@ void SystemClass::Autosave()
 	bool canRetry = false;
 	const auto retryTime = 1s;
 	auto spinTime = 5s;
-	std::ofstream file;
-	file.exceptions(std::fstream::failbit | std::fstream::badbit);
+	Profiler::SetThreadName("Autosave");
+	ALLOCATION_SCOPE(Io);
 
 	while (true)
 	{
-		std::this_thread::sleep_for(canRetry ? retryTime : spinTime);
-		canRetry = false;
-		if (m_keepSavingFile)
+		Snapshot snapshot;
 		{
-			try
-			{
-				file.open("autosave.bin", std::ios_base::binary);
-				BinaryWriter writer(file);
-				for (const auto & gameObject : m_gameObjects)
-					gameObject->Save(writer);
-				file.close();
-			}
-			catch (const std::ios_base::failure & e)
+			std::unique_lock<std::mutex> lock(m_snapshotMutex);
+			m_snapshotSignal.wait_for(lock, canRetry ? retryTime : spinTime, [&]() { return !m_keepSavingFile; });
+			canRetry = false;
+
+			// The game thread takes it at the end of its next frame.
+			m_isSnapshotWanted = true;
+			m_snapshotSignal.wait(lock, [&]() { return m_snapshot || !m_keepSavingFile; });
+			if (!m_keepSavingFile)
+				break;
+			snapshot = std::move(*m_snapshot);
+			m_snapshot.reset();
+		}
+
+		// Changes from a failed save stay marked in m_saveFile, so the next
+		// one writes them as well.
+		m_saveFile.Apply(snapshot.changes);
+		try
+		{
+			auto stats = m_saveFile.Save(AutosavePath);
+			std::clog << FormatString("Autosave: game paused %.0f us, %zu of %zu chunks changed, %zu bytes written in %.2f ms",
+				snapshot.pause.count(), stats.chunksChanged, stats.chunks, stats.bytesWritten, stats.time.count()).data() << std::endl;
+		}
+		catch (const std::exception & e)
+		{
+			switch (MessageBoxA(
+				m_hwnd, e.what(), "Autosave error",
+				MB_ABORTRETRYIGNORE | MB_ICONERROR | MB_DEFBUTTON2
+			))
 			{
-				switch (MessageBoxA(
-					m_hwnd, e.what(), "Autosave error",
-					MB_ABORTRETRYIGNORE | MB_ICONERROR | MB_DEFBUTTON2
-				))
-				{
-				case IDABORT:
-					m_keepSavingFile = false;
-					break;
+			case IDABORT:
+				m_keepSavingFile = false;
+				break;
 
-				case IDRETRY:
-					canRetry = true;
-					break;
-				}
+			case IDRETRY:
+				canRetry = true;
+				break;
 			}
 		}
-		else
-			break;
 	}
 }
 
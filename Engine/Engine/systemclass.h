@@ -60,6 +60,9 @@
 #include <thread>
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
 
 
 ///////////////////////
@@ -72,6 +75,8 @@
 #include "graphicsclass.h"
 
 #include "cpuclass.h"
+#include "savefile.h"
+#include "tickscheduler.h"
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -87,6 +92,8 @@ public:
 
 private:
 	void Run();
+	void TakeSnapshot();
+	bool WaitForAssets();
 	void InitializeWindows(int&, int&);
 	void InitializeScaling();
 	void ShutdownWindows();
@@ -103,6 +110,29 @@ private:
 	std::thread thread_to_save_file;
 	std::atomic<bool> m_keepSavingFile = false;
 
+	static constexpr double TicksPerSecond = 60.0;
+	static constexpr const char * AutosavePath = "autosave.bin";
+	static constexpr SaveFile::ChunkId ObjectsChunk = SaveFile::MakeChunkId('O', 0);
+
+	// What changed in the game since the last snapshot, and how long the
+	// game thread stopped to collect it.
+	struct Snapshot
+	{
+		std::vector<SaveFile::Change> changes;
+		std::chrono::duration<double, std::micro> pause;
+	};
+
+	// The game objects are only ever saved on the game thread, between two
+	// frames, into m_saveState. The autosave thread asks for a snapshot of
+	// what changed there, and applies it to m_saveFile, which only it
+	// touches, before writing that out. The two share chunk bytes, never
+	// copying them.
+	SaveFile m_saveState, m_saveFile;
+	std::mutex m_snapshotMutex;
+	std::condition_variable m_snapshotSignal;
+	std::atomic<bool> m_isSnapshotWanted = false;
+	std::optional<Snapshot> m_snapshot;
+
 	bool m_isGameActive = false;
 	bool m_isGameHalted = false;
 	bool m_isGameLoaded = false;
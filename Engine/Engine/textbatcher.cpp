@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: textbatcher.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "textbatcher.h"
+
+
+static bool SameColor(const DirectX::XMFLOAT4 & a, const DirectX::XMFLOAT4 & b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z && a.w == b.w;
+}
+
+
+size_t TextBatcher::Add()
+{
+	m_sentences.emplace_back();
+	m_dirty = true;
+	return m_sentences.size() - 1;
+}
+
+
+void TextBatcher::Remove(size_t first, size_t last)
+{
+	m_sentences.erase(m_sentences.begin() + first, m_sentences.begin() + last);
+	m_dirty = true;
+}
+
+
+bool TextBatcher::Update(size_t id, FontAtlas & atlas, size_t font, std::string_view text,
+	float x, float y, const DirectX::XMFLOAT4 & color, float scale, float maxWidth)
+{
+	auto & sentence = m_sentences[id];
+	if (sentence.font == font && sentence.x == x && sentence.y == y &&
+		sentence.scale == scale && sentence.maxWidth == maxWidth &&
+		SameColor(sentence.color, color) && sentence.text == text)
+	{
+		m_stats.skippedUpdates++;
+		return false;
+	}
+
+	sentence.text = text;
+	sentence.x = x;
+	sentence.y = y;
+	sentence.scale = scale;
+	sentence.maxWidth = maxWidth;
+	sentence.color = color;
+	sentence.font = font;
+
+	atlas.Layout(text, m_layout, scale, maxWidth);
+	sentence.width = m_layout.width;
+
+	// Spaces take no quad, so this is an upper bound.
+	sentence.quads.resize(4 * m_layout.glyphs.size());
+	size_t glyphs = atlas.BuildVertexArray(sentence.quads.data(), m_layout, x, y);
+	sentence.quads.resize(4 * glyphs);
+
+	m_stats.rebuiltGlyphs += glyphs;
+	m_dirty = true;
+	return true;
+}
+
+
+void TextBatcher::Build(std::vector<VertexType> & vertices, std::vector<Draw> & draws)
+{
+	vertices.clear();
+	draws.clear();
+
+	// Only a handful of font and colour pairs are ever on screen, so a linear
+	// search for the group beats sorting.
+	std::vector<bool> done(m_sentences.size());
+	for (size_t i = 0; i < m_sentences.size(); i++)
+	{
+		if (done[i])
+			continue;
+
+		const auto & key = m_sentences[i];
+		Draw draw = { key.font, key.color, vertices.size() / 4, 0 };
+		for (size_t j = i; j < m_sentences.size(); j++)
+		{
+			const auto & sentence = m_sentences[j];
+			if (done[j] || sentence.font != key.font || !SameColor(sentence.color, key.color))
+				continue;
+			done[j] = true;
+			vertices.insert(vertices.end(), sentence.quads.begin(), sentence.quads.end());
+		}
+		draw.quadCount = vertices.size() / 4 - draw.firstQuad;
+		if (draw.quadCount > 0)
+			draws.push_back(draw);
+	}
+
+	m_dirty = false;
+}
+
+
+TextBatcher::Stats TextBatcher::TakeStats()
+{
+	Stats stats = m_stats;
+	m_stats = Stats();
+	return stats;
+}
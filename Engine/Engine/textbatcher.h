@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: textbatcher.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "fontatlas.h"
+#include "vertextypes.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TextBatcher
+//
+// Keeps the glyph quads of every sentence on screen and merges them into one
+// vertex array, with one draw per font and colour. A sentence is only laid
+// out again when its text, position, colour or font actually changes, so
+// the debug overlay rewriting the same strings every frame costs nothing.
+////////////////////////////////////////////////////////////////////////////////
+class TextBatcher
+{
+public:
+	// One DrawIndexed: quadCount glyphs starting at firstQuad in the array
+	// Build produced, all drawn with the same font texture and colour.
+	struct Draw
+	{
+		size_t font;
+		DirectX::XMFLOAT4 color;
+		size_t firstQuad, quadCount;
+	};
+
+	struct Stats
+	{
+		size_t rebuiltGlyphs = 0;
+		size_t skippedUpdates = 0;
+	};
+
+	// Returns the new sentence's id; ids stay valid until it is removed.
+	size_t Add();
+	void Remove(size_t first, size_t last);
+	void Pop() { Remove(m_sentences.size() - 1, m_sentences.size()); }
+	size_t GetCount() const { return m_sentences.size(); }
+	const std::string & GetText(size_t id) const { return m_sentences[id].text; }
+
+	// Of the sentence's widest line, as of its last layout.
+	float GetWidth(size_t id) const { return m_sentences[id].width; }
+
+	// Lays the sentence out with atlas unless nothing changed since last
+	// time, wrapping it at maxWidth if that is above 0. Returns whether it
+	// did.
+	bool Update(size_t id, FontAtlas & atlas, size_t font, std::string_view text,
+		float x, float y, const DirectX::XMFLOAT4 & color, float scale = 1.0f, float maxWidth = 0.0f);
+
+	// True when the output of Build would differ from the last call.
+	bool IsDirty() const { return m_dirty; }
+
+	// Concatenates the quads of all sentences, grouped so each font and
+	// colour pair is contiguous and can be drawn in one call.
+	void Build(std::vector<VertexType> &, std::vector<Draw> &);
+
+	// Counts since the last call.
+	Stats TakeStats();
+
+private:
+	struct Sentence
+	{
+		std::string text;
+		float x = 0, y = 0, scale = 0, maxWidth = 0, width = 0;
+		DirectX::XMFLOAT4 color = { 0, 0, 0, 0 };
+		size_t font = SIZE_MAX;
+		std::vector<VertexType> quads;
+	};
+
+	std::vector<Sentence> m_sentences;
+	FontAtlas::TextLayout m_layout;
+	bool m_dirty = true;
+	Stats m_stats;
+};
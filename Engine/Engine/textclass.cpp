@@ -13,35 +13,22 @@ TextClass::TextClass(
 	m_screenWidth(screenWidth),
 	m_screenHeight(screenHeight),
 	m_baseViewMatrix(baseViewMatrix),
-	m_FontShader(device, deviceContext, "FontPixelShader"),
+	m_FontShader(device, deviceContext, "SDFPixelShader"),
 	m_Bitmap(device, deviceContext, p_FontShader, screenWidth, screenHeight),
 	m_FontManager(p_fontManager)
 {
-	for (int i = 0; i < 5; i++)
-	{
-		try
-		{
-			auto sentence = SentenceType();
-			sentence.texidx = i < 4 ? 1 : 2;
-			InitializeSentence(sentence, 32);
-			m_sentences.push_back(sentence);
-		}
-		catch (std::exception & e)
-		{
-			throw std::runtime_error(
-				FormatString(
-					"%s\n\nCould not load sentence %d",
-					e.what(), i
-				).data()
-			);
-		}
-	}
+	// The five overlay lines, the paused banner, the profile and the
+	// allocations, filled in by the setters.
+	for (int i = 0; i < 8; i++)
+		m_text.Add();
 	CreateColoredRects();
 }
 
 
 void TextClass::CreateColoredRects()
 {
+	ALLOCATION_SCOPE(Gui);
+
 	int
 		width = 400,
 		height = ui::ScaleX(50),
@@ -50,7 +37,7 @@ void TextClass::CreateColoredRects()
 
 	DirectX::XMFLOAT4 black = { 0, 0, 0, 0.5f };
 	std::vector<Geometry::ColoredRect<int>> vec;
-	vec.emplace_back(ui::ScaleX(30), ui::ScaleX(10), ui::ScaleX(160), ui::ScaleX(95), black);
+	vec.emplace_back(ui::ScaleX(30), ui::ScaleX(10), ui::ScaleX(160), ui::ScaleX(145), black);
 	vec.emplace_back(0, top, m_screenWidth, ui::ScaleX(50), black, true);
 	vec.emplace_back(0, top, m_screenWidth, ui::ScaleX(1), Colors::White, true);
 	vec.emplace_back(0, top + height, m_screenWidth, ui::ScaleX(1), Colors::White, true);
@@ -62,7 +49,7 @@ void TextClass::CreateColoredRects()
 	auto txtPos = listView->UpdateItems(std::move(items), m_FontManager->GetFont(2u));
 	for (size_t i = 0; i < txtPos->size(); i++) 
 		AddSentence(std::get<0>(txtPos->at(i)), std::get<1>(txtPos->at(i)),
-			std::get<2>(txtPos->at(i)) + ui::ScaleX(15.0f), 2u);
+			std::get<2>(txtPos->at(i)) + ui::ScaleX(15.0f), 2u, std::get<3>(txtPos->at(i)));
 	for (auto & sprite : listView->GetSprites())
 	{
 		vec.push_back(sprite);
@@ -73,119 +60,122 @@ void TextClass::CreateColoredRects()
 
 void TextClass::RenderUI(const DirectX::XMMATRIX & worldMatrix, const DirectX::XMMATRIX & orthoMatrix)
 {
-	int i = 0;
+	PROFILE_SCOPE("TextClass::RenderUI");
+	ALLOCATION_SCOPE(Text);
+
 	m_Bitmap.Render(worldMatrix, orthoMatrix, m_baseViewMatrix);
+	RenderText(worldMatrix, orthoMatrix);
+
+	// The widths come from the last layout, so nothing is measured per frame.
 	int width = 0;
-	for (auto & sentence : m_sentences)
-	{
-		if (i++ < 4)
-			width = std::max(width, static_cast<int>(m_FontManager->GetFont(1)->MeasureString(sentence.text.c_str()).x));
-		RenderSentence(sentence, worldMatrix, orthoMatrix);
-	}
-	m_Bitmap.UpdateColoredRect(0, { { ui::ScaleX(10), ui::ScaleX(10), width + ui::ScaleX(10), ui::ScaleX(85) },{ 0, 0, 0, 0.5f } });
+	for (size_t i : { 0, 1, 2, 3, 4, 6, 7 })
+		width = std::max(width, static_cast<int>(m_text.GetWidth(i) + 0.5f));
+	int height = ui::ScaleX(145) + static_cast<int>(ui::ScaleX(20.0f) * (m_allocationLines + m_profileLines));
+	m_Bitmap.UpdateColoredRect(0, { { ui::ScaleX(10), ui::ScaleX(10), width + ui::ScaleX(10), height },{ 0, 0, 0, 0.5f } });
 }
 
 
-void TextClass::InitializeSentence(SentenceType & sentence, int maxLength)
+void TextClass::UpdateSentence(size_t id, size_t font, const char* text,
+	float positionX, float positionY, const DirectX::XMVECTORF32 & color, float maxWidth)
 {
-	sentence.maxLength = maxLength;
-	sentence.vertexCount = 4 * maxLength;
-	sentence.indexCount = 6 * maxLength;
-
-	// Create the vertex buffer.
-	D3D11_BUFFER_DESC vertexBufferDesc =
-	{
-		sizeof(VertexType) * sentence.vertexCount,
-		D3D11_USAGE_DYNAMIC,
-		D3D11_BIND_VERTEX_BUFFER,
-		D3D11_CPU_ACCESS_WRITE
-	};
-	D3D11_SUBRESOURCE_DATA vertexData = { std::vector<VertexType>(sentence.vertexCount).data() };
-	ThrowIfFailed(
-		device->CreateBuffer(&vertexBufferDesc, &vertexData, sentence.vertexBuffer.GetAddressOf()),
-		"Could not create the vertex buffer."
-	);
+	ALLOCATION_SCOPE(Text);
 
-	D3D11_BUFFER_DESC indexBufferDesc = 
-	{
-		sizeof(unsigned long) * sentence.indexCount,
-		D3D11_USAGE_DEFAULT,
-		D3D11_BIND_INDEX_BUFFER
-	};
-
-	auto indices = std::vector<unsigned long>(sentence.indexCount);
-	std::iota(indices.begin(), indices.end(), 0);
+	// Calculate the X and Y pixel position on the screen to start drawing to.
+	float drawX = -(m_screenWidth >> 1) + positionX;
+	float drawY = (m_screenHeight >> 1) - positionY;
 
-	D3D11_SUBRESOURCE_DATA indexData = { indices.data() };
+	DirectX::XMFLOAT4 pixelColor;
+	DirectX::XMStoreFloat4(&pixelColor, color);
 
-	ThrowIfFailed(
-		device->CreateBuffer(&indexBufferDesc, &indexData, sentence.indexBuffer.GetAddressOf()),
-		"Could not create the index buffer."
-	);
+	// Lays the text out again only if something about it changed.
+	auto sentenceFont = m_FontManager->GetFont(static_cast<int>(font));
+	m_text.Update(id, sentenceFont->GetAtlas(), font, text, drawX, drawY, pixelColor, sentenceFont->GetScale(), maxWidth);
 }
 
 
-void TextClass::UpdateSentence(SentenceType & sentence, const char* text, 
-	float positionX, float positionY, const DirectX::XMVECTORF32 & color)
+void TextClass::UploadText()
 {
-	D3D11_MAPPED_SUBRESOURCE mappedResource;
-	static bool hasLoggedError = false;
+	m_text.Build(m_textVertices, m_textDraws);
+
+	size_t quads = m_textVertices.size() / 4, longestDraw = 0;
+	for (const auto & draw : m_textDraws)
+		longestDraw = std::max(longestDraw, draw.quadCount);
+	if (quads == 0)
+		return;
 
-	sentence.color = color;
-	sentence.text = text;
-		
-	// Check for possible buffer overflow.
-	if (strlen(text) > sentence.maxLength)
+	if (m_textVertexBuffer == nullptr || quads > m_textCapacity)
 	{
-		text = std::string(text).substr(0, sentence.maxLength - 1).c_str();
-		if (!hasLoggedError)
+		m_textCapacity = std::max(m_textCapacity, MinTextQuads);
+		while (m_textCapacity < quads)
+			m_textCapacity *= 2;
+
+		D3D11_BUFFER_DESC vertexBufferDesc =
 		{
-			throw std::out_of_range("Buffer overflow");
-			hasLoggedError = true;
-		}
+			static_cast<UINT>(sizeof(VertexType) * 4 * m_textCapacity),
+			D3D11_USAGE_DYNAMIC,
+			D3D11_BIND_VERTEX_BUFFER,
+			D3D11_CPU_ACCESS_WRITE
+		};
+		ThrowIfFailed(
+			device->CreateBuffer(&vertexBufferDesc, NULL, m_textVertexBuffer.ReleaseAndGetAddressOf()),
+			"Could not create the text vertex buffer."
+		);
 	}
 
-	// Calculate the X and Y pixel position on the screen to start drawing to.
-	float drawX = -(m_screenWidth >> 1) + positionX;
-	float drawY = (m_screenHeight >> 1) - positionY;
+	// Each draw starts at its own base vertex, so the indices only have to
+	// cover the longest one.
+	m_textIndices = QuadIndexBuffer::Get(device, longestDraw);
 
-	// Lock the vertex buffer so it can be written to.
+	D3D11_MAPPED_SUBRESOURCE mappedResource;
 	ThrowIfFailed(
-		deviceContext->Map(sentence.vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
-		"Could not lock the vertex buffer."
+		deviceContext->Map(m_textVertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource),
+		"Could not lock the text vertex buffer."
 	);
+	std::memcpy(mappedResource.pData, m_textVertices.data(), sizeof(VertexType) * m_textVertices.size());
+	deviceContext->Unmap(m_textVertexBuffer.Get(), 0);
 
-	// Clear the vertex buffer.
-	std::memset(mappedResource.pData, 0, (sizeof(VertexType) * sentence.vertexCount));
-
-	// Use the font class to build the vertex array from the sentence text and sentence draw location.
-	m_FontManager->GetFont(sentence.texidx)->BuildVertexArray(mappedResource.pData, text, drawX, drawY);
-
-	// Unlock the vertex buffer.
-	deviceContext->Unmap(sentence.vertexBuffer.Get(), 0);
+	RenderStats::Current().bytesUploaded += sizeof(VertexType) * m_textVertices.size();
+	RenderStats::Current().uploads++;
 }
 
 
-void TextClass::RenderSentence(
-	const SentenceType & sentence, 
+void TextClass::RenderText(
 	const DirectX::XMMATRIX & worldMatrix,
 	const DirectX::XMMATRIX & orthoMatrix
 )
 {
-	auto stride = sizeof(VertexType), offset = 0u;
+	if (m_text.IsDirty())
+		UploadText();
+
+	auto & stats = RenderStats::Current();
+	stats.glyphsRebuilt += m_text.TakeStats().rebuiltGlyphs;
+	if (m_textDraws.empty())
+		return;
+
+	auto stride = static_cast<UINT>(sizeof(VertexType)), offset = 0u;
 
 	// Set the vertex buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetVertexBuffers(0, 1, sentence.vertexBuffer.GetAddressOf(), &stride, &offset);
+	RenderState::SetVertexBuffers(deviceContext, 1, m_textVertexBuffer.GetAddressOf(), &stride, &offset);
 
 	// Set the index buffer to active in the input assembler so it can be rendered.
-	deviceContext->IASetIndexBuffer(sentence.indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	RenderState::SetIndexBuffer(deviceContext, m_textIndices.buffer.Get(), m_textIndices.format);
 
 	// Set the type of primitive that should be rendered from this vertex buffer, in this case triangles.
-	deviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	RenderState::SetTopology(deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-	// Render the text using the font shader.
-	m_FontShader.Render(sentence.indexCount, worldMatrix, m_baseViewMatrix,
-		orthoMatrix, m_FontManager->GetFont(sentence.texidx)->GetTexture(), sentence.color);
+	// One draw per font and colour.
+	for (const auto & draw : m_textDraws)
+	{
+		// Laying the text out may have rasterized glyphs the texture lacks.
+		auto font = m_FontManager->GetFont(static_cast<int>(draw.font));
+		font->Upload();
+
+		const DirectX::XMVECTORF32 color = { { { draw.color.x, draw.color.y, draw.color.z, draw.color.w } } };
+		m_FontShader.Render(static_cast<int>(6 * draw.quadCount), worldMatrix, m_baseViewMatrix,
+			orthoMatrix, font->GetTexture(), color,
+			VertexFormat::Full, static_cast<int>(4 * draw.firstQuad));
+		stats.textDraws++;
+	}
 }
 
 void TextClass::ResizeBuffers(int screenWidth, int screenHeight)
@@ -195,27 +185,19 @@ void TextClass::ResizeBuffers(int screenWidth, int screenHeight)
 	CreateColoredRects();
 }
 
-void TextClass::AddSentence(const char * buf, float x, float y, size_t texidx)
+void TextClass::AddSentence(const char * buf, float x, float y, size_t texidx, float maxWidth)
 {
-	auto sentence = SentenceType();
-	sentence.texidx = texidx;
-	InitializeSentence(sentence, 24);
-	UpdateSentence(sentence, buf, x, y, DirectX::Colors::Black);
-	m_sentences.push_back(sentence);
-
-	//return m_sentences.end();
+	UpdateSentence(m_text.Add(), texidx, buf, x, y, DirectX::Colors::Black, maxWidth);
 }
 
 void TextClass::PopSentence()
 {
-	m_sentences.pop_back();
+	m_text.Pop();
 }
 
-void TextClass::RemoveSentences(
-	std::vector<SentenceType>::iterator iter1,
-	std::vector<SentenceType>::iterator iter2)
+void TextClass::RemoveSentences(size_t first, size_t last)
 {
-	m_sentences.erase(iter1, iter2);
+	m_text.Remove(first, last);
 }
 
 
@@ -226,7 +208,7 @@ void TextClass::SetMousePosition(int mouseX, int mouseY)
 	sprintf_s(buf, 24, msg, mouseX, mouseY);
 
 	// Update the sentence vertex buffer with the new string information.
-	UpdateSentence(m_sentences[0], buf, ui::ScaleX(20.0f), ui::ScaleX(25.0f), DirectX::Colors::White);
+	UpdateSentence(0, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(25.0f), DirectX::Colors::White);
 }
 
 void TextClass::SetCameraPosition(const DirectX::XMFLOAT3 & p_position)
@@ -236,26 +218,27 @@ void TextClass::SetCameraPosition(const DirectX::XMFLOAT3 & p_position)
 	sprintf_s(buf, 240, msg, p_position.x, p_position.y);
 
 	// Update the sentence vertex buffer with the new string information.
-	UpdateSentence(m_sentences[1], buf, ui::ScaleX(20.0f), ui::ScaleX(45.0f), DirectX::Colors::White);
+	UpdateSentence(1, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(45.0f), DirectX::Colors::White);
 }
 
-void TextClass::SetFps(int fps, int frameTime)
+void TextClass::SetFps(int fps, const FrameStats::Summary & frames)
 {
-	char buf[24];
-	auto msg = "FPS: %d (t=%dms)";
-	sprintf_s(buf, 24, msg, std::min(fps, 9999), frameTime);
+	char buf[80];
+	auto msg = "FPS: %d (p50 %.1f, p99 %.1f, max %.1f ms)";
+	sprintf_s(buf, 80, msg, std::min(fps, 9999), frames.p50, frames.p99, std::min(frames.max, 9999.0));
 
 	// The green found in DirectXColors.h is too dark here.
 	const DirectX::XMVECTORF32 green = { 0.0f, 1.0f, 0.0f };
 
-	const auto color = fps < 60
-		? DirectX::Colors::Yellow
-		: fps < 30
+	// A steady rate with the odd hitch in it still shows.
+	const auto color = fps < 30
 		? DirectX::Colors::Red
+		: fps < 60 || frames.hitches > 0
+		? DirectX::Colors::Yellow
 		: green;
 
 	// Update the sentence vertex buffer with the new string information.
-	UpdateSentence(m_sentences[2], buf, ui::ScaleX(20.0f), ui::ScaleX(65.0f), color);
+	UpdateSentence(2, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(65.0f), color);
 }
 
 void TextClass::SetCpu(int cpu)
@@ -265,7 +248,70 @@ void TextClass::SetCpu(int cpu)
 	sprintf_s(buf, 24, msg, cpu);
 
 	// Update the sentence vertex buffer with the new string information.
-	UpdateSentence(m_sentences[3], buf, ui::ScaleX(20.0f), ui::ScaleX(85.0f), { 0.0f, 1.0f, 0.0f });
+	UpdateSentence(3, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(85.0f), { 0.0f, 1.0f, 0.0f });
+}
+
+void TextClass::SetRenderStats(const RenderStats::Counters & stats)
+{
+	char buf[160];
+	auto msg = "Upload: %zu B in %zu, text: %zu draws\nState: %zu set, %zu skipped\nConstants: %zu written, %zu skipped";
+	sprintf_s(buf, 160, msg, stats.bytesUploaded, stats.uploads, stats.textDraws,
+		stats.stateBinds, stats.stateBindsSkipped, stats.constantUploads, stats.constantUploadsSkipped);
+
+	// Update the sentence vertex buffer with the new string information.
+	UpdateSentence(4, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(105.0f), DirectX::Colors::White);
+}
+
+void TextClass::SetProfile(const std::vector<Profiler::ScopeTotal> & scopes)
+{
+	// Each thread under its name, its scopes indented as they nest.
+	char buf[MaxProfileLines * 128];
+	int length = 0;
+	size_t lines = 0;
+	for (size_t i = 0; i < scopes.size() && lines < MaxProfileLines; i++)
+	{
+		const auto & scope = scopes[i];
+		if (i == 0 || scope.thread != scopes[i - 1].thread)
+		{
+			length += sprintf_s(buf + length, sizeof(buf) - length, "%s[%.24s]",
+				lines > 0 ? "\n" : "", Profiler::GetThreadName(scope.thread).c_str());
+			if (++lines == MaxProfileLines)
+				break;
+		}
+		length += sprintf_s(buf + length, sizeof(buf) - length, "\n%*s%.32s %.2f ms",
+			static_cast<int>(2 * std::min(scope.depth, 8u) + 2), "", scope.name, scope.nanoseconds / 1e6);
+		if (scope.calls > 1)
+			length += sprintf_s(buf + length, sizeof(buf) - length, " x%u", scope.calls);
+		lines++;
+	}
+	buf[length] = '\0';
+	m_profileLines = lines;
+
+	// Update the sentence vertex buffer with the new string information.
+	UpdateSentence(6, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(165.0f + 20.0f * m_allocationLines), DirectX::Colors::White);
+}
+
+void TextClass::SetAllocations()
+{
+	// What each subsystem allocated last frame, and the most it ever held.
+	using Subsystem = AllocationTracker::Subsystem;
+	char counts[160], peaks[160];
+	int countLength = sprintf_s(counts, sizeof(counts), "Allocs:"), peakLength = sprintf_s(peaks, sizeof(peaks), "Peak KiB:");
+	for (size_t i = 0; i < static_cast<size_t>(Subsystem::Count); i++)
+	{
+		auto subsystem = static_cast<Subsystem>(i);
+		const auto & counters = AllocationTracker::LastFrame(subsystem);
+		const char * name = AllocationTracker::GetName(subsystem);
+		countLength += sprintf_s(counts + countLength, sizeof(counts) - countLength, " %s %zu", name, counters.allocations);
+		peakLength += sprintf_s(peaks + peakLength, sizeof(peaks) - peakLength, " %s %zu", name, counters.peakBytes / 1024);
+	}
+
+	char buf[320];
+	sprintf_s(buf, sizeof(buf), "%s\n%s", counts, peaks);
+	m_allocationLines = 2;
+
+	// Update the sentence vertex buffer with the new string information.
+	UpdateSentence(7, DebugFont, buf, ui::ScaleX(20.0f), ui::ScaleX(165.0f), DirectX::Colors::White);
 }
 
 void TextClass::SetPausedState(bool isGamePaused)
@@ -281,5 +327,5 @@ void TextClass::SetPausedState(bool isGamePaused)
 		m_Bitmap.UpdateColoredRect(i, !isGamePaused);
 
 	// Update the sentence vertex buffer with the new string information.
-	UpdateSentence(m_sentences[4], buf, left, top + size.y / 2 + ui::ScaleX(25.0f), DirectX::Colors::White);
+	UpdateSentence(5, BannerFont, buf, left, top + size.y / 2 + ui::ScaleX(25.0f), DirectX::Colors::White);
 }
\ No newline at end of file
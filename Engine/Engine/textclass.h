@@ -23,19 +23,14 @@
 // MY CLASS INCLUDES //
 ///////////////////////
 #include "fontmanager.h"
+#include "framestats.h"
 #include "fontshaderclass.h"
 #include "LargeBitmap.h"
+#include "textbatcher.h"
 #include "game.h"
 #include "gui.h"
 
 
-struct SentenceType
-{
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer, indexBuffer;
-	size_t vertexCount, indexCount, maxLength, texidx;
-	std::string text = "";
-	DirectX::XMVECTORF32 color;
-};
 ////////////////////////////////////////////////////////////////////////////////
 // Class name: TextClass
 ////////////////////////////////////////////////////////////////////////////////
@@ -49,21 +44,27 @@ public:
 	void Frame() {}
 	void SetMousePosition(int, int);
 	void SetCameraPosition(const DirectX::XMFLOAT3 &);
-	void SetFps(int, int);
+	void SetFps(int, const FrameStats::Summary &);
 	void SetCpu(int);
+	void SetRenderStats(const RenderStats::Counters &);
+	void SetProfile(const std::vector<Profiler::ScopeTotal> &);
+	void SetAllocations();
 	void SetPausedState(bool);
 	void ResizeBuffers(int, int);
 
-	void AddSentence(const char *, float, float, size_t);
+	void AddSentence(const char *, float, float, size_t, float maxWidth = 0.0f);
 	void PopSentence();
-	void RemoveSentences(
-		std::vector<SentenceType>::iterator,
-		std::vector<SentenceType>::iterator);
+	void RemoveSentences(size_t, size_t);
 
 private:
-	void InitializeSentence(SentenceType &, int);
-	void UpdateSentence(SentenceType &, const char *, float, float, const DirectX::XMVECTORF32 &);
-	void RenderSentence(const SentenceType &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &);
+	void UpdateSentence(size_t, size_t, const char *, float, float, const DirectX::XMVECTORF32 &, float maxWidth = 0.0f);
+	void UploadText();
+	void RenderText(const DirectX::XMMATRIX &, const DirectX::XMMATRIX &);
+
+	// The overlay lines use the first font, the paused banner the second.
+	static const size_t DebugFont = 1, BannerFont = 2;
+	static const size_t MinTextQuads = 256;
+	static const size_t MaxProfileLines = 16;
 
 	ID3D11Device * device;
 	ID3D11DeviceContext * deviceContext;
@@ -72,7 +73,16 @@ private:
 	int m_screenWidth, m_screenHeight;
 	DirectX::XMMATRIX m_baseViewMatrix;
 	LargeBitmap m_Bitmap;
-	std::vector<SentenceType> m_sentences;
+
+	// Every sentence is drawn out of one dynamic vertex buffer that is only
+	// rewritten when some sentence changed.
+	TextBatcher m_text;
+	std::vector<VertexType> m_textVertices;
+	std::vector<TextBatcher::Draw> m_textDraws;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_textVertexBuffer;
+	QuadIndexBuffer::Binding m_textIndices;
+	size_t m_textCapacity = 0;
+	size_t m_profileLines = 0, m_allocationLines = 0;
 	std::unique_ptr<ListView> listView;
 };
 
@@ -8,9 +8,18 @@ TextureClass::TextureClass(ID3D11Device * p_device, const char * filename)
 	:
 	m_device(p_device)
 {
-	// Load the texture in.
-	DDS dds(filename);
-	CreateShaderResourceView(dds.GetWidth(), dds.GetHeight(), dds.GetPitch(), dds.GetPixels(), dds.GetFormat());
+	// Load the texture in. Every surface is uploaded straight out of the
+	// mapped file.
+	DDSFile dds(filename);
+	CreateShaderResourceView(dds);
+}
+
+
+TextureClass::TextureClass(ID3D11Device * p_device, const DDSFile & dds)
+	:
+	m_device(p_device)
+{
+	CreateShaderResourceView(dds);
 }
 
 
@@ -70,105 +79,87 @@ void TextureClass::CreateShaderResourceView(
 }
 
 
-TextureClass::DDS::DDS(const char* FilePath)
-	:
-	m_file(FilePath, std::ios::binary),
-	reader(m_file)
+void TextureClass::CreateShaderResourceView(const DDSFile & dds)
 {
-	m_file.exceptions(std::fstream::failbit | std::fstream::badbit);
-
-	// magic number
-	if (reader.Get<uint32_t>() != MakeFourCC("DDS "))
-		throw std::invalid_argument("Magic number (fourCC) not found.");
-
-	// DDSURFACEDESC2
-	DDSURFACEDESC2 header = reader.Get<DDSURFACEDESC2>();
-	if (header.ddpfPixelFormat.dwFlags & DDPF_FOURCC) 
+	std::vector<D3D11_SUBRESOURCE_DATA> resourceData;
+	resourceData.reserve(dds.GetSurfaces().size());
+	for (const DDSFile::Surface & surface : dds.GetSurfaces())
+		resourceData.push_back({ surface.pixels, surface.rowPitch, surface.slicePitch });
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC shaderResourceViewDesc = {};
+	shaderResourceViewDesc.Format = dds.GetFormat();
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	if (dds.GetDimension() == DDSFile::Dimension::Texture3D)
 	{
-		width = header.dwWidth & ~3;
-		height = header.dwHeight & ~3;
-		m_pitch = 16 * (width / 4);
-
-		m_pixels.reserve(header.dwPitchOrLinearSize);
-		reader.Read(m_pixels.data(), m_pixels.capacity());
-
-		if (MakeFourCC('D', 'X', 'T', '1') == header.ddpfPixelFormat.dwFourCC)
-		{
-			m_pitch = 8 * (width / 4);
-			m_format = DXGI_FORMAT_BC1_UNORM;
-		}
-		else if (MakeFourCC('D', 'X', 'T', '5') == header.ddpfPixelFormat.dwFourCC)
-			m_format = DXGI_FORMAT_BC3_UNORM;
-		else
-			throw std::invalid_argument("Compressed format can only be either BC1 (DXT1) or BC3 (DXT5) UNORM.");
+		D3D11_TEXTURE3D_DESC textureDesc = {};
+		textureDesc.Width = dds.GetWidth();
+		textureDesc.Height = dds.GetHeight();
+		textureDesc.Depth = dds.GetDepth();
+		textureDesc.MipLevels = dds.GetMipCount();
+		textureDesc.Format = dds.GetFormat();
+		textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture3D> texture3D;
+		ThrowIfFailed(
+			m_device->CreateTexture3D(&textureDesc, resourceData.data(), &texture3D),
+			"Could not create the texture."
+		);
+		resource = texture3D;
+
+		shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE3D;
+		shaderResourceViewDesc.Texture3D.MipLevels = dds.GetMipCount();
 	}
-	else if (header.ddpfPixelFormat.dwFlags & DDPF_RGB) {
-		width = header.dwWidth & ~3;
-		height = header.dwHeight & ~3;
-		m_pitch = header.dwFlags & DDSD_PITCH
-			? header.dwPitchOrLinearSize
-			: header.dwWidth * header.ddpfPixelFormat.dwRGBBitCount / 8;
-		m_pixels.reserve(header.dwHeight * m_pitch);
-		reader.Read(m_pixels.data(), m_pixels.capacity());
-
-		switch (header.ddpfPixelFormat.dwRGBBitCount)
+	else
+	{
+		// A 1D texture is drawn the same as a 2D one a pixel high.
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width = dds.GetWidth();
+		textureDesc.Height = dds.GetHeight();
+		textureDesc.MipLevels = dds.GetMipCount();
+		textureDesc.ArraySize = dds.GetArraySize();
+		textureDesc.Format = dds.GetFormat();
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		if (dds.IsCubeMap())
+			textureDesc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture2D;
+		ThrowIfFailed(
+			m_device->CreateTexture2D(&textureDesc, resourceData.data(), &texture2D),
+			"Could not create the texture."
+		);
+		resource = texture2D;
+
+		if (dds.IsCubeMap() && dds.GetArraySize() > 6)
 		{
-		case 32:
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBEARRAY;
+			shaderResourceViewDesc.TextureCubeArray.MipLevels = dds.GetMipCount();
+			shaderResourceViewDesc.TextureCubeArray.NumCubes = dds.GetArraySize() / 6;
+		}
+		else if (dds.IsCubeMap())
 		{
-			assert(header.ddpfPixelFormat.dwRBitMask == 0x00ff0000);
-			assert(header.ddpfPixelFormat.dwGBitMask == 0x0000ff00);
-			assert(header.ddpfPixelFormat.dwBBitMask == 0x000000ff);
-			m_format = DXGI_FORMAT_B8G8R8A8_UNORM;
-			if (header.ddpfPixelFormat.dwFlags & DDPF_ALPHAPIXELS) {
-				assert(header.ddpfPixelFormat.dwRGBAlphaBitMask == 0xff000000);
-			//	m_format = DXGI_FORMAT_R8G8B8A8_UNORM;
-			}
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+			shaderResourceViewDesc.TextureCube.MipLevels = dds.GetMipCount();
 		}
-		break;
-		case 16:
+		else if (dds.GetArraySize() > 1)
 		{
-			assert(header.ddpfPixelFormat.dwRBitMask == 0xf800);
-			assert(header.ddpfPixelFormat.dwGBitMask == 0x7e0);
-			assert(header.ddpfPixelFormat.dwBBitMask == 0x1f);
-			m_format = DXGI_FORMAT_B5G6R5_UNORM;
-			break;
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+			shaderResourceViewDesc.Texture2DArray.MipLevels = dds.GetMipCount();
+			shaderResourceViewDesc.Texture2DArray.ArraySize = dds.GetArraySize();
 		}
-
-		default:
-			throw std::invalid_argument(
-				FormatString(
-					"%d bit image not supported",
-					header.ddpfPixelFormat.dwRGBBitCount
-				).data()
-			);
-			break;
+		else
+		{
+			shaderResourceViewDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+			shaderResourceViewDesc.Texture2D.MipLevels = dds.GetMipCount();
 		}
 	}
-	else
-		throw std::invalid_argument("Only compressed formats are supported.");
-}
-
-// the first argument (a) is the least significant byte of the fourcc (endianness doesn't matter)
-// the function is evaluated at compile time if the arguments are known (no run-time overhead).
-constexpr uint32_t TextureClass::DDS::MakeFourCC(const uint8_t a, const uint8_t b, const uint8_t c, const uint8_t d) noexcept
-{
-	return (d << 24) | (c << 16) | (b << 8) | a;
-}
-
-// the last character of the argument is the most significant byte of the fourcc
-// the function is evaluated at compile time if the string argument is known (no run-time overhead).
-constexpr uint32_t TextureClass::DDS::MakeFourCC(const char p[5]) noexcept
-{
-	return (p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
-}
 
-constexpr bool TextureClass::DDS::IsBitmask(uint32_t r, uint32_t g, uint32_t b, uint32_t a, const DDPIXELFORMAT & ddsPixelFormat) const noexcept
-{
-	return
-		ddsPixelFormat.dwRBitMask == r
-		&& ddsPixelFormat.dwGBitMask == g
-		&& ddsPixelFormat.dwBBitMask == b
-		&& ddsPixelFormat.dwRGBAlphaBitMask == a;
+	ThrowIfFailed(
+		m_device->CreateShaderResourceView(resource.Get(), &shaderResourceViewDesc, &m_texture),
+		"Could not create the shader resource view."
+	);
 }
 
 
@@ -0,0 +1,71 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tickscheduler.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "tickscheduler.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <stdexcept>
+#include <utility>
+
+
+// Lengths are kept in whole clock ticks, so the same frame times always
+// add up to the same number of simulation ticks.
+static TickScheduler::Duration PerSecond(double rate)
+{
+	return std::chrono::duration_cast<TickScheduler::Duration>(std::chrono::duration<double>(1.0 / rate));
+}
+
+
+TickScheduler::TickScheduler(double ticksPerSecond, size_t maxTicksPerFrame, std::function<TimePoint()> now)
+	:
+	m_now(std::move(now)),
+	m_maxTicksPerFrame(maxTicksPerFrame)
+{
+	if (!(ticksPerSecond > 0.0) || maxTicksPerFrame == 0)
+		throw std::invalid_argument("A tick scheduler needs a positive tick rate");
+	m_tickLength = PerSecond(ticksPerSecond);
+	m_lastFrame = m_now();
+}
+
+
+size_t TickScheduler::BeginFrame()
+{
+	TimePoint now = m_now();
+	m_accumulated += now - m_lastFrame;
+	m_lastFrame = now;
+
+	auto owed = static_cast<uint64_t>(m_accumulated / m_tickLength);
+	size_t ticks = owed < m_maxTicksPerFrame ? static_cast<size_t>(owed) : m_maxTicksPerFrame;
+	m_accumulated -= m_tickLength * static_cast<Duration::rep>(owed);
+	m_droppedTicks += owed - ticks;
+	m_ticks += ticks;
+	return ticks;
+}
+
+
+float TickScheduler::GetAlpha() const
+{
+	return std::chrono::duration<float>(m_accumulated) / std::chrono::duration<float>(m_tickLength);
+}
+
+
+void TickScheduler::SetFrameRateLimit(double framesPerSecond)
+{
+	m_frameLength = framesPerSecond > 0.0 ? PerSecond(framesPerSecond) : Duration::zero();
+}
+
+
+TickScheduler::TimePoint TickScheduler::GetNextFrameTime() const
+{
+	TimePoint now = m_now();
+	if (m_frameLength == Duration::zero())
+		return now;
+
+	// A frame that already ran long starts the next one right away rather
+	// than letting later ones bunch up to make up for it.
+	TimePoint next = m_lastFrame + m_frameLength;
+	return next < now ? now : next;
+}
@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tickscheduler.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TickScheduler
+//
+// Decides how many fixed length simulation ticks each drawn frame is owed,
+// so the game advances at the same rate however fast it draws. Time left
+// over is carried into the next frame, and how far it reaches into the next
+// tick is the alpha frames are drawn at. After a stall only a few ticks are
+// caught up and the rest of the time is dropped, so a slow frame does not
+// make the next one slower still.
+//
+// Can also hold frames back to a maximum rate. The clock is passed in, so
+// tests can drive it by hand.
+////////////////////////////////////////////////////////////////////////////////
+class TickScheduler
+{
+public:
+	using Clock = std::chrono::steady_clock;
+	using Duration = Clock::duration;
+	using TimePoint = Clock::time_point;
+
+	explicit TickScheduler(double ticksPerSecond = 60.0, size_t maxTicksPerFrame = 5,
+		std::function<TimePoint()> now = Clock::now);
+
+	// Call at the start of every frame; the number of ticks to run before
+	// drawing it.
+	size_t BeginFrame();
+
+	// How far past the last tick the frame falls, from 0 up to 1.
+	float GetAlpha() const;
+
+	Duration GetTickLength() const { return m_tickLength; }
+	float GetTickSeconds() const { return std::chrono::duration<float>(m_tickLength).count(); }
+	uint64_t GetTickCount() const { return m_ticks; }
+	uint64_t GetDroppedTicks() const { return m_droppedTicks; }
+
+	// No limit at 0.
+	void SetFrameRateLimit(double framesPerSecond);
+
+	// When the next frame may begin under the limit; now without one.
+	TimePoint GetNextFrameTime() const;
+
+private:
+	std::function<TimePoint()> m_now;
+	Duration m_tickLength, m_frameLength{};
+	size_t m_maxTicksPerFrame;
+	TimePoint m_lastFrame;
+	Duration m_accumulated{};
+	uint64_t m_ticks = 0, m_droppedTicks = 0;
+};
@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tilebatch.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "tilebatch.h"
+
+
+TileBatch::SharedResources TileBatch::CreateSharedResources(
+	ID3D11Device * device, ID3D11ShaderResourceView * texture, const std::vector<RECT> & uvrects)
+{
+	SharedResources shared;
+	shared.texture = texture;
+	shared.atlasSize = uvrects.size();
+
+	// Corners in the order BuildQuadIndices expects them.
+	const DirectX::XMFLOAT2 corners[] = { { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 } };
+	D3D11_BUFFER_DESC vertexBufferDesc =
+	{
+		sizeof(corners),
+		D3D11_USAGE_IMMUTABLE,
+		D3D11_BIND_VERTEX_BUFFER
+	};
+	D3D11_SUBRESOURCE_DATA vertexData = { corners };
+	ThrowIfFailed(
+		device->CreateBuffer(&vertexBufferDesc, &vertexData, shared.quadVertices.GetAddressOf()),
+		"Could not create the tile quad vertex buffer."
+	);
+
+	auto binding = QuadIndexBuffer::Get(device, 1);
+	shared.quadIndices = binding.buffer;
+	shared.quadIndexFormat = binding.format;
+
+	// The shader indexes this directly, so keep at least one entry.
+	auto rects = std::vector<DirectX::XMFLOAT4>(std::max<size_t>(uvrects.size(), 1), { 0, 0, 0, 0 });
+	VertexBuilder::BuildAtlasRects(rects.data(), uvrects);
+	D3D11_BUFFER_DESC atlasBufferDesc =
+	{
+		static_cast<UINT>(sizeof(DirectX::XMFLOAT4) * rects.size()),
+		D3D11_USAGE_IMMUTABLE,
+		D3D11_BIND_SHADER_RESOURCE,
+		0,
+		D3D11_RESOURCE_MISC_BUFFER_STRUCTURED,
+		sizeof(DirectX::XMFLOAT4)
+	};
+	D3D11_SUBRESOURCE_DATA atlasData = { rects.data() };
+	ThrowIfFailed(
+		device->CreateBuffer(&atlasBufferDesc, &atlasData, shared.atlasRects.GetAddressOf()),
+		"Could not create the tile atlas buffer."
+	);
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC atlasViewDesc = {};
+	atlasViewDesc.Format = DXGI_FORMAT_UNKNOWN;
+	atlasViewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+	atlasViewDesc.Buffer.NumElements = static_cast<UINT>(rects.size());
+	ThrowIfFailed(
+		device->CreateShaderResourceView(shared.atlasRects.Get(), &atlasViewDesc, shared.atlas.GetAddressOf()),
+		"Could not create the tile atlas view."
+	);
+
+	return shared;
+}
+
+
+TileBatch::TileBatch(
+	ID3D11Device * p_device, ID3D11DeviceContext * p_deviceContext, ShaderClass * p_FontShader,
+	const SharedResources * p_shared, int screenWidth, int screenHeight, POINT origin)
+	:
+	m_device(p_device),
+	m_deviceContext(p_deviceContext),
+	m_FontShader(p_FontShader),
+	m_shared(p_shared),
+	m_screenWidth(screenWidth),
+	m_screenHeight(screenHeight),
+	m_origin(origin)
+{
+}
+
+
+void TileBatch::UpdateTiles(const std::vector<Geometry::ColoredRect<int>> && rects, const std::vector<int> && uvrectmap)
+{
+	m_rects = rects;
+	m_uvrectmap = uvrectmap;
+
+	if (m_instanceBuffer == nullptr || m_instances.size() != m_rects.size())
+		CreateBuffer();
+	else
+		m_dirty.Add(0, m_rects.size());
+}
+
+
+// Like the LargeBitmap setters, this only marks the tile; Render uploads it.
+void TileBatch::UpdateTile(int i, const Geometry::Rectangle<int> & position, int uvrect)
+{
+	auto & rect = m_rects[i].rect;
+	if (rect.left == position.left && rect.top == position.Top &&
+		rect.right == position.Width && rect.bottom == position.Height && m_uvrectmap[i] == uvrect)
+		return;
+	rect = { position.left, position.Top, position.Width, position.Height };
+	m_uvrectmap[i] = uvrect;
+	m_dirty.Add(i);
+}
+
+
+void TileBatch::Render(const DirectX::XMMATRIX & worldMatrix, const DirectX::XMMATRIX & orthoMatrix, const DirectX::XMMATRIX & viewMatrix)
+{
+	if (m_instances.empty())
+		return;
+
+	UpdateBuffer();
+
+	ID3D11Buffer * buffers[] = { m_shared->quadVertices.Get(), m_instanceBuffer.Get() };
+	UINT strides[] = { sizeof(DirectX::XMFLOAT2), sizeof(TileInstanceType) }, offsets[] = { 0, 0 };
+	RenderState::SetVertexBuffers(m_deviceContext, 2, buffers, strides, offsets);
+	RenderState::SetIndexBuffer(m_deviceContext, m_shared->quadIndices.Get(), m_shared->quadIndexFormat);
+	RenderState::SetTopology(m_deviceContext, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Instance positions are relative to the batch origin; put it back here.
+	auto world = DirectX::XMMatrixTranslation(static_cast<float>(m_origin.x), static_cast<float>(m_origin.y), 0.0f) * worldMatrix;
+	m_FontShader->RenderTiles(static_cast<uint32_t>(m_instances.size()), world, viewMatrix,
+		orthoMatrix, m_shared->texture.Get(), m_shared->atlas.Get());
+}
+
+
+void TileBatch::CreateBuffer()
+{
+	m_instances.assign(m_rects.size(), TileInstanceType());
+	m_dirty.Clear();
+	m_instanceBuffer = nullptr;
+	if (m_instances.empty())
+		return;
+
+	VertexBuilder::BuildTileInstances(m_instances.data(), m_rects, m_shared->atlasSize, m_uvrectmap,
+		m_screenWidth, m_screenHeight, m_origin);
+
+	D3D11_BUFFER_DESC instanceBufferDesc =
+	{
+		static_cast<UINT>(sizeof(TileInstanceType) * m_instances.size()),
+		D3D11_USAGE_DEFAULT,
+		D3D11_BIND_VERTEX_BUFFER
+	};
+	D3D11_SUBRESOURCE_DATA instanceData = { m_instances.data() };
+	ThrowIfFailed(
+		m_device->CreateBuffer(&instanceBufferDesc, &instanceData, m_instanceBuffer.GetAddressOf()),
+		"Could not create the tile instance buffer."
+	);
+	RenderStats::Current().bytesUploaded += instanceBufferDesc.ByteWidth;
+	RenderStats::Current().uploads++;
+}
+
+
+void TileBatch::UpdateBuffer()
+{
+	if (m_dirty.Empty() || m_instanceBuffer == nullptr)
+		return;
+
+	auto & stats = RenderStats::Current();
+	for (const auto & range : m_dirty.GetRanges())
+	{
+		VertexBuilder::BuildTileInstances(m_instances.data(), m_rects, m_shared->atlasSize, m_uvrectmap,
+			m_screenWidth, m_screenHeight, m_origin, range.begin, range.end - range.begin);
+
+		UINT
+			begin = static_cast<UINT>(range.begin * sizeof(TileInstanceType)),
+			end = static_cast<UINT>(range.end * sizeof(TileInstanceType));
+		D3D11_BOX box = { begin, 0, 0, end, 1, 1 };
+		m_deviceContext->UpdateSubresource(m_instanceBuffer.Get(), 0, &box, &m_instances[range.begin], 0, 0);
+
+		stats.bytesUploaded += end - begin;
+		stats.uploads++;
+	}
+	m_dirty.Clear();
+}
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tilebatch.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <d3d11.h>
+#include <vector>
+#include <wrl\client.h>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "fontshaderclass.h"
+#include "vertexbuilder.h"
+#include "dirtyranges.h"
+#include "renderstats.h"
+#include "quadindexbuffer.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TileBatch
+//
+// Draws one chunk of tiles as instances of a unit quad. Each tile costs one
+// 16 byte TileInstanceType in GPU memory and on upload, rather than the four
+// 36 byte vertices a Spritemap needs.
+////////////////////////////////////////////////////////////////////////////////
+class TileBatch
+{
+public:
+	// What every batch draws with: the unit quad, its indices, the sprite
+	// texture and the table of UV rects TileInstanceType::atlas refers to.
+	struct SharedResources
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> quadVertices, quadIndices, atlasRects;
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture, atlas;
+		DXGI_FORMAT quadIndexFormat;
+		size_t atlasSize;
+	};
+
+	static SharedResources CreateSharedResources(ID3D11Device *, ID3D11ShaderResourceView *, const std::vector<RECT> &);
+
+	TileBatch(ID3D11Device *, ID3D11DeviceContext *, ShaderClass *, const SharedResources *, int, int, POINT);
+	void UpdateTiles(const std::vector<Geometry::ColoredRect<int>> &&, const std::vector<int> &&);
+	void UpdateTile(int, const Geometry::Rectangle<int> &, int);
+	void Render(const DirectX::XMMATRIX &, const DirectX::XMMATRIX &, const DirectX::XMMATRIX &);
+
+private:
+	void CreateBuffer();
+	void UpdateBuffer();
+
+	ID3D11Device * m_device;
+	ID3D11DeviceContext * m_deviceContext;
+	ShaderClass * m_FontShader;
+	const SharedResources * m_shared;
+	int m_screenWidth, m_screenHeight;
+	POINT m_origin;
+
+	std::vector<Geometry::ColoredRect<int>> m_rects;
+	std::vector<int> m_uvrectmap;
+
+	// The CPU copy of the instance buffer and the tiles in it that changed
+	// since the last upload.
+	std::vector<TileInstanceType> m_instances;
+	DirtyRanges m_dirty;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_instanceBuffer;
+};
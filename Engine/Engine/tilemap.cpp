@@ -0,0 +1,489 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tilemap.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "tilemap.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <climits>
+#include <cstdint>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "jobsystem.h"
+#include "profiler.h"
+
+
+void TileMap::Resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	size = width * height;
+	worldwidth = width * TileSize;
+	worldheight = height * TileSize;
+	chunksAcross = (width + ChunkSize - 1) / ChunkSize;
+	chunksDown = (height + ChunkSize - 1) / ChunkSize;
+	m_chunks.clear();
+	m_edits.clear();
+	m_overlaps.clear();
+	m_loaded.clear();
+	m_changed.clear();
+	m_isSaveStale = true;
+}
+
+
+void TileMap::Generate()
+{
+	// Chunks are generated as they come into view.
+	Resize(width, height);
+}
+
+
+uint8_t TileMap::GenerateTexture(int x, int y) const
+{
+	uint8_t mappedTexture = 0;
+
+	// the sky
+	if (y < 6)
+		mappedTexture = 255;
+
+	if (x == width / 2)
+	{
+		// drill bit
+		if (y < 7)
+			mappedTexture = 255;
+		if (y == 7)
+			mappedTexture = 12;
+
+		// drill well
+		if (y == 5)
+			mappedTexture = 11;
+	}
+
+	// reception pod
+	if (y == 5)
+	{
+		if (x == ((width / 2) - 3))
+			mappedTexture = 13;
+		if (x == ((width / 2) - 2) || x == ((width / 2) - 1))
+			mappedTexture = 255;
+	}
+
+	return mappedTexture;
+}
+
+
+TileMap::Tile TileMap::MakeTile(int x, int y, uint8_t texidx) const
+{
+	// Tiles are as big as their texture, so the drill well and reception pod
+	// reach over the empty cells next to them.
+	int v = texidx == 255 ? 0 : texidx;
+	Geometry::Rectangle<int> rectangle(x * TileSize, y * TileSize, textureMap[v].right, textureMap[v].bottom);
+	return Tile(rectangle, texidx, x * height + y);
+}
+
+
+TileMap::Chunk & TileMap::LoadChunk(int index)
+{
+	Chunk & chunk = PlaceChunk(index);
+	FillChunk(chunk);
+	ActivateChunk(chunk);
+	return chunk;
+}
+
+
+TileMap::Chunk & TileMap::PlaceChunk(int index)
+{
+	Chunk & chunk = m_chunks[index];
+	chunk.index = index;
+	chunk.x = (index / chunksDown) * ChunkSize;
+	chunk.y = (index % chunksDown) * ChunkSize;
+	chunk.columns = std::min(ChunkSize, width - chunk.x);
+	chunk.rows = std::min(ChunkSize, height - chunk.y);
+	chunk.tiles.clear();
+	return chunk;
+}
+
+
+// Only reads the map, so chunks can be filled in parallel.
+void TileMap::FillChunk(Chunk & chunk) const
+{
+	chunk.tiles.reserve(chunk.columns * chunk.rows);
+
+	// Player edits move back into the resident tiles until it is evicted.
+	auto edits = m_edits.find(chunk.index);
+	for (int x = 0; x < chunk.columns; x++)
+	{
+		for (int y = 0; y < chunk.rows; y++)
+		{
+			uint8_t mappedTexture = edits != m_edits.end()
+				? edits->second[x * chunk.rows + y]
+				: GenerateTexture(chunk.x + x, chunk.y + y);
+			chunk.tiles.push_back(MakeTile(chunk.x + x, chunk.y + y, mappedTexture));
+		}
+	}
+}
+
+
+void TileMap::ActivateChunk(Chunk & chunk)
+{
+	m_edits.erase(chunk.index);
+	IndexOverlaps(chunk, true);
+	m_loaded.push_back(chunk.index);
+}
+
+
+void TileMap::EvictChunk(std::map<int, Chunk>::iterator it)
+{
+	const Chunk & chunk = it->second;
+	for (const auto & tile : chunk.tiles)
+	{
+		int x = tile.index / height, y = tile.index % height;
+		if (tile.texidx != GenerateTexture(x, y))
+		{
+			// Something was changed, so keep just the textures around.
+			std::vector<uint8_t> textures(chunk.tiles.size());
+			GetTextures(chunk.index, textures.data());
+			m_edits[chunk.index] = std::move(textures);
+			break;
+		}
+	}
+	IndexOverlaps(chunk, false);
+	m_chunks.erase(it);
+}
+
+
+void TileMap::GetTextures(int index, uint8_t * textures) const
+{
+	auto resident = m_chunks.find(index);
+	if (resident != m_chunks.end())
+	{
+		for (const auto & tile : resident->second.tiles)
+			*textures++ = tile.texidx;
+		return;
+	}
+
+	int cx = (index / chunksDown) * ChunkSize, cy = (index % chunksDown) * ChunkSize;
+	int columns = std::min(ChunkSize, width - cx), rows = std::min(ChunkSize, height - cy);
+	auto edits = m_edits.find(index);
+	if (edits != m_edits.end())
+	{
+		std::copy(edits->second.begin(), edits->second.end(), textures);
+		return;
+	}
+
+	for (int x = 0; x < columns; x++)
+		for (int y = 0; y < rows; y++)
+			*textures++ = GenerateTexture(cx + x, cy + y);
+}
+
+
+void TileMap::Stream(
+	const Geometry::Rectangle<int> & view, size_t maxLoads,
+	std::vector<int> & loaded, std::vector<int> & evicted)
+{
+	PROFILE_SCOPE("TileMap::Stream");
+
+	const int chunkPixels = ChunkSize * TileSize;
+
+	// A tile is drawn from its top left corner and may be up to three cells
+	// wide, so chunks just above and left of the view are needed as well.
+	const int loadMargin = 4 * TileSize;
+
+	// Chunks only go once they are a whole chunk past that, so panning back
+	// and forth over a border doesn't regenerate them every frame.
+	const int keepMargin = loadMargin + chunkPixels;
+
+	auto floorDiv = [](int a, int b) { return a >= 0 ? a / b : -((b - 1 - a) / b); };
+	auto inRange = [&](const Chunk & chunk, int margin) {
+		int cx = chunk.x / ChunkSize, cy = chunk.y / ChunkSize;
+		return
+			cx >= floorDiv(view.left - margin, chunkPixels) && cx <= floorDiv(view.Right + margin, chunkPixels) &&
+			cy >= floorDiv(view.Top - margin, chunkPixels) && cy <= floorDiv(view.Bottom + margin, chunkPixels);
+	};
+
+	for (auto it = m_chunks.begin(); it != m_chunks.end();)
+	{
+		if (inRange(it->second, keepMargin))
+		{
+			++it;
+			continue;
+		}
+		evicted.push_back(it->first);
+		EvictChunk(it++);
+	}
+
+	int
+		left = std::max(0, floorDiv(view.left - loadMargin, chunkPixels)),
+		right = std::min(chunksAcross - 1, floorDiv(view.Right + loadMargin, chunkPixels)),
+		top = std::max(0, floorDiv(view.Top - loadMargin, chunkPixels)),
+		bottom = std::min(chunksDown - 1, floorDiv(view.Bottom + loadMargin, chunkPixels));
+
+	std::vector<Chunk *> loads;
+	for (int cx = left; cx <= right && loads.size() < maxLoads; cx++)
+	{
+		for (int cy = top; cy <= bottom && loads.size() < maxLoads; cy++)
+		{
+			int index = ChunkIndex(cx, cy);
+			if (m_chunks.count(index) == 0)
+				loads.push_back(&PlaceChunk(index));
+		}
+	}
+
+	// Generating is the bulk of the work, one job per chunk.
+	JobSystem::Get().ParallelFor(0, loads.size(), 1, [&](size_t first, size_t last) {
+		for (size_t i = first; i < last; i++)
+			FillChunk(*loads[i]);
+	});
+	for (auto chunk : loads)
+		ActivateChunk(*chunk);
+
+	// Includes chunks GetTile had to bring in on its own.
+	loaded.insert(loaded.end(), m_loaded.begin(), m_loaded.end());
+	m_loaded.clear();
+}
+
+
+const TileMap::Chunk * TileMap::GetChunk(int index) const
+{
+	auto it = m_chunks.find(index);
+	return it != m_chunks.end() ? &it->second : nullptr;
+}
+
+
+int TileMap::LocalFromTile(int index) const
+{
+	int x = index / height, y = index % height;
+	int rows = std::min(ChunkSize, height - (y / ChunkSize) * ChunkSize);
+	return (x % ChunkSize) * rows + y % ChunkSize;
+}
+
+
+TileMap::Tile * TileMap::GetTile(int index)
+{
+	int chunk = ChunkFromTile(index);
+	auto it = m_chunks.find(chunk);
+	Chunk & resident = it != m_chunks.end() ? it->second : LoadChunk(chunk);
+	return &resident.tiles[LocalFromTile(index)];
+}
+
+
+void TileMap::IndexOverlaps(const Chunk & chunk, bool add)
+{
+	for (const auto & tile : chunk.tiles)
+	{
+		if (tile.position.Width <= TileSize && tile.position.Height <= TileSize)
+			continue;
+
+		int x0 = tile.position.left / TileSize, y0 = tile.position.Top / TileSize;
+		int x1 = std::min(width, (tile.position.left + tile.position.Width + TileSize - 1) / TileSize);
+		int y1 = std::min(height, (tile.position.Top + tile.position.Height + TileSize - 1) / TileSize);
+		for (int x = x0; x < x1; x++)
+		{
+			for (int y = y0; y < y1; y++)
+			{
+				int cell = x * height + y;
+				if (cell == tile.index)
+					continue;
+				if (add)
+				{
+					m_overlaps.emplace(cell, tile.index);
+					continue;
+				}
+				auto range = m_overlaps.equal_range(cell);
+				for (auto it = range.first; it != range.second; ++it)
+				{
+					if (it->second == tile.index)
+					{
+						m_overlaps.erase(it);
+						break;
+					}
+				}
+			}
+		}
+	}
+}
+
+
+// Looks a tile up without loading its chunk. The chunk of the previous
+// lookup is tried first since batched points tend to be close together.
+TileMap::Tile * TileMap::FindTile(int index, Chunk * & last)
+{
+	int chunk = ChunkFromTile(index);
+	if (last == nullptr || last->index != chunk)
+	{
+		auto it = m_chunks.find(chunk);
+		if (it == m_chunks.end())
+			return nullptr;
+		last = &it->second;
+	}
+	return &last->tiles[LocalFromTile(index)];
+}
+
+
+void TileMap::TilesFromWorldPoints(
+	const DirectX::XMFLOAT2 * points, size_t count,
+	int screenWidth, int screenHeight, Tile ** tiles)
+{
+	Chunk * last = nullptr;
+	for (size_t i = 0; i < count; i++)
+	{
+		tiles[i] = nullptr;
+
+		// Undo the screen centring the vertices get; doubles keep this exact
+		// for any world that fits in an int.
+		double
+			x = (double)points[i].x + (double)(screenWidth / 2),
+			y = (double)(screenHeight / 2) - (double)points[i].y;
+		if (x < 0 || y < 0 || x >= worldwidth || y >= worldheight)
+			continue;
+
+		int cell = static_cast<int>(x / TileSize) * height + static_cast<int>(y / TileSize);
+		auto hit = [&](int index) {
+			Tile * tile = FindTile(index, last);
+			if (tile == nullptr || tile->texidx == 255)
+				return false;
+			const auto & rect = tile->position;
+			return x >= rect.left && x < rect.left + rect.Width && y >= rect.Top && y < rect.Top + rect.Height;
+		};
+
+		// Overlapping tiles always start in an earlier cell, so like a scan
+		// in index order the lowest index wins.
+		int best = hit(cell) ? cell : -1;
+		auto range = m_overlaps.equal_range(cell);
+		for (auto it = range.first; it != range.second; ++it)
+			if ((best < 0 || it->second < best) && hit(it->second))
+				best = it->second;
+
+		if (best >= 0)
+			tiles[i] = FindTile(best, last);
+	}
+}
+
+
+TileMap::Tile * TileMap::TileFromWorldPoint(float x, float y, int screenWidth, int screenHeight)
+{
+	Tile * tile;
+	DirectX::XMFLOAT2 point(x, y);
+	TilesFromWorldPoints(&point, 1, screenWidth, screenHeight, &tile);
+	return tile;
+}
+
+
+std::vector<Geometry::ColoredRect<int>> TileMap::GetColoredRects(const Chunk & chunk) const
+{
+	std::vector<Geometry::ColoredRect<int>> coloredRects;
+	coloredRects.reserve(chunk.tiles.size());
+	for (const auto & tile : chunk.tiles)
+		coloredRects.emplace_back(tile.position);
+
+	return coloredRects;
+}
+
+
+std::vector<int> TileMap::GetUvRectMap(const Chunk & chunk) const
+{
+	std::vector<int> uvrectmap;
+	uvrectmap.reserve(chunk.tiles.size());
+	for (const auto & tile : chunk.tiles)
+		uvrectmap.emplace_back(tile.texidx);
+
+	return uvrectmap;
+}
+
+
+// The map's size is kept in one chunk and the textures of each changed chunk
+// of the world in another, column by column as in m_edits.
+static const SaveFile::ChunkId MapChunk = SaveFile::MakeChunkId('M', 0);
+static const char TilesChunk = 'T';
+
+
+void TileMap::Save(SaveFile & file)
+{
+	PROFILE_SCOPE("TileMap::Save");
+
+	file.WriteChunk(MapChunk, [&](BinaryWriter & writer) {
+		writer.Write(width);
+		writer.Write(height);
+	});
+
+	// After a resize chunks of the old map may still be in the file.
+	if (m_isSaveStale)
+	{
+		std::vector<SaveFile::ChunkId> stale;
+		for (const auto & chunk : file.GetChunks())
+			if (SaveFile::GetKind(chunk.first) == TilesChunk)
+				stale.push_back(chunk.first);
+		for (auto id : stale)
+			file.RemoveChunk(id);
+
+		// Chunks neither resident nor edited are as generated already.
+		for (const auto & chunk : m_chunks)
+			m_changed.insert(chunk.first);
+		for (const auto & edits : m_edits)
+			m_changed.insert(edits.first);
+		m_isSaveStale = false;
+	}
+
+	// A chunk changed back to how it was generated needs no saving.
+	std::vector<uint8_t> textures;
+	for (int chunk : m_changed)
+	{
+		int cx = (chunk / chunksDown) * ChunkSize, cy = (chunk % chunksDown) * ChunkSize;
+		int columns = std::min(ChunkSize, width - cx), rows = std::min(ChunkSize, height - cy);
+		textures.resize(columns * rows);
+		GetTextures(chunk, textures.data());
+
+		bool edited = false;
+		for (int x = 0; x < columns && !edited; x++)
+			for (int y = 0; y < rows && !edited; y++)
+				edited = textures[x * rows + y] != GenerateTexture(cx + x, cy + y);
+
+		auto id = SaveFile::MakeChunkId(TilesChunk, chunk);
+		if (edited)
+			file.SetChunk(id, textures.data(), textures.size());
+		else
+			file.RemoveChunk(id);
+	}
+	m_changed.clear();
+}
+
+
+bool TileMap::Load(const SaveFile & file)
+{
+	auto map = file.FindChunk(MapChunk);
+	if (map == nullptr)
+		return false;
+
+	MemoryReader reader(map->data(), map->size());
+	int width = reader.Get<int>();
+	int height = reader.Get<int>();
+	// Tiles are indexed with an int, so the whole map has to fit in one.
+	if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF
+		|| static_cast<int64_t>(width) * height > INT_MAX)
+		throw std::runtime_error(FormatString("Invalid tile map size %dx%d", width, height).data());
+	Resize(width, height);
+
+	for (const auto & chunk : file.GetChunks())
+	{
+		if (SaveFile::GetKind(chunk.first) != TilesChunk)
+			continue;
+
+		int index = static_cast<int>(SaveFile::GetIndex(chunk.first));
+		int cx = (index / chunksDown) * ChunkSize, cy = (index % chunksDown) * ChunkSize;
+		if (index >= chunksAcross * chunksDown ||
+			chunk.second->size() != static_cast<size_t>(std::min(ChunkSize, width - cx) * std::min(ChunkSize, height - cy)))
+			throw std::runtime_error(FormatString("Invalid tile map chunk %d", index).data());
+
+		auto textures = reinterpret_cast<const uint8_t *>(chunk.second->data());
+		m_edits[index].assign(textures, textures + chunk.second->size());
+	}
+
+	// What is in the file is what was just loaded.
+	m_isSaveStale = false;
+	return true;
+}
@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: tilemap.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "savefile.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: TileMap
+////////////////////////////////////////////////////////////////////////////////
+class TileMap
+{
+public:
+	class Tile
+	{
+	public:
+		Tile(const Geometry::Rectangle<int> position, uint8_t texidx, int index) : position(position), texidx(texidx), index(index)
+		{
+		}
+
+		Geometry::Rectangle<int> position;
+		uint8_t texidx;
+		int index;
+	};
+
+	// The world is generated, kept in memory and drawn in square chunks of
+	// ChunkSize x ChunkSize tiles; only the ones near the view are resident.
+	static constexpr int ChunkSize = 32;
+
+	class Chunk
+	{
+	public:
+		int index;
+		int x, y, columns, rows;
+		std::vector<Tile> tiles;
+	};
+
+	TileMap(const int width, const int height)
+		:
+		textureMap({
+			{ 0, 0, 128, 128 },
+			{ 0, 128, 128, 128 },
+			{ 128, 128, 128, 128 },
+			{ 256, 0, 128, 128 },
+			{ 0, 384, 128 * 3, 128 },
+			{ 128 * 7, 128 * 5, 128 * 3, 128 },
+			{ 128 * 11, 128 * 5, 128 * 3, 128 },
+			{ 0, 128 * 11, 128 * 5, 128 },
+			{ 128 * 4, 128 * 5, 128 * 2, 128 },
+			{ 0, 128 * 5, 128 * 3, 128 },
+			{ 128 * 6, 128 * 11, 128 * 5, 128 },
+			{ 128 * 15, 128, 128, 128 * 2 }, // drill well
+			{ 128 * 15, 128 * 4 - 24, 128, 128 }, // drill bit
+			{ 128 * 12, 128, 128 * 3, 128 }, // reception pod
+			{ 128 * 15, 128 * 2, 128, 128 }, // drill step
+		})
+	{
+		TileSize = 128;
+		Resize(width, height);
+	}
+	void Generate();
+	// Picks the resident tile under a point given in the same screen centred
+	// coordinates the tiles are drawn in, or nullptr. Only the cell under the
+	// point and the oversized tiles reaching into it are looked at.
+	Tile * TileFromWorldPoint(float, float, int, int);
+	// The same for many points at once, e.g. for hover highlighting.
+	void TilesFromWorldPoints(const DirectX::XMFLOAT2 *, size_t, int, int, Tile **);
+	Tile * GetTile(int);
+	std::vector<Geometry::ColoredRect<int>> GetColoredRects(const Chunk &) const;
+	std::vector<int> GetUvRectMap(const Chunk &) const;
+	const std::vector<RECT> & GetTextureMap() const { return textureMap; }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetSize() const { return size; }
+	int GetTileSize() const { return TileSize; }
+	int GetWorldWidth() const { return worldwidth; }
+	int GetWorldHeight() const { return worldheight; }
+
+	// Keeps the map's size in file, and a chunk of textures for each chunk
+	// of the world that differs from a generated one. Only chunks marked
+	// changed since the last Save are looked at again, so the file has to
+	// be the one last saved to or loaded from.
+	void Save(SaveFile &);
+
+	// False, leaving the map as it is, if file holds no map. Throws if the
+	// one it holds is damaged.
+	bool Load(const SaveFile &);
+
+	// Call after changing a tile's texture, for the next Save to see it.
+	void MarkChanged(int index) { m_changed.insert(ChunkFromTile(index)); }
+
+	// Makes every chunk within a margin of the view resident, generating at
+	// most maxLoads of them, and evicts the ones that have drifted well out
+	// of it. The indices of the chunks that came and went are appended to
+	// loaded and evicted so their GPU copies can follow.
+	void Stream(const Geometry::Rectangle<int> &, size_t maxLoads, std::vector<int> & loaded, std::vector<int> & evicted);
+
+	// The part of the world the camera sees, in the same coordinates as the
+	// tile positions.
+	static Geometry::Rectangle<int> ViewFromCamera(float x, float y, int screenWidth, int screenHeight)
+	{
+		return Geometry::Rectangle<int>(static_cast<int>(x), static_cast<int>(-y), screenWidth, screenHeight);
+	}
+
+	const Chunk * GetChunk(int chunk) const;
+	const std::map<int, Chunk> & GetResidentChunks() const { return m_chunks; }
+	int ChunkFromTile(int index) const { return ChunkIndex((index / height) / ChunkSize, (index % height) / ChunkSize); }
+	int LocalFromTile(int index) const;
+
+private:
+	void Resize(int width, int height);
+	Chunk & LoadChunk(int chunk);
+	Chunk & PlaceChunk(int chunk);
+	void FillChunk(Chunk &) const;
+	void ActivateChunk(Chunk &);
+	void EvictChunk(std::map<int, Chunk>::iterator);
+	uint8_t GenerateTexture(int x, int y) const;
+	Tile MakeTile(int x, int y, uint8_t texidx) const;
+	void GetTextures(int chunk, uint8_t *) const;
+	void IndexOverlaps(const Chunk &, bool);
+	Tile * FindTile(int index, Chunk * &);
+	int ChunkIndex(int cx, int cy) const { return cx * chunksDown + cy; }
+
+	int width, height, size,
+		TileSize, worldwidth, worldheight,
+		chunksAcross, chunksDown;
+	std::vector<RECT> textureMap;
+
+	// Resident chunks, ordered by index so picking visits tiles in the same
+	// order as the world does.
+	std::map<int, Chunk> m_chunks;
+
+	// Textures of evicted chunks that no longer match what Generate would
+	// produce, i.e. ones the player has changed.
+	std::unordered_map<int, std::vector<uint8_t>> m_edits;
+
+	// Resident tiles bigger than one cell, listed under each other cell they
+	// cover, so picking only has to check those on top of the cell's own.
+	std::unordered_multimap<int, int> m_overlaps;
+
+	// Chunks made resident since the last Stream call.
+	std::vector<int> m_loaded;
+
+	// Chunks with tiles changed since the last Save, and whether every
+	// chunk has to be saved again as the map was regenerated or resized.
+	std::set<int> m_changed;
+	bool m_isSaveStale = true;
+};
+
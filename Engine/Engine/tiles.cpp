@@ -11,77 +11,9 @@ void Tiles::LoadTiles(const char* filename)
 		//std::ifstream file(filename, std::ios::binary);
 		//file.exceptions(std::fstream::failbit | std::fstream::badbit);
 		//BinaryReader reader(file);
-		int32_t numTiles = 1;//reader.Get<int32_t>();
-		m_tiles.reserve(numTiles);
-		std::vector<Geometry::ColoredRect<int>> coloredRects;
-		coloredRects.reserve(size);
-		std::vector<int> uvrectmap;
-		uvrectmap.reserve(size);
-	 
-		for (int i = 0; i < size; i++)
-		{
-			try
-			{
-				//int32_t tileLength = reader.Get<int32_t>();
-				//auto buffer = std::make_unique<std::byte[]>(tileLength);
-				//reader.Read(buffer.get(), tileLength);
-				int x = (i / width), y = (i % height);
-				byte mappedTexture = 0;
-				Geometry::Rectangle<int> rectangle(x * TileSize, y * TileSize, TileSize, TileSize);
-
-				// the sky
-				if (y < 6)
-					mappedTexture = 255;
-
-				// drill bit
-				if (x == width / 2)
-				{
-					if (y < 7)
-						mappedTexture = 255;
-					if (y == 7)
-					{
-						//	drillBitIndex = i;
-						mappedTexture = 12;
-						rectangle.Bottom = 128;
-					}
-
-					// drill well
-					if (y < 6)
-						mappedTexture = 255;
-					if (y == 5)
-					{
-						mappedTexture = 11;
-						rectangle.Bottom = 128 * 2;
-					}
-				}
-				// reception pod
-				if (y == 5)
-				{
-					if (x == ((width / 2) - 3))
-					{
-						mappedTexture = 13;
-						rectangle.Right = 128 * 3;
-					}
-					if (x == ((width / 2) - 2) || x == ((width / 2) - 1))
-						mappedTexture = 255;
-				}
-				m_tiles.emplace_back(rectangle, mappedTexture, i);
-				coloredRects.emplace_back(rectangle);
-				uvrectmap.emplace_back(mappedTexture);
-			}
-			catch (std::exception & e)
-			{
-				throw std::runtime_error(
-					FormatString(
-						"%s\n\nCould not load tile %d",
-						e.what(), i
-					).data()
-				);
-			}
-		}
-		m_Bitmap.SetRectUvMap(std::move(uvrectmap));
-		m_Bitmap.UpdateUvRects(std::move(textureMap));
-		m_Bitmap.UpdateColoredRects(std::move(coloredRects));
+		m_map.Generate();
+		m_chunkBatches.clear();
+		StreamChunks(SIZE_MAX);
 	}
 	catch (std::exception & e)
 	{
@@ -95,26 +27,74 @@ void Tiles::LoadTiles(const char* filename)
 }
 
 
-Tiles::Tile * Tiles::TileFromWorldPoint(DirectX::XMFLOAT3 & p)
+void Tiles::StreamChunks(size_t maxLoads)
 {
-	for (int index = 0; index < size; index++)
+	PROFILE_SCOPE("Tiles::StreamChunks");
+	ALLOCATION_SCOPE(Tiles);
+
+	auto position = m_Camera->GetPosition();
+	auto view = TileMap::ViewFromCamera(position.x, position.y, m_screenWidth, m_screenHeight);
+
+	m_loaded.clear();
+	m_evicted.clear();
+	m_map.Stream(view, maxLoads, m_loaded, m_evicted);
+
+	for (int index : m_evicted)
+		m_chunkBatches.erase(index);
+
+	for (int index : m_loaded)
 	{
-		auto rect = m_tiles[index].position;
-		// Calculate the screen coordinates of the bitmap.
-		float
-			left = (float)rect.left - (float)(m_screenWidth / 2),
-			right = left + (float)rect.Width,
-			top = (float)(m_screenHeight / 2) - (float)rect.Top,
-			bottom = top - (float)rect.Height;
-		if (p.x >= left && p.x < right && p.y <= top && p.y > bottom && m_tiles[index].texidx != 255)
-			return &m_tiles[index];
+		const TileMap::Chunk * chunk = m_map.GetChunk(index);
+		if (chunk == nullptr)
+			continue;
+
+		// Chunks are small enough that their pixel positions fit in 16 bits
+		// relative to their own corner.
+		int tileSize = m_map.GetTileSize();
+		auto batch = std::make_unique<TileBatch>(
+			m_device, m_deviceContext, m_FontShader, &m_tileResources, m_screenWidth, m_screenHeight,
+			POINT{ chunk->x * tileSize - m_screenWidth / 2, m_screenHeight / 2 - chunk->y * tileSize });
+		batch->UpdateTiles(m_map.GetColoredRects(*chunk), m_map.GetUvRectMap(*chunk));
+		m_chunkBatches[index] = std::move(batch);
 	}
-	return nullptr;
+}
+
+
+void Tiles::UpdateTile(const Tile & tile)
+{
+	m_map.MarkChanged(tile.index);
+
+	// Chunks without a batch yet pick the change up when they are uploaded.
+	auto batch = m_chunkBatches.find(m_map.ChunkFromTile(tile.index));
+	if (batch == m_chunkBatches.end())
+		return;
+
+	batch->second->UpdateTile(m_map.LocalFromTile(tile.index), tile.position, tile.texidx);
+}
+
+
+void Tiles::Frame()
+{
+	StreamChunks(MaxChunkLoadsPerFrame);
+}
+
+
+Tiles::Tile * Tiles::TileFromWorldPoint(DirectX::XMFLOAT3 & p)
+{
+	return m_map.TileFromWorldPoint(p.x, p.y, m_screenWidth, m_screenHeight);
+}
+
+
+void Tiles::TilesFromWorldPoints(const DirectX::XMFLOAT2 * points, size_t count, Tile ** tiles)
+{
+	m_map.TilesFromWorldPoints(points, count, m_screenWidth, m_screenHeight, tiles);
 }
 
 
 void Tiles::OnClick(const std::vector<bool> keys, POINT p)
 {
+	ALLOCATION_SCOPE(Tiles);
+
 	if (keys[VK_LBUTTON])
 	{
 		auto point = m_Camera->ToWorldPosition(p);
@@ -132,8 +112,8 @@ void Tiles::OnClick(const std::vector<bool> keys, POINT p)
 
 			case 12:
 				// drill bit was clicked
-				int x = tile->index / width, y = tile->index % height;
-				int neighbour = x * height + (y + 1);
+				int x = tile->index / m_map.GetWidth(), y = tile->index % m_map.GetHeight();
+				int neighbour = x * m_map.GetHeight() + (y + 1);
 				int cost = m_settings->drillCost * (y - 6);
 				if (m_settings->money < m_settings->drillCost * (y - 7))
 					return;
@@ -144,14 +124,14 @@ void Tiles::OnClick(const std::vector<bool> keys, POINT p)
 				else
 				{
 					m_settings->money -= cost;
-					m_tiles[neighbour].texidx = 12;
+					auto below = m_map.GetTile(neighbour);
+					below->texidx = 12;
 					tile->texidx = 14;
-					m_Bitmap.UpdateUvRectMap(neighbour, m_tiles[neighbour].texidx);
+					UpdateTile(*below);
 				}
 				break;
 		}
-		m_Bitmap.UpdateUvRectMap(tile->index, tile->texidx);
-		m_Bitmap.UpdateColoredRect(tile->index, tile->position);
+		UpdateTile(*tile);
 	}
 }
 
@@ -161,41 +141,22 @@ void Tiles::Render(
 	const DirectX::XMMATRIX & orthoMatrix,
 	const DirectX::XMMATRIX & baseViewMatrix)
 {
-	m_Bitmap.Render(worldMatrix, orthoMatrix, baseViewMatrix);
+	PROFILE_SCOPE("Tiles::Render");
+	ALLOCATION_SCOPE(Tiles);
+
+	for (auto & batch : m_chunkBatches)
+		batch.second->Render(worldMatrix, orthoMatrix, baseViewMatrix);
 }
 
-void Tiles::Save(BinaryWriter & writer)
+void Tiles::Save(SaveFile & file)
 {
-	writer.Write(size);
-	writer.Write(width);
-	writer.Write(height);
-	for (int index = 0; index < size; index++)
-		writer.Write(m_tiles[index].texidx);
+	m_map.Save(file);
 }
 
-void Tiles::Load(BinaryReader & reader)
+void Tiles::Load(const SaveFile & file)
 {
-	size = reader.Get<int>();
-	width = reader.Get<int>();
-	height = reader.Get<int>();
-	std::vector<uint8_t> data(size);
-	reader.Read(data.data(), data.capacity());
-	std::vector<Geometry::ColoredRect<int>> coloredRects;
-	coloredRects.reserve(size);
-	std::vector<int> uvrectmap;
-	uvrectmap.reserve(size);
-	m_tiles.clear();
-	for (int index = 0; index < size; index++)
-	{
-		int x = (index / width) * TileSize, y = (index % height) * TileSize;
-		int v = data[index] == 255 ? 0 : data[index];
-		uint8_t mappedTexture = data[index];
-		Geometry::Rectangle<int> rectangle(x, y, textureMap[v].right, textureMap[v].bottom);
-		m_tiles.emplace_back(rectangle, mappedTexture, index);
-		coloredRects.emplace_back(rectangle);
-		uvrectmap.emplace_back(mappedTexture);
-	}
-	m_Bitmap.SetRectUvMap(std::move(uvrectmap));
-	m_Bitmap.UpdateUvRects(std::move(textureMap));
-	m_Bitmap.UpdateColoredRects(std::move(coloredRects));
+	if (!m_map.Load(file))
+		return;
+	m_chunkBatches.clear();
+	StreamChunks(SIZE_MAX);
 }
@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: vertexbuilder.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "vertexbuilder.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cmath>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "jobsystem.h"
+#include "profiler.h"
+
+
+// Quads per job when a whole batch is rebuilt; a few dirty ones are not
+// worth handing out.
+static const size_t SpritesPerJob = 4096;
+
+
+void VertexBuilder::BuildColoredRects(
+	VertexColorType * vertexPtr,
+	const std::vector<Geometry::ColoredRect<int>> & rects,
+	int screenWidth, int screenHeight,
+	size_t first, size_t count)
+{
+	size_t end = first + std::min(count, rects.size() - std::min(first, rects.size()));
+	size_t index = 4 * first;
+	for (size_t i = first; i < end; i++)
+	{
+		const auto & position = rects[i];
+		if (position.hidden)
+		{
+			std::fill_n(vertexPtr + index, 4, VertexColorType());
+			index += 4;
+			continue;
+		}
+		// Calculate the screen coordinates of the bitmap.
+		float
+			left = (float)position.rect.left - (float)(screenWidth / 2),
+			right = left + (float)position.rect.right,
+			top = (float)(screenHeight / 2) - (float)position.rect.top,
+			bottom = top - (float)position.rect.bottom;
+
+		// Create the vertex array.
+		vertexPtr[index++] = { { left, top, 0.0f },{ 0.0f, 0.0f }, position.color };  // Top left.
+		vertexPtr[index++] = { { right, top, 0.0f }, { 1.0f, 0.0f }, position.color }; // Top right.
+		vertexPtr[index++] = { { left, bottom, 0.0f },{ 0.0f, 1.0f }, position.color }; // Bottom left.
+		vertexPtr[index++] = { { right, bottom, 0.0f },{ 1.0f, 1.0f }, position.color }; // Bottom right.
+	}
+}
+
+
+void VertexBuilder::BuildSprites(
+	VertexColorType * vertexPtr,
+	const std::vector<Geometry::ColoredRect<int>> & rects,
+	const std::vector<RECT> & uvrects,
+	const std::vector<int> & uvrectmap,
+	int screenWidth, int screenHeight,
+	size_t first, size_t count)
+{
+	PROFILE_SCOPE("VertexBuilder::BuildSprites");
+
+	size_t end = first + std::min(count, rects.size() - std::min(first, rects.size()));
+	JobSystem::Get().ParallelFor(first, end, SpritesPerJob, [&](size_t begin, size_t last) {
+		size_t index = 4 * begin;
+		for (size_t i = begin; i < last; i++)
+		{
+			const auto & position = rects[i];
+			if (position.hidden || uvrectmap[i] > static_cast<int>(uvrects.size()) - 1)
+			{
+				std::fill_n(vertexPtr + index, 4, VertexColorType());
+				index += 4;
+				continue;
+			}
+			const auto & uvrect = uvrects[uvrectmap[i]];
+
+			// Calculate the screen coordinates of the bitmap.
+			float
+				left = (float)position.rect.left - (float)(screenWidth / 2),
+				right = left + (float)position.rect.right,
+				top = (float)(screenHeight / 2) - (float)position.rect.top,
+				bottom = top - (float)position.rect.bottom,
+				uvleft = (float)uvrect.left,
+				uvright = uvleft + (float)uvrect.right,
+				uvtop = (float)uvrect.top,
+				uvbottom = uvtop + (float)uvrect.bottom;
+
+			// Create the vertex array.
+			vertexPtr[index++] = { { left, top, 0.0f },{ uvleft/2048,uvtop/2048.f }, position.color };  // Top left.
+			vertexPtr[index++] = { { right, top, 0.0f }, { uvright/2048,uvtop/2048.f }, position.color }; // Top right.
+			vertexPtr[index++] = { { left, bottom, 0.0f },{ uvleft/2048,uvbottom/2048.f }, position.color }; // Bottom left.
+			vertexPtr[index++] = { { right, bottom, 0.0f },{ uvright/2048,uvbottom/2048.0f }, position.color }; // Bottom right.
+		}
+	});
+}
+
+
+void VertexBuilder::BuildTileInstances(
+	TileInstanceType * instances,
+	const std::vector<Geometry::ColoredRect<int>> & rects,
+	size_t atlasSize,
+	const std::vector<int> & uvrectmap,
+	int screenWidth, int screenHeight,
+	POINT origin,
+	size_t first, size_t count)
+{
+	auto unorm8 = [](float value) { return static_cast<uint8_t>(!(value > 0.0f) ? 0.0f : value < 1.0f ? value * 255.0f + 0.5f : 255.0f); };
+
+	size_t end = first + std::min(count, rects.size() - std::min(first, rects.size()));
+	for (size_t i = first; i < end; i++)
+	{
+		const auto & position = rects[i];
+		auto & instance = instances[i];
+		if (position.hidden || uvrectmap[i] < 0 || static_cast<size_t>(uvrectmap[i]) >= atlasSize)
+		{
+			instance = TileInstanceType();
+			continue;
+		}
+
+		// The same corner BuildSprites puts its first vertex at.
+		instance.x = static_cast<int16_t>(position.rect.left - screenWidth / 2 - origin.x);
+		instance.y = static_cast<int16_t>(screenHeight / 2 - position.rect.top - origin.y);
+		instance.width = static_cast<uint16_t>(position.rect.right);
+		instance.height = static_cast<uint16_t>(position.rect.bottom);
+		instance.atlas = static_cast<uint32_t>(uvrectmap[i]);
+		instance.color[0] = unorm8(position.color.x);
+		instance.color[1] = unorm8(position.color.y);
+		instance.color[2] = unorm8(position.color.z);
+		instance.color[3] = unorm8(position.color.w);
+	}
+}
+
+
+void VertexBuilder::BuildAtlasRects(DirectX::XMFLOAT4 * atlas, const std::vector<RECT> & uvrects)
+{
+	for (size_t i = 0; i < uvrects.size(); i++)
+	{
+		const auto & uvrect = uvrects[i];
+		atlas[i] = {
+			uvrect.left / 2048.0f,
+			uvrect.top / 2048.0f,
+			(uvrect.left + uvrect.right) / 2048.0f,
+			(uvrect.top + uvrect.bottom) / 2048.0f
+		};
+	}
+}
+
+
+template<typename T>
+static void BuildQuadIndicesT(T * indices, size_t quadCount)
+{
+	for (size_t i = 0, v = 0; i < quadCount; i++, v += 6)
+	{
+		T iii = static_cast<T>(4 * i);
+		indices[v] = iii;
+		indices[v + 1] = iii + 1;
+		indices[v + 2] = iii + 2;
+
+		indices[v + 3] = iii + 1;
+		indices[v + 4] = iii + 3;
+		indices[v + 5] = iii + 2;
+	}
+}
+
+
+// 16-bit indices only reach the first 16384 quads.
+void VertexBuilder::BuildQuadIndices(uint16_t * indices, size_t quadCount)
+{
+	BuildQuadIndicesT(indices, quadCount);
+}
+
+
+void VertexBuilder::BuildQuadIndices(uint32_t * indices, size_t quadCount)
+{
+	BuildQuadIndicesT(indices, quadCount);
+}
+
+
+void VertexBuilder::PackVertices(PackedVertexType * packed, const VertexColorType * vertices, size_t count, POINT origin)
+{
+	// Written so NaN ends up at the bottom of the range rather than being
+	// undefined when cast.
+	auto clamp = [](float value, float lo, float hi) { return !(value > lo) ? lo : value < hi ? value : hi; };
+	auto unorm8 = [&](float value) { return static_cast<uint8_t>(clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f); };
+	auto unorm16 = [&](float value) { return static_cast<uint16_t>(clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f); };
+	auto sint16 = [&](float value) { return static_cast<int16_t>(std::lround(clamp(value, -32768.0f, 32767.0f))); };
+
+	for (size_t i = 0; i < count; i++)
+	{
+		const auto & vertex = vertices[i];
+		auto & out = packed[i];
+		out.x = sint16(vertex.position.x - origin.x);
+		out.y = sint16(vertex.position.y - origin.y);
+		out.u = unorm16(vertex.texture.x);
+		out.v = unorm16(vertex.texture.y);
+		out.color[0] = unorm8(vertex.color.x);
+		out.color[1] = unorm8(vertex.color.y);
+		out.color[2] = unorm8(vertex.color.z);
+		out.color[3] = unorm8(vertex.color.w);
+	}
+}
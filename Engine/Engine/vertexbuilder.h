@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: vertexbuilder.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cstdint>
+#include <vector>
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "game.h"
+#include "vertextypes.h"
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: VertexBuilder
+//
+// CPU side of the sprite batches. LargeBitmap and Spritemap hand it their copy
+// of the vertex buffer; the benchmark hands it plain memory. The rect builders
+// can rewrite just the quads [first, first + count) in place; hidden rects are
+// written as zero area quads so the result never depends on what was there.
+////////////////////////////////////////////////////////////////////////////////
+class VertexBuilder
+{
+public:
+	static void BuildColoredRects(
+		VertexColorType *,
+		const std::vector<Geometry::ColoredRect<int>> &,
+		int, int,
+		size_t first = 0, size_t count = SIZE_MAX);
+	static void BuildSprites(
+		VertexColorType *,
+		const std::vector<Geometry::ColoredRect<int>> &,
+		const std::vector<RECT> &,
+		const std::vector<int> &,
+		int, int,
+		size_t first = 0, size_t count = SIZE_MAX);
+	static void BuildQuadIndices(uint16_t *, size_t);
+	static void BuildQuadIndices(uint32_t *, size_t);
+
+	// Quantizes vertices to PackedVertexType, with positions relative to
+	// origin. Out of range values are clamped.
+	static void PackVertices(PackedVertexType *, const VertexColorType *, size_t, POINT origin);
+
+	// The instanced equivalent of BuildSprites: one record per rect instead of
+	// four vertices, positioned relative to origin like PackVertices.
+	static void BuildTileInstances(
+		TileInstanceType *,
+		const std::vector<Geometry::ColoredRect<int>> &,
+		size_t atlasSize,
+		const std::vector<int> &,
+		int, int,
+		POINT origin,
+		size_t first = 0, size_t count = SIZE_MAX);
+
+	// Normalizes the atlas rects to (left, top, right, bottom) UVs, the table
+	// the tile vertex shader looks TileInstanceType::atlas up in.
+	static void BuildAtlasRects(DirectX::XMFLOAT4 *, const std::vector<RECT> &);
+};
@@ -0,0 +1,65 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: vertextypes.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+///////////////////////
+// MY CLASS INCLUDES //
+///////////////////////
+#include "platform.h"
+
+
+struct VertexType
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT2 texture;
+};
+
+
+struct VertexColorType
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT2 texture;
+	DirectX::XMFLOAT4 color;
+};
+
+
+// The same as VertexColorType squeezed into 12 bytes for sprite batches:
+// whole pixel positions relative to the batch origin, UVs as unorm16 and an
+// RGBA8 colour. Z is always 0 for those, so it is dropped.
+struct PackedVertexType
+{
+	int16_t x, y;
+	uint16_t u, v;
+	uint8_t color[4];
+};
+static_assert(sizeof(PackedVertexType) == 12, "PackedVertexType must match the packed input layout");
+
+
+// Which of the two layouts above a sprite batch uploads.
+enum class VertexFormat
+{
+	Full,
+	Packed
+};
+
+
+struct InstanceType
+{
+	DirectX::XMFLOAT3 position;
+};
+
+
+// One tile drawn as an instance of a shared unit quad. The top left corner is
+// in pixels relative to the batch origin, and atlas indexes the UV rects the
+// tile vertex shader reads from a structured buffer. Hidden tiles have no
+// size, which collapses all four corners onto one point.
+struct TileInstanceType
+{
+	int16_t x, y;
+	uint16_t width, height;
+	uint32_t atlas;
+	uint8_t color[4];
+};
+static_assert(sizeof(TileInstanceType) == 16, "TileInstanceType must match the tile input layout");
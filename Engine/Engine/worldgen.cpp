@@ -0,0 +1,321 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: worldgen.cpp
+////////////////////////////////////////////////////////////////////////////////
+#include "worldgen.h"
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define WORLDGEN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WORLDGEN_SSE2
+#endif
+
+
+namespace
+{
+	// Everything about one octave that is constant along a row. Since every
+	// octave samples z = 0, the noise collapses to its 2D slice and only the
+	// four corner hashes of the z = 0 face are ever needed. Along a row x is
+	// fixed, so those hashes only depend on the column's lattice Y and are
+	// tabulated once per row: h0[Y] for the X corner, h1[Y] for X + 1.
+	struct Octave
+	{
+		float xf, u, yscale, amp;
+		std::int32_t h0[258], h1[258];
+	};
+
+	// One lane per cell; also handles the columns left over after the
+	// widest batch.
+	struct ScalarLanes
+	{
+		typedef float F;
+		typedef std::int32_t I;
+		static constexpr int Width = 1;
+
+		static F Set(float a) { return a; }
+		static F Ramp(float a) { return a; }
+		static void Store(float * out, F a) { *out = a; }
+		static F Add(F a, F b) { return a + b; }
+		static F Sub(F a, F b) { return a - b; }
+		static F Mul(F a, F b) { return a * b; }
+		static I Truncate(F a) { return static_cast<I>(a); }
+		static F ToFloat(I a) { return static_cast<F>(a); }
+		static I And(I a, std::int32_t b) { return a & b; }
+		static I Or(I a, I b) { return a | b; }
+		static I Less(I a, std::int32_t b) { return a < b ? -1 : 0; }
+		static I Equal(I a, std::int32_t b) { return a == b ? -1 : 0; }
+		static F Select(I mask, F a, F b) { return mask ? a : b; }
+		static F NegateIf(I mask, F a) { return mask ? -a : a; }
+		static I Gather(const std::int32_t * table, I index) { return table[index]; }
+	};
+
+#if defined(WORLDGEN_SSE2) || defined(WORLDGEN_AVX2)
+	struct Sse2Lanes
+	{
+		typedef __m128 F;
+		typedef __m128i I;
+		static constexpr int Width = 4;
+
+		static F Set(float a) { return _mm_set1_ps(a); }
+		static F Ramp(float a) { return _mm_add_ps(_mm_set1_ps(a), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f)); }
+		static void Store(float * out, F a) { _mm_storeu_ps(out, a); }
+		static F Add(F a, F b) { return _mm_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm_mul_ps(a, b); }
+		static I Truncate(F a) { return _mm_cvttps_epi32(a); }
+		static F ToFloat(I a) { return _mm_cvtepi32_ps(a); }
+		static I And(I a, std::int32_t b) { return _mm_and_si128(a, _mm_set1_epi32(b)); }
+		static I Or(I a, I b) { return _mm_or_si128(a, b); }
+		static I Less(I a, std::int32_t b) { return _mm_cmplt_epi32(a, _mm_set1_epi32(b)); }
+		static I Equal(I a, std::int32_t b) { return _mm_cmpeq_epi32(a, _mm_set1_epi32(b)); }
+
+		static F Select(I mask, F a, F b)
+		{
+			F m = _mm_castsi128_ps(mask);
+			return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+		}
+
+		static F NegateIf(I mask, F a)
+		{
+			return _mm_xor_ps(a, _mm_and_ps(_mm_castsi128_ps(mask), _mm_set1_ps(-0.0f)));
+		}
+
+		// SSE2 has no gather, so spill the indices and load them one by one.
+		static I Gather(const std::int32_t * table, I index)
+		{
+			alignas(16) std::int32_t i[4];
+			_mm_store_si128(reinterpret_cast<__m128i *>(i), index);
+			return _mm_setr_epi32(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+		}
+	};
+#endif
+
+#if defined(WORLDGEN_AVX2)
+	struct Avx2Lanes
+	{
+		typedef __m256 F;
+		typedef __m256i I;
+		static constexpr int Width = 8;
+
+		static F Set(float a) { return _mm256_set1_ps(a); }
+		static F Ramp(float a) { return _mm256_add_ps(_mm256_set1_ps(a), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f)); }
+		static void Store(float * out, F a) { _mm256_storeu_ps(out, a); }
+		static F Add(F a, F b) { return _mm256_add_ps(a, b); }
+		static F Sub(F a, F b) { return _mm256_sub_ps(a, b); }
+		static F Mul(F a, F b) { return _mm256_mul_ps(a, b); }
+		static I Truncate(F a) { return _mm256_cvttps_epi32(a); }
+		static F ToFloat(I a) { return _mm256_cvtepi32_ps(a); }
+		static I And(I a, std::int32_t b) { return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+		static I Or(I a, I b) { return _mm256_or_si256(a, b); }
+		static I Less(I a, std::int32_t b) { return _mm256_cmpgt_epi32(_mm256_set1_epi32(b), a); }
+		static I Equal(I a, std::int32_t b) { return _mm256_cmpeq_epi32(a, _mm256_set1_epi32(b)); }
+		static F Select(I mask, F a, F b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+
+		static F NegateIf(I mask, F a)
+		{
+			return _mm256_xor_ps(a, _mm256_and_ps(_mm256_castsi256_ps(mask), _mm256_set1_ps(-0.0f)));
+		}
+
+		static I Gather(const std::int32_t * table, I index) { return _mm256_i32gather_epi32(table, index, 4); }
+	};
+
+	typedef Avx2Lanes WideLanes;
+#elif defined(WORLDGEN_SSE2)
+	typedef Sse2Lanes WideLanes;
+#else
+	typedef ScalarLanes WideLanes;
+#endif
+
+	template<class L>
+	inline typename L::F Fade(typename L::F t)
+	{
+		// t * t * t * (t * (t * 6 - 15) + 10)
+		auto inner = L::Add(L::Mul(t, L::Sub(L::Mul(t, L::Set(6.0f)), L::Set(15.0f))), L::Set(10.0f));
+		return L::Mul(L::Mul(L::Mul(t, t), t), inner);
+	}
+
+	template<class L>
+	inline typename L::F Lerp(typename L::F t, typename L::F a, typename L::F b)
+	{
+		return L::Add(a, L::Mul(t, L::Sub(b, a)));
+	}
+
+	// PerlinNoise::Grad with z = 0, picking u and v with lane masks.
+	template<class L>
+	inline typename L::F Grad(typename L::I h, typename L::F x, typename L::F y)
+	{
+		auto u = L::Select(L::Less(h, 8), x, y);
+		auto v = L::Select(L::Less(h, 4), y,
+			L::Select(L::Or(L::Equal(h, 12), L::Equal(h, 14)), x, L::Set(0.0f)));
+		return L::Add(L::NegateIf(L::Equal(L::And(h, 1), 1), u), L::NegateIf(L::Equal(L::And(h, 2), 2), v));
+	}
+
+	// Fills out[col, colEnd) in batches of L::Width cells and returns the
+	// first column that did not fit in a whole batch.
+	template<class L>
+	int GenerateColumns(const Octave * octaves, int numOctaves, int col, int colEnd, float * out)
+	{
+		for (; col + L::Width <= colEnd; col += L::Width)
+		{
+			auto column = L::Ramp(static_cast<float>(col));
+			auto result = L::Set(0.0f);
+
+			for (int i = 0; i < numOctaves; i++)
+			{
+				const Octave & octave = octaves[i];
+
+				// Columns are never negative, so truncation is floor.
+				auto y = L::Mul(column, L::Set(octave.yscale));
+				auto lattice = L::Truncate(y);
+				auto y0 = L::Sub(y, L::ToFloat(lattice));
+				auto y1 = L::Sub(y0, L::Set(1.0f));
+				auto Y = L::And(lattice, 255);
+				auto v = Fade<L>(y0);
+
+				auto x0 = L::Set(octave.xf);
+				auto x1 = L::Set(octave.xf - 1.0f);
+				auto u = L::Set(octave.u);
+
+				auto noise = Lerp<L>(v,
+					Lerp<L>(u, Grad<L>(L::Gather(octave.h0, Y), x0, y0), Grad<L>(L::Gather(octave.h1, Y), x1, y0)),
+					Lerp<L>(u, Grad<L>(L::Gather(octave.h0 + 1, Y), x0, y1), Grad<L>(L::Gather(octave.h1 + 1, Y), x1, y1)));
+				result = L::Add(result, L::Mul(noise, L::Set(octave.amp)));
+			}
+
+			L::Store(out + col, L::Add(L::Mul(result, L::Set(0.5f)), L::Set(0.5f)));
+		}
+
+		return col;
+	}
+}
+
+
+void Cellular::Smooth()
+{
+	const std::uint64_t lastWordMask = width % 64 ? (std::uint64_t(1) << (width % 64)) - 1 : ~std::uint64_t(0);
+
+	for (int x = 0; x < height; x++)
+	{
+		const std::uint64_t * rows[3] = { Row(map, x - 1), Row(map, x), Row(map, x + 1) };
+		std::uint64_t * out = Row(next, x);
+
+		for (int w = 0; w < wordsPerRow; w++)
+		{
+			// The eight neighbours of all 64 cells in this word, each as a
+			// word of its own: left, centre and right for the rows above and
+			// below, left and right for this row.
+			std::uint64_t n[9];
+			for (int i = 0; i < 3; i++)
+			{
+				const std::uint64_t * row = rows[i];
+				std::uint64_t carryIn = w > 0 ? row[w - 1] >> 63 : 0;
+				std::uint64_t carryOut = w + 1 < wordsPerRow ? row[w + 1] << 63 : 0;
+				n[i * 3] = (row[w] << 1) | carryIn;
+				n[i * 3 + 1] = row[w];
+				n[i * 3 + 2] = (row[w] >> 1) | carryOut;
+			}
+			const std::uint64_t alive = n[4];
+
+			// Add them up bit-sliced with full adders: the count of every
+			// cell ends up spread over the four words b0..b3.
+			std::uint64_t s1 = n[0] ^ n[1] ^ n[2], k1 = (n[0] & n[1]) | (n[2] & (n[0] ^ n[1]));
+			std::uint64_t s2 = n[3] ^ n[5] ^ n[6], k2 = (n[3] & n[5]) | (n[6] & (n[3] ^ n[5]));
+			std::uint64_t s3 = n[7] ^ n[8], k3 = n[7] & n[8];
+			std::uint64_t b0 = s1 ^ s2 ^ s3, k4 = (s1 & s2) | (s3 & (s1 ^ s2));
+			std::uint64_t t = k1 ^ k2 ^ k3, c5 = (k1 & k2) | (k3 & (k1 ^ k2));
+			std::uint64_t b1 = t ^ k4, c6 = t & k4;
+			std::uint64_t b2 = c5 ^ c6, b3 = c5 & c6;
+
+			// Live cells survive with 3 or more neighbours, dead ones are
+			// born with more than 4.
+			std::uint64_t atLeast3 = b3 | b2 | (b1 & b0);
+			std::uint64_t atLeast5 = b3 | (b2 & (b1 | b0));
+			out[w] = (alive & atLeast3) | (~alive & atLeast5);
+		}
+
+		// Keep the padding past the last column dead so it is never counted.
+		out[wordsPerRow - 1] &= lastWordMask;
+	}
+
+	map.swap(next);
+}
+
+
+void PerlinNoise::Fill(unsigned threadCount)
+{
+	// Below this many cells a single thread wins.
+	const int minCellsPerThread = 16384;
+
+	int bands = static_cast<int>(std::min<unsigned>(std::max(threadCount, 1u), static_cast<unsigned>(height)));
+	bands = std::max(1, std::min(bands, size / minCellsPerThread));
+
+	if (bands == 1)
+	{
+		GenerateRows(0, height);
+		return;
+	}
+
+	std::vector<std::thread> workers;
+	workers.reserve(bands - 1);
+
+	int rowsPerBand = (height + bands - 1) / bands;
+	for (int row = rowsPerBand; row < height; row += rowsPerBand)
+		workers.emplace_back(&PerlinNoise::GenerateRows, this, row, std::min(row + rowsPerBand, height));
+
+	GenerateRows(0, std::min(rowsPerBand, height));
+
+	for (auto & worker : workers)
+		worker.join();
+}
+
+
+void PerlinNoise::GenerateRows(int rowBegin, int rowEnd)
+{
+	std::vector<Octave> table(octaves);
+
+	for (int row = rowBegin; row < rowEnd; row++)
+	{
+		// Same sequence of doubles as OctaveNoise so the row constants agree
+		// with the reference exactly; only the per-column work is in floats.
+		double x = row / fx;
+		double yscale = 1.0 / fy;
+		double amp = 1.0;
+
+		for (auto & octave : table)
+		{
+			const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
+			const double xf = x - std::floor(x);
+			const std::int32_t A = p[X], B = p[X + 1];
+
+			octave.xf = static_cast<float>(xf);
+			octave.u = static_cast<float>(Fade(xf));
+			octave.yscale = static_cast<float>(yscale);
+			octave.amp = static_cast<float>(amp);
+
+			// Only the lattice rows this map reaches need hashing, plus one
+			// in case float rounding pushes the last column over an edge.
+			int reach = static_cast<int>((width - 1) * yscale) + 3;
+			int count = std::min(reach, 257);
+			for (int Y = 0; Y < count; Y++)
+			{
+				octave.h0[Y] = p[p[A + Y]] & 15;
+				octave.h1[Y] = p[p[B + Y]] & 15;
+			}
+
+			x *= 2.0;
+			yscale *= 2.0;
+			amp *= 0.5;
+		}
+
+		float * out = map.get() + static_cast<size_t>(row) * width;
+		int col = GenerateColumns<WideLanes>(table.data(), octaves, 0, width, out);
+		GenerateColumns<ScalarLanes>(table.data(), octaves, col, width, out);
+	}
+}
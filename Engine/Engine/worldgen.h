@@ -0,0 +1,206 @@
+////////////////////////////////////////////////////////////////////////////////
+// Filename: worldgen.h
+////////////////////////////////////////////////////////////////////////////////
+#pragma once
+
+
+//////////////
+// INCLUDES //
+//////////////
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: Cellular
+////////////////////////////////////////////////////////////////////////////////
+class Cellular
+{
+public:
+	Cellular(
+		const int & width,
+		const int & height,
+		const int & chanceToStartAlive = 44,
+		const int & smoothingIterations = 4,
+		const unsigned int & seed = std::default_random_engine::default_seed)
+		:
+		width(width),
+		height(height),
+		size(height * width),
+		chanceToStartAlive(chanceToStartAlive),
+		wordsPerRow((width + 63) / 64),
+		generator(seed),
+		distribution(0, 100)
+	{
+		// One spare row above and below the map stays empty so the first and
+		// last rows need no special casing.
+		map.assign(static_cast<size_t>(height + 2) * wordsPerRow, 0);
+		next.assign(map.size(), 0);
+
+		Generate();
+		for (int k = 0; k <= smoothingIterations; k++)
+			Smooth();
+	}
+	bool IsAlive(const int & index) const
+	{
+		int x = index / width, y = index % width;
+		return (Row(map, x)[y / 64] >> (y % 64)) & 1;
+	}
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetSize() const { return size; }
+
+	// Decides for every cell at once whether it is born, dies or remains
+	// unchanged. Reads only the current generation and writes the next, so
+	// the result does not depend on the order cells are visited in.
+	void Smooth();
+
+private:
+	// 64 cells per word, each row starting on a fresh word.
+	std::vector<std::uint64_t> map, next;
+	int width, height, size, chanceToStartAlive, wordsPerRow;
+	std::default_random_engine generator;
+	std::uniform_int_distribution<int> distribution;
+
+	inline void Generate()
+	{
+		for (int index = 0; index < size; index++)
+		{
+			int x = index / width, y = index % width;
+			if (distribution(generator) < chanceToStartAlive)
+				Row(map, x)[y / 64] |= std::uint64_t(1) << (y % 64);
+		}
+	}
+	inline std::uint64_t * Row(std::vector<std::uint64_t> & cells, int x) const
+	{
+		return cells.data() + static_cast<size_t>(x + 1) * wordsPerRow;
+	}
+	inline const std::uint64_t * Row(const std::vector<std::uint64_t> & cells, int x) const
+	{
+		return cells.data() + static_cast<size_t>(x + 1) * wordsPerRow;
+	}
+};
+
+
+////////////////////////////////////////////////////////////////////////////////
+// Class name: PerlinNoise
+////////////////////////////////////////////////////////////////////////////////
+class PerlinNoise
+{
+public:
+	PerlinNoise(
+		const int width,
+		const int height,
+		const int octaves,
+		const double freq,
+		std::uint32_t seed = std::default_random_engine::default_seed)
+		:
+		width(width),
+		height(height),
+		size(height * width),
+		octaves(octaves),
+		fx(width / freq),
+		fy(height / freq)
+	{
+		map = std::make_unique<float[]>(size);
+		std::iota(std::begin(p), std::begin(p) + 256, 0);
+		std::shuffle(std::begin(p), std::begin(p) + 256, std::default_random_engine(seed));
+		std::iota(std::begin(p) + 256, std::end(p), 0);
+
+		Fill(std::thread::hardware_concurrency());
+	}
+	auto GetMap() const { return map.get(); }
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	int GetSize() const { return size; }
+
+	// Regenerates the whole map with the batched generator, splitting the rows
+	// into one band per thread. Small maps stay on the calling thread because
+	// spawning the workers costs more than generating them.
+	void Fill(unsigned threadCount);
+
+	// Generates rows [rowBegin, rowEnd) a whole row of cells at a time in
+	// single precision, using as many SIMD lanes as the build allows.
+	void GenerateRows(int rowBegin, int rowEnd);
+
+	// The original per-cell double precision evaluation of one cell. The
+	// batched generator is checked against this to within a small tolerance.
+	double Reference(int index) const
+	{
+		return OctaveNoise((index / width) / fx, (index % width) / fy, 0.0);
+	}
+
+private:
+	std::int32_t p[512];
+	int width, height, size, octaves;
+	double fx, fy;
+	std::unique_ptr<float[]> map;
+
+	static inline constexpr double Fade(const double t) noexcept
+	{
+		return t * t * t * (t * (t * 6 - 15) + 10);
+	}
+
+	static inline constexpr double Lerp(const double t, const double a, const double b) noexcept
+	{
+		return a + t * (b - a);
+	}
+
+	static inline constexpr double Grad(std::int32_t hash, const double x, const double y, const double z) noexcept
+	{
+		const std::int32_t h = hash & 15;
+		const double u = h < 8 ? x : y;
+		const double v = h < 4 ? y : h == 12 || h == 14 ? x : z;
+		return ((h & 1) == 0 ? u : -u) + ((h & 2) == 0 ? v : -v);
+	}
+
+	inline double Generate(double x, double y, double z) const
+	{
+		const std::int32_t X = static_cast<std::int32_t>(std::floor(x)) & 255;
+		const std::int32_t Y = static_cast<std::int32_t>(std::floor(y)) & 255;
+		const std::int32_t Z = static_cast<std::int32_t>(std::floor(z)) & 255;
+
+		x -= std::floor(x);
+		y -= std::floor(y);
+		z -= std::floor(z);
+
+		const double u = Fade(x);
+		const double v = Fade(y);
+		const double w = Fade(z);
+
+		const std::int32_t A = p[X] + Y, AA = p[A] + Z, AB = p[A + 1] + Z;
+		const std::int32_t B = p[X + 1] + Y, BA = p[B] + Z, BB = p[B + 1] + Z;
+
+		return Lerp(w, Lerp(v, Lerp(u, Grad(p[AA], x, y, z),
+			Grad(p[BA], x - 1, y, z)),
+			Lerp(u, Grad(p[AB], x, y - 1, z),
+				Grad(p[BB], x - 1, y - 1, z))),
+			Lerp(v, Lerp(u, Grad(p[AA + 1], x, y, z - 1),
+				Grad(p[BA + 1], x - 1, y, z - 1)),
+				Lerp(u, Grad(p[AB + 1], x, y - 1, z - 1),
+					Grad(p[BB + 1], x - 1, y - 1, z - 1))));
+	}
+
+	double OctaveNoise(double x, double y, double z) const
+	{
+		double result = 0.0;
+		double amp = 1.0;
+
+		for (std::int32_t i = 0; i < octaves; ++i)
+		{
+			result += Generate(x, y, z) * amp;
+			x *= 2.0;
+			y *= 2.0;
+			z *= 2.0;
+			amp *= 0.5;
+		}
+
+		return result * 0.5 + 0.5;
+	}
+};